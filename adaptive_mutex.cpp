@@ -0,0 +1,216 @@
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // for _mm_pause()
+#endif
+#include "adaptive_mutex.h"
+#include "metrics.h"
+#include "clock.h"
+#include "util.h"
+
+namespace MyServer
+{
+    std::atomic<bool> AdaptiveMutex::s_profiling{false};
+
+    static const int s_max_spins = 100;        // 自旋次数上限
+    static const size_t s_site_slots = 1024;   // 调用点表大小，必须是2的幂
+    static const size_t s_site_probes = 16;    // 调用点表最多探测次数，表满时不再记录新调用点
+
+    static inline void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        __asm__ __volatile__("" ::: "memory");
+#endif
+    }
+
+    namespace
+    {
+        /**
+         * @brief 一个加锁调用点的等待统计
+         */
+        struct CallSite
+        {
+            std::atomic<uintptr_t> addr{0};
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> totalNS{0};
+            std::atomic<uint64_t> maxNS{0};
+        };
+
+        struct ProfileState
+        {
+            Histogram wait;
+            Histogram hold;
+            // 按返回地址开放寻址，只插入不删除，插入和更新都不加锁
+            CallSite sites[s_site_slots];
+        };
+
+        static ProfileState &GetProfile()
+        {
+            static ProfileState *s_profile = new ProfileState; // 其他静态对象析构时可能仍在加锁，不析构
+            return *s_profile;
+        }
+
+        static void RecordSite(void *site, uint64_t ns)
+        {
+            ProfileState &profile = GetProfile();
+            uintptr_t addr = (uintptr_t)site;
+            size_t idx = (addr >> 4) * 0x9E3779B97F4A7C15ull >> 54; // 取乘法哈希的高10位
+            for (size_t i = 0; i < s_site_probes; i++)
+            {
+                CallSite &slot = profile.sites[(idx + i) & (s_site_slots - 1)];
+                uintptr_t cur = slot.addr.load(std::memory_order_acquire);
+                if (cur == 0)
+                {
+                    if (slot.addr.compare_exchange_strong(cur, addr, std::memory_order_acq_rel))
+                        cur = addr;
+                }
+                if (cur != addr)
+                    continue;
+                slot.count.fetch_add(1, std::memory_order_relaxed);
+                slot.totalNS.fetch_add(ns, std::memory_order_relaxed);
+                uint64_t max = slot.maxNS.load(std::memory_order_relaxed);
+                while (ns > max && !slot.maxNS.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+                {
+                }
+                return;
+            }
+        }
+
+        static void PercentilesToYaml(YAML::Node &node, const HistogramSnapshot &snap)
+        {
+            node["count"] = snap.getCount();
+            node["mean"] = snap.getMean();
+            node["p50"] = snap.percentile(0.5);
+            node["p99"] = snap.percentile(0.99);
+            node["p999"] = snap.percentile(0.999);
+            node["max"] = snap.getMax();
+        }
+    }
+
+    __attribute__((noinline)) void AdaptiveMutex::lockSlow()
+    {
+        void *site = __builtin_return_address(0);
+        bool profiling = s_profiling.load(std::memory_order_relaxed);
+        uint64_t start = profiling ? Clock::MonotonicNS(Clock::TSC) : 0;
+        bool contended = false;
+        int c = 0;
+        if (!m_state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            contended = true;
+            // 自旋上限跟随最近的平均值：自旋拿到锁时平均值向本次的自旋次数靠拢，自旋失败时减半，
+            // 持锁时间长的锁连续几次失败后只再自旋最少的10次
+            int avg = m_spins.load(std::memory_order_relaxed);
+            int max_spins = std::min(s_max_spins, 2 * avg + 10);
+            int spins = 0;
+            bool acquired = false;
+            for (; spins < max_spins; ++spins)
+            {
+                c = 0;
+                if (m_state.load(std::memory_order_relaxed) == 0 &&
+                    m_state.compare_exchange_weak(c, 1, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    acquired = true;
+                    break;
+                }
+                CpuRelax();
+            }
+            if (acquired)
+                m_spins.store(avg + (spins - avg) / 8, std::memory_order_relaxed);
+            else
+                m_spins.store(avg / 2, std::memory_order_relaxed);
+            if (!acquired)
+            {
+                // 标记为有等待者后睡眠，醒来后同样以2的状态抢锁，保证解锁者一定会唤醒下一个等待者
+                c = m_state.exchange(2, std::memory_order_acquire);
+                while (c != 0)
+                {
+                    syscall(SYS_futex, (int *)&m_state, FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+                    c = m_state.exchange(2, std::memory_order_acquire);
+                }
+            }
+        }
+        if (profiling)
+        {
+            uint64_t now = Clock::MonotonicNS(Clock::TSC);
+            ProfileState &profile = GetProfile();
+            profile.wait.record(now - start);
+            if (contended)
+                RecordSite(site, now - start);
+            m_acquireTime = now;
+        }
+    }
+
+    void AdaptiveMutex::recordHold()
+    {
+        if (m_acquireTime == 0)
+            return;
+        GetProfile().hold.record(Clock::MonotonicNS(Clock::TSC) - m_acquireTime);
+        m_acquireTime = 0;
+    }
+
+    void AdaptiveMutex::wake()
+    {
+        syscall(SYS_futex, (int *)&m_state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    void AdaptiveMutex::SetProfiling(bool v)
+    {
+        GetProfile();
+        s_profiling.store(v, std::memory_order_relaxed);
+    }
+
+    void AdaptiveMutex::ResetProfile()
+    {
+        ProfileState &profile = GetProfile();
+        profile.wait.reset();
+        profile.hold.reset();
+        for (auto &i : profile.sites)
+        {
+            i.count = 0;
+            i.totalNS = 0;
+            i.maxNS = 0;
+        }
+    }
+
+    std::string AdaptiveMutex::ProfileToYamlString(size_t top)
+    {
+        ProfileState &profile = GetProfile();
+        YAML::Node node;
+        YAML::Node wait, hold;
+        PercentilesToYaml(wait, profile.wait.snapshot());
+        PercentilesToYaml(hold, profile.hold.snapshot());
+        node["wait_ns"] = wait;
+        node["hold_ns"] = hold;
+
+        std::vector<CallSite *> sites;
+        for (auto &i : profile.sites)
+        {
+            if (i.addr.load(std::memory_order_acquire) && i.count.load(std::memory_order_relaxed))
+                sites.push_back(&i);
+        }
+        std::sort(sites.begin(), sites.end(), [](CallSite *a, CallSite *b) {
+            return a->maxNS.load(std::memory_order_relaxed) > b->maxNS.load(std::memory_order_relaxed);
+        });
+        if (sites.size() > top)
+            sites.resize(top);
+        for (auto i : sites)
+        {
+            YAML::Node n;
+            n["site"] = SymbolizeFrame((void *)i->addr.load(std::memory_order_relaxed));
+            n["count"] = i->count.load(std::memory_order_relaxed);
+            n["total_ns"] = i->totalNS.load(std::memory_order_relaxed);
+            n["max_ns"] = i->maxNS.load(std::memory_order_relaxed);
+            node["slowest_sites"].push_back(n);
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+}
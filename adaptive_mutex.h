@@ -0,0 +1,128 @@
+#ifndef ADAPTIVE_MUTEX_H
+#define ADAPTIVE_MUTEX_H
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+
+namespace MyServer
+{
+    /**
+     * @brief 先自旋再睡眠的互斥锁
+     * @details 无竞争时加解锁各一次原子操作；有竞争时先自旋一小段时间，仍拿不到锁就在futex上睡眠，
+     *          不会像Spinlock那样在持锁线程阻塞（如写文件）时让等待者占满CPU。
+     *          自旋次数根据最近几次拿到锁所需的自旋次数自适应调整，自旋失败时减少，持锁时间长的锁很快就只做最少的自旋。
+     *          futex的三态协议：0未加锁，1加锁且无等待者，2加锁且可能有等待者，只有状态为2时解锁才需要唤醒
+     *
+     *          打开SetProfiling后记录所有AdaptiveMutex的等待时间和持有时间分布，以及等待最久的调用点，
+     *          关闭时只多一次relaxed读
+     */
+    class AdaptiveMutex
+    {
+    public:
+        /**
+         * @brief 局部锁，构造时加锁，析构时解锁
+         */
+        class Lock
+        {
+        public:
+            explicit Lock(AdaptiveMutex &mutex) : m_mutex(mutex)
+            {
+                m_mutex.lock();
+                m_locked = true;
+            }
+
+            ~Lock() { unlock(); }
+
+            void lock()
+            {
+                if (!m_locked)
+                {
+                    m_mutex.lock();
+                    m_locked = true;
+                }
+            }
+
+            void unlock()
+            {
+                if (m_locked)
+                {
+                    m_mutex.unlock();
+                    m_locked = false;
+                }
+            }
+
+            Lock(const Lock &) = delete;
+            Lock &operator=(const Lock &) = delete;
+
+        private:
+            AdaptiveMutex &m_mutex;
+            bool m_locked = false;
+        };
+
+        AdaptiveMutex() {}
+        AdaptiveMutex(const AdaptiveMutex &) = delete;
+        AdaptiveMutex &operator=(const AdaptiveMutex &) = delete;
+
+        void lock()
+        {
+            int expected = 0;
+            if (!s_profiling.load(std::memory_order_relaxed) &&
+                m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+                return;
+            lockSlow();
+        }
+
+        bool tryLock()
+        {
+            int expected = 0;
+            return m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        void unlock()
+        {
+            if (s_profiling.load(std::memory_order_relaxed))
+                recordHold();
+            if (m_state.exchange(0, std::memory_order_release) == 2)
+                wake();
+        }
+
+        /**
+         * @brief 打开或关闭竞争剖析，对所有AdaptiveMutex生效
+         */
+        static void SetProfiling(bool v);
+        static bool IsProfiling() { return s_profiling.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief 清空剖析结果
+         */
+        static void ResetProfile();
+
+        /**
+         * @brief 剖析结果转为yaml string：等待时间和持有时间的分位数（纳秒），以及等待最久的调用点
+         * @param[in] top 输出的调用点个数
+         */
+        static std::string ProfileToYamlString(size_t top = 10);
+
+    private:
+        /**
+         * @brief 自旋、睡眠以及剖析，不内联，返回地址即调用点
+         */
+        void lockSlow();
+
+        void recordHold();
+
+        void wake();
+
+    private:
+        std::atomic<int> m_state{0};
+        // 最近拿到锁所需自旋次数的滑动平均，自旋失败时减半
+        std::atomic<int> m_spins{0};
+        // 剖析时记录加锁时间，用于计算持有时间，0表示加锁时未在剖析
+        uint64_t m_acquireTime = 0;
+
+        static std::atomic<bool> s_profiling;
+    };
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h> // for __rdtsc()
+#endif
+#include "clock.h"
+#include "thread_registry.h"
+
+namespace MyServer
+{
+    static std::atomic<int> s_default_mode{Clock::PRECISE};
+
+    static inline uint64_t ReadClock(clockid_t id)
+    {
+        struct timespec ts;
+        clock_gettime(id, &ts);
+        return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    const char *Clock::ModeToString(Mode mode)
+    {
+        switch (mode)
+        {
+#define XX(name)      \
+    case Clock::name: \
+        return #name;
+            XX(PRECISE);
+            XX(COARSE);
+            XX(TSC);
+#undef XX
+        default:
+            return "PRECISE";
+        }
+        return "PRECISE";
+    }
+
+    Clock::Mode Clock::ModeFromString(const std::string &str)
+    {
+#define XX(mode, v)          \
+    if (str == #v)           \
+    {                        \
+        return Clock::mode;  \
+    }
+        XX(COARSE, coarse);
+        XX(TSC, tsc);
+        XX(COARSE, COARSE);
+        XX(TSC, TSC);
+#undef XX
+        return Clock::PRECISE;
+    }
+
+    void Clock::SetDefaultMode(Mode mode)
+    {
+        s_default_mode.store(mode, std::memory_order_relaxed);
+    }
+
+    Clock::Mode Clock::GetDefaultMode()
+    {
+        return (Mode)s_default_mode.load(std::memory_order_relaxed);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    static const uint64_t s_tsc_resync_ns = 1000000000ull;     // 稳定后每秒与CLOCK_MONOTONIC对齐一次
+    static const uint64_t s_tsc_first_resync_ns = 50000000ull; // 首次对齐间隔，之后逐次翻倍到s_tsc_resync_ns
+    static const uint64_t s_tsc_calibrate_ns = 5000000ull;     // 首次校准的采样时长
+    static const uint64_t s_tsc_stale_ns = 4 * s_tsc_resync_ns; // 超过这么久没有对齐时由取时的线程补做，见monotonicNS
+
+    /**
+     * @brief TSC到纳秒的换算参数，使用seqlock保护，读取方不加锁
+     * @details 定期对齐由后台线程完成，取时的路径上只有rdtsc和一次乘法
+     */
+    class TscClock
+    {
+    public:
+        TscClock()
+        {
+            unsigned eax, ebx, ecx, edx;
+            // CPUID.80000007H:EDX[8] 恒定频率TSC，不随变频和C-state变化
+            m_available = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+            if (!m_available)
+                return;
+            uint64_t tsc0 = 0, mono0 = 0, tsc1 = 0, mono1 = 0;
+            sample(tsc0, mono0);
+            do
+            {
+                sample(tsc1, mono1);
+            } while (mono1 - mono0 < s_tsc_calibrate_ns);
+            store(tsc1, mono1, mono1, ((mono1 - mono0) << 32) / (tsc1 - tsc0), ReadClock(CLOCK_REALTIME) - ReadClock(CLOCK_MONOTONIC));
+            std::thread(&TscClock::run, this).detach();
+        }
+
+        bool available() const { return m_available; }
+
+        /**
+         * @brief 返回单调时间，real_offset非空时一并返回CLOCK_REALTIME与CLOCK_MONOTONIC之差
+         */
+        uint64_t monotonicNS(int64_t *real_offset = nullptr)
+        {
+            uint64_t tsc, base_tsc, base_ns, mult;
+            int64_t offset;
+            load(base_tsc, base_ns, mult, offset, &tsc);
+            // rdtsc不是串行化指令，且各核的TSC之间可能有少许偏差，读到的值仍可能略早于基准，此时按基准时间返回
+            int64_t delta = (int64_t)(tsc - base_tsc);
+            uint64_t ns = base_ns + (delta > 0 ? (uint64_t)(((__uint128_t)delta * mult) >> 32) : 0);
+            // 后台线程没能按时对齐（例如fork出的子进程中没有这个线程）时才由这里补做
+            if (ns - base_ns >= s_tsc_stale_ns)
+                resync();
+            if (real_offset)
+                *real_offset = offset;
+            return ns;
+        }
+
+    private:
+        // 用两次rdtsc夹住clock_gettime，取中点作为对应的TSC值；重复几次取间隔最短的一次，减少被打断的影响
+        static void sample(uint64_t &tsc, uint64_t &mono)
+        {
+            tsc = 0;
+            mono = 0;
+            uint64_t best = UINT64_MAX;
+            for (int i = 0; i < 5; ++i)
+            {
+                uint64_t t0 = __rdtsc();
+                uint64_t ns = ReadClock(CLOCK_MONOTONIC);
+                uint64_t t1 = __rdtsc();
+                if (t1 - t0 < best)
+                {
+                    best = t1 - t0;
+                    tsc = t0 + (t1 - t0) / 2;
+                    mono = ns;
+                }
+            }
+        }
+
+        /**
+         * @brief 读取一致的换算参数，now非空时在同一次快照内读取rdtsc，避免读到比基准更早的TSC
+         */
+        void load(uint64_t &tsc, uint64_t &ns, uint64_t &mult, int64_t &real_offset, uint64_t *now = nullptr)
+        {
+            uint32_t seq0, seq1;
+            do
+            {
+                seq0 = m_seq.load(std::memory_order_acquire);
+                tsc = m_tsc.load(std::memory_order_relaxed);
+                ns = m_ns.load(std::memory_order_relaxed);
+                mult = m_mult.load(std::memory_order_relaxed);
+                real_offset = m_realOffset.load(std::memory_order_relaxed);
+                if (now)
+                    *now = __rdtsc();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                seq1 = m_seq.load(std::memory_order_relaxed);
+            } while ((seq0 & 1) || seq0 != seq1);
+        }
+
+        void store(uint64_t tsc, uint64_t ns, uint64_t mono, uint64_t mult, int64_t real_offset)
+        {
+            m_seq.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_tsc.store(tsc, std::memory_order_relaxed);
+            m_ns.store(ns, std::memory_order_relaxed);
+            m_mono.store(mono, std::memory_order_relaxed);
+            m_mult.store(mult, std::memory_order_relaxed);
+            m_realOffset.store(real_offset, std::memory_order_relaxed);
+            m_seq.fetch_add(1, std::memory_order_release);
+        }
+
+        /**
+         * @brief 重新对齐：频率按上一周期内TSC与CLOCK_MONOTONIC的实际增量重新计算，
+         *        新的基准取外推值与实际值中较大者，保证不回退
+         */
+        void resync()
+        {
+            bool expected = false;
+            if (!m_resyncing.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return;
+            uint64_t base_tsc, base_ns, mult;
+            int64_t real_offset;
+            load(base_tsc, base_ns, mult, real_offset);
+            uint64_t base_mono = m_mono.load(std::memory_order_relaxed);
+            uint64_t tsc = 0, mono = 0;
+            sample(tsc, mono);
+            if (tsc > base_tsc && mono > base_mono)
+            {
+                uint64_t extrapolated = base_ns + (uint64_t)(((__uint128_t)(tsc - base_tsc) * mult) >> 32);
+                uint64_t new_mult = (uint64_t)(((__uint128_t)(mono - base_mono) << 32) / (tsc - base_tsc));
+                store(tsc, extrapolated > mono ? extrapolated : mono, mono, new_mult,
+                      ReadClock(CLOCK_REALTIME) - ReadClock(CLOCK_MONOTONIC));
+                uint64_t interval = m_resyncInterval.load(std::memory_order_relaxed);
+                if (interval < s_tsc_resync_ns)
+                    m_resyncInterval.store(interval * 2 < s_tsc_resync_ns ? interval * 2 : s_tsc_resync_ns, std::memory_order_relaxed);
+            }
+            m_resyncing.store(false, std::memory_order_release);
+        }
+
+        // 后台对齐线程，间隔从s_tsc_first_resync_ns逐次翻倍到s_tsc_resync_ns
+        void run()
+        {
+            ThreadRegistry::Register("tsc_resync");
+            while (true)
+            {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(m_resyncInterval.load(std::memory_order_relaxed)));
+                resync();
+            }
+        }
+
+    private:
+        bool m_available = false;
+        std::atomic<uint32_t> m_seq{0};           // seqlock序号，奇数表示正在更新
+        std::atomic<uint64_t> m_tsc{0};           // 基准TSC
+        std::atomic<uint64_t> m_ns{0};            // 基准TSC对应的输出时间
+        std::atomic<uint64_t> m_mono{0};          // 基准TSC对应的CLOCK_MONOTONIC实际值
+        std::atomic<uint64_t> m_mult{0};          // 每个tick的纳秒数，32位定点小数
+        std::atomic<int64_t> m_realOffset{0};     // CLOCK_REALTIME与CLOCK_MONOTONIC之差
+        std::atomic<bool> m_resyncing{false};
+        std::atomic<uint64_t> m_resyncInterval{s_tsc_first_resync_ns}; // 当前对齐间隔
+    };
+
+    static TscClock &GetTscClock()
+    {
+        // 后台线程一直引用它，有意不析构
+        static TscClock *s_tsc = new TscClock;
+        return *s_tsc;
+    }
+#endif
+
+    bool Clock::TscAvailable()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return GetTscClock().available();
+#else
+        return false;
+#endif
+    }
+
+    uint64_t Clock::NowNS(Mode mode)
+    {
+        switch (mode)
+        {
+        case COARSE:
+            return ReadClock(CLOCK_REALTIME_COARSE);
+        case TSC:
+#if defined(__x86_64__) || defined(__i386__)
+            if (GetTscClock().available())
+            {
+                int64_t offset;
+                uint64_t ns = GetTscClock().monotonicNS(&offset);
+                return ns + offset;
+            }
+#endif
+            return ReadClock(CLOCK_REALTIME);
+        default:
+            return ReadClock(CLOCK_REALTIME);
+        }
+    }
+
+    uint64_t Clock::MonotonicNS(Mode mode)
+    {
+        switch (mode)
+        {
+        case COARSE:
+            return ReadClock(CLOCK_MONOTONIC_COARSE);
+        case TSC:
+#if defined(__x86_64__) || defined(__i386__)
+            if (GetTscClock().available())
+                return GetTscClock().monotonicNS();
+#endif
+            return ReadClock(CLOCK_MONOTONIC);
+        default:
+            return ReadClock(CLOCK_MONOTONIC);
+        }
+    }
+
+} // namespace MyServer
@@ -0,0 +1,73 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <string>
+
+namespace MyServer
+{
+    /**
+     * @brief 时钟服务
+     * @details 提供三种取时方式：
+     *  - PRECISE 读CLOCK_REALTIME/CLOCK_MONOTONIC，由vDSO提供，不陷入内核，纳秒精度
+     *  - COARSE  读CLOCK_REALTIME_COARSE/CLOCK_MONOTONIC_COARSE，只读取内核上一个时钟节拍的时间，
+     *            开销最低，精度为一个节拍（1~4ms）
+     *  - TSC     读rdtsc并按校准出的频率换算，由一个后台线程定期（稳定后每秒）与CLOCK_MONOTONIC重新对齐以修正漂移，
+     *            保证单调不回退；非x86或CPU不支持恒定频率TSC时退化为PRECISE
+     *  不带mode参数的接口使用进程默认模式，默认为PRECISE
+     */
+    class Clock
+    {
+    public:
+        enum Mode
+        {
+            PRECISE = 0,
+            COARSE = 1,
+            TSC = 2,
+        };
+
+        /**
+         * @brief 模式转字符串
+         */
+        static const char *ModeToString(Mode mode);
+
+        /**
+         * @brief 字符串转模式，无法识别时返回PRECISE
+         */
+        static Mode ModeFromString(const std::string &str);
+
+        /**
+         * @brief 设置进程默认模式
+         */
+        static void SetDefaultMode(Mode mode);
+        static Mode GetDefaultMode();
+
+        /**
+         * @brief TSC模式是否可用
+         */
+        static bool TscAvailable();
+
+        /**
+         * @brief 当前UTC时间
+         */
+        static uint64_t NowNS(Mode mode);
+        static uint64_t NowUS(Mode mode) { return NowNS(mode) / 1000; }
+        static uint64_t NowMS(Mode mode) { return NowNS(mode) / 1000000; }
+        static uint64_t NowNS() { return NowNS(GetDefaultMode()); }
+        static uint64_t NowUS() { return NowNS() / 1000; }
+        static uint64_t NowMS() { return NowNS() / 1000000; }
+
+        /**
+         * @brief 单调时间，适合计算耗时，不受系统时间调整影响
+         */
+        static uint64_t MonotonicNS(Mode mode);
+        static uint64_t MonotonicUS(Mode mode) { return MonotonicNS(mode) / 1000; }
+        static uint64_t MonotonicMS(Mode mode) { return MonotonicNS(mode) / 1000000; }
+        static uint64_t MonotonicNS() { return MonotonicNS(GetDefaultMode()); }
+        static uint64_t MonotonicUS() { return MonotonicNS() / 1000; }
+        static uint64_t MonotonicMS() { return MonotonicNS() / 1000000; }
+    };
+
+} // namespace MyServer
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <charconv>
+#include <new>
+#include "format.h"
+
+namespace MyServer
+{
+    void FormatBuffer::grow(size_t need)
+    {
+        size_t capacity = m_capacity * 2;
+        if (capacity < need)
+            capacity = need;
+        char *data = (char *)malloc(capacity);
+        if (data == nullptr)
+            throw std::bad_alloc();
+        memcpy(data, m_data, m_size);
+        if (m_data != m_inline)
+            free(m_data);
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    static const char s_digits[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    char *FormatUInt(char *end, uint64_t v)
+    {
+        char *p = end;
+        while (v >= 100)
+        {
+            unsigned idx = (v % 100) * 2;
+            v /= 100;
+            *--p = s_digits[idx + 1];
+            *--p = s_digits[idx];
+        }
+        if (v >= 10)
+        {
+            *--p = s_digits[v * 2 + 1];
+            *--p = s_digits[v * 2];
+        }
+        else
+        {
+            *--p = (char)('0' + v);
+        }
+        return p;
+    }
+
+    char *FormatInt(char *end, int64_t v)
+    {
+        if (v >= 0)
+            return FormatUInt(end, v);
+        char *p = FormatUInt(end, 0 - (uint64_t)v);
+        *--p = '-';
+        return p;
+    }
+
+    char *FormatPointer(char *end, const void *p)
+    {
+        static const char s_hex[] = "0123456789abcdef";
+        uintptr_t v = (uintptr_t)p;
+        char *ptr = end;
+        do
+        {
+            *--ptr = s_hex[v & 0xf];
+            v >>= 4;
+        } while (v);
+        *--ptr = 'x';
+        *--ptr = '0';
+        return ptr;
+    }
+
+    size_t FormatDouble(char *out, double v)
+    {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        std::to_chars_result rt = std::to_chars(out, out + FORMAT_NUMBER_SIZE, v);
+        return rt.ptr - out;
+#else
+        int len = snprintf(out, FORMAT_NUMBER_SIZE, "%.17g", v);
+        return len > 0 ? len : 0;
+#endif
+    }
+
+    size_t FormatDouble(char *out, float v)
+    {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        std::to_chars_result rt = std::to_chars(out, out + FORMAT_NUMBER_SIZE, v);
+        return rt.ptr - out;
+#else
+        int len = snprintf(out, FORMAT_NUMBER_SIZE, "%.9g", v);
+        return len > 0 ? len : 0;
+#endif
+    }
+
+} // namespace MyServer
@@ -0,0 +1,346 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <streambuf>
+#include <type_traits>
+
+namespace MyServer
+{
+    /**
+     * @brief 格式化缓冲区
+     * @details 先使用对象内部的栈空间，内容超过s_inline_size才在堆上扩容，常见长度的日志不需要分配内存
+     */
+    class FormatBuffer
+    {
+    public:
+        FormatBuffer() : m_data(m_inline) {}
+        ~FormatBuffer()
+        {
+            if (m_data != m_inline)
+                free(m_data);
+        }
+        FormatBuffer(const FormatBuffer &) = delete;
+        FormatBuffer &operator=(const FormatBuffer &) = delete;
+
+        /**
+         * @brief 保证还能写入len字节，返回写入位置，写完后调用commit
+         */
+        char *reserve(size_t len)
+        {
+            if (m_size + len > m_capacity)
+                grow(m_size + len);
+            return m_data + m_size;
+        }
+
+        void commit(size_t len) { m_size += len; }
+
+        void append(const char *data, size_t len)
+        {
+            memcpy(reserve(len), data, len);
+            m_size += len;
+        }
+
+        void push_back(char c)
+        {
+            *reserve(1) = c;
+            ++m_size;
+        }
+
+        const char *data() const { return m_data; }
+        size_t size() const { return m_size; }
+        void clear() { m_size = 0; }
+        std::string_view view() const { return std::string_view(m_data, m_size); }
+        std::string str() const { return std::string(m_data, m_size); }
+
+    private:
+        void grow(size_t need);
+
+    private:
+        static const size_t s_inline_size = 512;
+        char *m_data;                 // 当前使用的空间，指向m_inline或堆内存
+        size_t m_size = 0;            // 已写入长度
+        size_t m_capacity = s_inline_size;
+        char m_inline[s_inline_size]; // 内部栈空间
+    };
+
+    /**
+     * @brief 写入std::streambuf的格式化目标，如日志事件的stringstream，内容直接进入流的缓冲区
+     */
+    class StreamFormatSink
+    {
+    public:
+        explicit StreamFormatSink(std::streambuf *buf) : m_buf(buf) {}
+
+        void append(const char *data, size_t len) { m_buf->sputn(data, len); }
+        void push_back(char c) { m_buf->sputc(c); }
+
+    private:
+        std::streambuf *m_buf;
+    };
+
+    /**
+     * @brief 数值格式化的临时空间大小，足够容纳任意整数、浮点数和指针
+     */
+    static const size_t FORMAT_NUMBER_SIZE = 32;
+
+    /**
+     * @brief 整数转十进制，每次处理两位，从end向前写入
+     * @return 第一个字符的位置
+     */
+    char *FormatUInt(char *end, uint64_t v);
+    char *FormatInt(char *end, int64_t v);
+
+    /**
+     * @brief 指针转为0x开头的十六进制，从end向前写入
+     * @return 第一个字符的位置
+     */
+    char *FormatPointer(char *end, const void *p);
+
+    /**
+     * @brief 浮点数转能精确还原该值的最短形式，从out开始写入
+     * @return 写入的长度
+     */
+    size_t FormatDouble(char *out, double v);
+
+    /**
+     * @brief float按单精度取最短形式，0.1f输出0.1而不是转为double后的0.10000000149011612
+     * @return 写入的长度
+     */
+    size_t FormatDouble(char *out, float v);
+
+    /**
+     * @brief 把一个参数追加到sink，不支持的类型在编译期报错
+     * @details Sink是FormatBuffer、StreamFormatSink或其他提供append(const char *, size_t)和push_back(char)的类型
+     */
+    template <class Sink, class T>
+    void FormatValue(Sink &buf, const T &v)
+    {
+        typedef typename std::decay<T>::type U;
+        char tmp[FORMAT_NUMBER_SIZE];
+        char *end = tmp + sizeof(tmp);
+        if constexpr (std::is_same<U, bool>::value)
+        {
+            if (v)
+                buf.append("true", 4);
+            else
+                buf.append("false", 5);
+        }
+        else if constexpr (std::is_same<U, char>::value)
+        {
+            buf.push_back(v);
+        }
+        else if constexpr (std::is_integral<U>::value && std::is_signed<U>::value)
+        {
+            char *p = FormatInt(end, v);
+            buf.append(p, end - p);
+        }
+        else if constexpr (std::is_integral<U>::value)
+        {
+            char *p = FormatUInt(end, v);
+            buf.append(p, end - p);
+        }
+        else if constexpr (std::is_same<U, float>::value)
+        {
+            buf.append(tmp, FormatDouble(tmp, v));
+        }
+        else if constexpr (std::is_floating_point<U>::value)
+        {
+            buf.append(tmp, FormatDouble(tmp, (double)v));
+        }
+        else if constexpr (std::is_enum<U>::value)
+        {
+            FormatValue(buf, (typename std::underlying_type<U>::type)v);
+        }
+        else if constexpr (std::is_same<U, const char *>::value || std::is_same<U, char *>::value)
+        {
+            if (v)
+                buf.append(v, strlen(v));
+            else
+                buf.append("(null)", 6);
+        }
+        else if constexpr (std::is_convertible<const T &, std::string_view>::value)
+        {
+            std::string_view str = v;
+            buf.append(str.data(), str.size());
+        }
+        else if constexpr (std::is_pointer<U>::value)
+        {
+            char *p = FormatPointer(end, (const void *)v);
+            buf.append(p, end - p);
+        }
+        else
+        {
+            static_assert(!sizeof(T), "unsupported argument type for FormatTo");
+        }
+    }
+
+    /**
+     * @brief 统计格式串中占位符的个数，格式串非法时返回-1
+     * @details "{}"是占位符，"{{"和"}}"分别输出'{'和'}'，其余出现的'{'、'}'都视为非法
+     */
+    constexpr int FormatArgCount(const char *fmt)
+    {
+        int n = 0;
+        for (; *fmt; ++fmt)
+        {
+            if (*fmt == '{')
+            {
+                if (fmt[1] == '}')
+                    ++n;
+                else if (fmt[1] != '{')
+                    return -1;
+                ++fmt;
+            }
+            else if (*fmt == '}')
+            {
+                if (fmt[1] != '}')
+                    return -1;
+                ++fmt;
+            }
+        }
+        return n;
+    }
+
+    /**
+     * @brief 输出fmt中下一个占位符之前的文本，返回占位符之后的位置，没有占位符时返回nullptr
+     */
+    template <class Sink>
+    const char *FormatLiteral(Sink &buf, const char *fmt)
+    {
+        const char *start = fmt;
+        for (;; ++fmt)
+        {
+            char c = *fmt;
+            if (c == '\0')
+            {
+                if (fmt != start)
+                    buf.append(start, fmt - start);
+                return nullptr;
+            }
+            if (c != '{' && c != '}')
+                continue;
+            if (fmt != start)
+                buf.append(start, fmt - start);
+            if (c == '{' && fmt[1] == '}')
+                return fmt + 2;
+            // "{{"、"}}"输出一个字符，不成对的括号原样输出
+            buf.push_back(c);
+            if (fmt[1] == c)
+                ++fmt;
+            start = fmt + 1;
+        }
+    }
+
+    template <class Sink>
+    void FormatArgs(Sink &buf, const char *fmt)
+    {
+        // 参数比占位符少时，剩余的占位符原样输出
+        while ((fmt = FormatLiteral(buf, fmt)) != nullptr)
+            buf.append("{}", 2);
+    }
+
+    template <class Sink, class T, class... Args>
+    void FormatArgs(Sink &buf, const char *fmt, const T &v, const Args &...args)
+    {
+        fmt = FormatLiteral(buf, fmt);
+        if (fmt == nullptr)
+            return; // 参数比占位符多时忽略多余参数
+        FormatValue(buf, v);
+        FormatArgs(buf, fmt, args...);
+    }
+
+    /**
+     * @brief 编译期格式串的基类，由MYSERVER_FMT生成派生类型，其静态成员函数Get()返回格式串
+     */
+    struct FormatStringTag
+    {
+    };
+
+    /**
+     * @brief 运行期才确定的格式串，不做检查，见FormatRuntime
+     */
+    struct RuntimeFormat
+    {
+        const char *str;
+    };
+
+    /**
+     * @brief 显式标明格式串在运行期确定，跳过编译期检查
+     */
+    inline RuntimeFormat FormatRuntime(const char *fmt) { return RuntimeFormat{fmt}; }
+
+    /**
+     * @brief 检查格式串类型：MYSERVER_FMT生成的格式串在编译期检查合法性和占位符个数，RuntimeFormat不检查
+     * @return 格式串
+     */
+    template <class S, size_t N>
+    constexpr const char *FormatCheck(const S &fmt)
+    {
+        if constexpr (std::is_same<S, RuntimeFormat>::value)
+        {
+            return fmt.str;
+        }
+        else
+        {
+            static_assert(std::is_base_of<FormatStringTag, S>::value,
+                          "format string must be MYSERVER_FMT(\"...\") or FormatRuntime(str)");
+            static_assert(FormatArgCount(S::Get()) >= 0, "invalid format string");
+            static_assert(FormatArgCount(S::Get()) == (int)N, "format placeholder count does not match argument count");
+            return S::Get();
+        }
+    }
+
+    /**
+     * @brief {}风格的格式化，结果追加到buf
+     * @details 每个"{}"按顺序替换为一个参数。fmt为MYSERVER_FMT("...")时在编译期检查，
+     *          运行期确定的格式串需用FormatRuntime(str)包装，直接传字符串编译报错
+     * @code
+     *  FormatBuffer buf;
+     *  FormatTo(buf, MYSERVER_FMT("user {} login from {}:{}"), name, ip, port);
+     * @endcode
+     */
+    template <class Sink, class S, class... Args>
+    void FormatTo(Sink &buf, const S &fmt, const Args &...args)
+    {
+        FormatArgs(buf, FormatCheck<S, sizeof...(Args)>(fmt), args...);
+    }
+
+    /**
+     * @brief {}风格的格式化，返回格式化后的string，格式串要求同FormatTo
+     */
+    template <class S, class... Args>
+    std::string FormatToString(const S &fmt, const Args &...args)
+    {
+        FormatBuffer buf;
+        FormatArgs(buf, FormatCheck<S, sizeof...(Args)>(fmt), args...);
+        return buf.str();
+    }
+
+} // namespace MyServer
+
+/**
+ * @brief 编译期格式串，fmt必须是字符串字面量，交给FormatTo、FormatToString、LogEvent::format时在编译期检查
+ */
+#define MYSERVER_FMT(fmt)                                      \
+    ([] {                                                      \
+        struct FormatString : MyServer::FormatStringTag        \
+        {                                                      \
+            static constexpr const char *Get() { return fmt; } \
+        };                                                     \
+        return FormatString();                                 \
+    }())
+
+/**
+ * @brief 经过编译期检查的{}风格格式化，返回std::string
+ * @code
+ *  std::string s = MYSERVER_FORMAT("user {} login from {}:{}", name, ip, port);
+ * @endcode
+ */
+#define MYSERVER_FORMAT(fmt, ...) MyServer::FormatToString(MYSERVER_FMT(fmt), ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,134 @@
+#include <string.h>
+#include <iostream>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include "intern.h"
+
+namespace MyServer
+{
+    namespace
+    {
+        static const uint32_t s_chunk_bits = 12;                // 每块4096个字符串
+        static const uint32_t s_chunk_size = 1u << s_chunk_bits;
+        static const uint32_t s_max_chunks = 1024;              // 最多约400万个字符串
+        static const size_t s_shards = 16;                      // 驻留哈希表分片数
+        static const size_t s_arena_block = 64 * 1024;          // 字符串内容按块分配
+
+        struct Shard
+        {
+            std::mutex mutex;
+            std::unordered_map<std::string_view, uint32_t> ids; // 键指向驻留后的内容
+        };
+
+        struct InternState
+        {
+            // 分块只分配不释放，已分配块的地址不变，Lookup无需加锁
+            std::atomic<std::string_view *> chunks[s_max_chunks];
+            std::atomic<uint32_t> size{0};
+
+            std::mutex appendMutex; // 分配id和字符串内容
+            char *arena = nullptr;
+            size_t arenaLeft = 0;
+
+            Shard shards[s_shards];
+
+            InternState()
+            {
+                for (auto &i : chunks)
+                {
+                    i.store(nullptr, std::memory_order_relaxed);
+                }
+                chunks[0].store(new std::string_view[s_chunk_size], std::memory_order_relaxed);
+                size.store(1, std::memory_order_release); // id 0为空字符串
+            }
+
+            /**
+             * @brief 复制字符串内容，调用方持有appendMutex
+             */
+            const char *copy(std::string_view str)
+            {
+                if (str.size() > s_arena_block / 4)
+                {
+                    char *p = new char[str.size()];
+                    memcpy(p, str.data(), str.size());
+                    return p;
+                }
+                if (str.size() > arenaLeft)
+                {
+                    arena = new char[s_arena_block];
+                    arenaLeft = s_arena_block;
+                }
+                char *p = arena;
+                memcpy(p, str.data(), str.size());
+                arena += str.size();
+                arenaLeft -= str.size();
+                return p;
+            }
+
+            /**
+             * @brief 追加一个字符串，调用方持有所在分片的锁
+             * @return 新id，表已满时返回EMPTY_ID
+             */
+            uint32_t append(std::string_view str, std::string_view &stored)
+            {
+                std::lock_guard<std::mutex> lock(appendMutex);
+                uint32_t id = size.load(std::memory_order_relaxed);
+                uint32_t chunk = id >> s_chunk_bits;
+                if (chunk >= s_max_chunks)
+                    return SymbolTable::EMPTY_ID;
+                std::string_view *slots = chunks[chunk].load(std::memory_order_relaxed);
+                if (!slots)
+                {
+                    slots = new std::string_view[s_chunk_size];
+                    chunks[chunk].store(slots, std::memory_order_release);
+                }
+                stored = std::string_view(copy(str), str.size());
+                slots[id & (s_chunk_size - 1)] = stored;
+                size.store(id + 1, std::memory_order_release);
+                return id;
+            }
+        };
+
+        static InternState &GetState()
+        {
+            static InternState *s_state = new InternState; // 驻留的字符串在静态对象析构期间仍可能被引用，不析构
+            return *s_state;
+        }
+    }
+
+    uint32_t SymbolTable::Intern(std::string_view str)
+    {
+        if (str.empty())
+            return EMPTY_ID;
+        InternState &st = GetState();
+        Shard &shard = st.shards[std::hash<std::string_view>()(str) % s_shards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.ids.find(str);
+        if (it != shard.ids.end())
+            return it->second;
+        std::string_view stored;
+        uint32_t id = st.append(str, stored);
+        if (id == EMPTY_ID)
+        {
+            std::cout << "[ERROR] SymbolTable::Intern table is full, str=" << str << std::endl;
+            return EMPTY_ID;
+        }
+        shard.ids.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view SymbolTable::Lookup(uint32_t id)
+    {
+        InternState &st = GetState();
+        if (id >= st.size.load(std::memory_order_acquire))
+            return std::string_view();
+        std::string_view *slots = st.chunks[id >> s_chunk_bits].load(std::memory_order_acquire);
+        return slots[id & (s_chunk_size - 1)];
+    }
+
+    uint32_t SymbolTable::Size()
+    {
+        return GetState().size.load(std::memory_order_acquire);
+    }
+}
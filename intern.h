@@ -0,0 +1,40 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+namespace MyServer
+{
+    /**
+     * @brief 进程级字符串驻留表，把日志器名称、线程名称等反复出现的字符串映射为稳定的id
+     * @details 只增不删：字符串一旦驻留，其id和内容在进程生命周期内不变，返回的string_view始终有效。
+     *          Intern按哈希分片加锁，不同分片的字符串互不阻塞；Lookup不加锁，按id直接读分块数组。
+     *          id 0固定表示空字符串。适合取值有限的字符串，不要驻留日志内容等无限增长的数据
+     */
+    class SymbolTable
+    {
+    public:
+        static const uint32_t EMPTY_ID = 0;
+
+        /**
+         * @brief 驻留字符串
+         * @return 字符串的id，相同的字符串总是返回相同的id
+         */
+        static uint32_t Intern(std::string_view str);
+
+        /**
+         * @brief 根据id取字符串
+         * @return 驻留的字符串，id无效时返回空字符串
+         */
+        static std::string_view Lookup(uint32_t id);
+
+        /**
+         * @brief 已驻留的字符串个数，包括空字符串
+         */
+        static uint32_t Size();
+    };
+}
+
+#endif
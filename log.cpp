@@ -1,4 +1,21 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fnmatch.h>
+#include <algorithm>
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <thread>
 #include "log.h"
+#include "util.h"
+#include "clock.h"
+#include "thread_registry.h"
 
 namespace MyServer
 {
@@ -54,10 +71,49 @@ namespace MyServer
 
     LogEvent::LogEvent(const std::string &logger_name, LogLevel::Level level, const char *file, int32_t line,
                        int64_t elapse, uint32_t thread_id, uint64_t fiber_id, time_t time, const std::string &thread_name)
-        : m_level(level), m_file(file), m_line(line), m_elapse(elapse), m_threadId(thread_id), m_fiberId(fiber_id), m_time(time), m_threadName(thread_name), m_loggerName(logger_name)
+        : m_level(level), m_file(file), m_line(line), m_elapse(elapse), m_threadId(thread_id), m_fiberId(fiber_id), m_time(time),
+          m_threadNameId(SymbolTable::Intern(thread_name)), m_loggerNameId(SymbolTable::Intern(logger_name))
     {
     }
 
+    LogEvent::LogEvent(uint32_t logger_name_id, LogLevel::Level level, const char *file, int32_t line,
+                       int64_t elapse, uint32_t thread_id, uint64_t fiber_id, time_t time, uint32_t thread_name_id)
+        : m_level(level), m_file(file), m_line(line), m_elapse(elapse), m_threadId(thread_id), m_fiberId(fiber_id), m_time(time),
+          m_threadNameId(thread_name_id), m_loggerNameId(logger_name_id)
+    {
+    }
+
+    namespace
+    {
+        /*
+        @brief 读取stringbuf的写入区指针，通过派生类取得受保护成员函数的成员指针，不复制内容
+        */
+        struct StringBufAccess : public std::stringbuf
+        {
+            static std::string_view View(const std::streambuf *buf)
+            {
+                typedef char *(std::streambuf::*Getter)() const;
+                Getter pbase = &StringBufAccess::pbase;
+                Getter pptr = &StringBufAccess::pptr;
+                Getter egptr = &StringBufAccess::egptr;
+                const char *begin = (buf->*pbase)();
+                const char *end = (buf->*pptr)();
+                if (begin == nullptr)
+                    return std::string_view();
+                // 与stringbuf::str()一致，读写区共用同一块内存，内容结尾取两者中较大者
+                const char *get_end = (buf->*egptr)();
+                if (get_end > end)
+                    end = get_end;
+                return std::string_view(begin, end - begin);
+            }
+        };
+    }
+
+    std::string_view LogEvent::getContentView() const
+    {
+        return StringBufAccess::View(m_ss.rdbuf());
+    }
+
     void LogEvent::printf(const char *fmt, ...)
     {
         va_list ap;
@@ -68,13 +124,22 @@ namespace MyServer
 
     void LogEvent::vprintf(const char *fmt, va_list ap)
     {
-        char *buf = nullptr;
-        int len = vasprintf(&buf, fmt, ap);
-        if (len != -1)
+        // 大部分日志放得进栈上的缓冲区，放不下时才按实际长度分配一次
+        char buf[512];
+        va_list ap2;
+        va_copy(ap2, ap);
+        int len = vsnprintf(buf, sizeof(buf), fmt, ap2);
+        va_end(ap2);
+        if (len < 0)
+            return;
+        if (len < (int)sizeof(buf))
         {
-            m_ss << std::string(buf, len);
-            free(buf);
+            m_ss.write(buf, len);
+            return;
         }
+        std::string str(len, '\0');
+        vsnprintf(&str[0], len + 1, fmt, ap);
+        m_ss << str;
     }
 
     class MessageFormatItem : public LogFormatter::FormatItem
@@ -235,7 +300,7 @@ namespace MyServer
     };
 
     LogFormatter::LogFormatter(const std::string &pattern)
-        : m_pattern(pattern)
+        : m_pattern(pattern), m_patternId(SymbolTable::Intern(pattern))
     {
         init();
     }
@@ -372,7 +437,10 @@ namespace MyServer
     void LogAppender::setFormatter(LogFormatter::ptr fmt)
     {
         MutexType::Lock lock(m_mutex);
+        if (m_formatter && m_formatter != fmt)
+            m_replaced.push_back(m_formatter);
         m_formatter = fmt;
+        m_current.store(m_formatter ? m_formatter.get() : m_defaultformatter.get(), std::memory_order_release);
     }
 
     LogFormatter::ptr LogAppender::getFormatter()
@@ -386,6 +454,11 @@ namespace MyServer
         getFormatter()->format(std::cout, event);
     }
 
+    void StdoutLogAppender::logFormatted(LogEvent::ptr /*event*/, const char *data, size_t len)
+    {
+        std::cout.write(data, len);
+    }
+
     std::string StdoutLogAppender::toYamlString()
     {
         MutexType::Lock lock(m_mutex);
@@ -397,57 +470,705 @@ namespace MyServer
         return ss.str();
     }
 
-    FileLogAppender::FileLogAppender(const std::string &file)
-        : m_filename(file), LogAppender(LogFormatter::ptr(new LogFormatter))
+    static const size_t s_direct_align = 4096;             // O_DIRECT的块大小
+    static const size_t s_direct_capacity = 256 * 1024;    // O_DIRECT缓冲区大小
+    static const uint64_t s_direct_flush_interval = 1000;  // O_DIRECT缓冲区尾块最长滞留毫秒数
+    static const off_t s_dontneed_window = 4 * 1024 * 1024; // DONTNEED每写入多少字节处理一次
+    static const int s_watch_interval = 1;                  // 定期检查日志文件是否被替换的间隔秒数
+
+    const char *FileLogAppender::PolicyToString(IOPolicy policy)
+    {
+        switch (policy)
+        {
+#define XX(name)                \
+    case FileLogAppender::name: \
+        return #name;
+            XX(BUFFERED);
+            XX(SYNC);
+            XX(DIRECT);
+            XX(DONTNEED);
+#undef XX
+        default:
+            return "BUFFERED";
+        }
+        return "BUFFERED";
+    }
+
+    FileLogAppender::IOPolicy FileLogAppender::PolicyFromString(const std::string &str)
+    {
+#define XX(policy, v)                   \
+    if (str == #v)                      \
+    {                                   \
+        return FileLogAppender::policy; \
+    }
+        XX(SYNC, sync);
+        XX(DIRECT, direct);
+        XX(DONTNEED, dontneed);
+
+        XX(SYNC, SYNC);
+        XX(DIRECT, DIRECT);
+        XX(DONTNEED, DONTNEED);
+#undef XX
+        return FileLogAppender::BUFFERED;
+    }
+
+    /*
+    @brief 监视日志文件是否被移走或删除的后台线程，进程内所有FileLogAppender共用
+    @details inotify监听各文件所在目录的创建、删除、移入、移出事件，收到事件后立即检查；
+             另外每隔s_watch_interval秒比较一次路径与已打开文件的设备号和inode，覆盖inotify不可用、
+             监听数达到上限、网络文件系统、上级目录被移动等收不到事件的情况，以及上次打开失败后的重试
+    */
+    class FileLogAppender::Watcher
+    {
+    public:
+        static Watcher &GetInstance()
+        {
+            static Watcher *s_watcher = new Watcher; // 线程常驻到进程退出，不析构
+            return *s_watcher;
+        }
+
+        void add(FileLogAppender *appender)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_appenders.push_back(appender);
+            std::string dir = FSUtil::Dirname(appender->m_filename);
+            auto it = m_dirs.find(dir);
+            if (it != m_dirs.end())
+            {
+                ++it->second.refs;
+                return;
+            }
+            Dir &d = m_dirs[dir];
+            d.refs = 1;
+            d.wd = addWatch(dir);
+        }
+
+        /*
+        @brief 移除appender，返回后后台线程不会再访问它
+        @details 后台线程正在检查这个appender时等它检查完
+        */
+        void del(FileLogAppender *appender)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto pos = std::find(m_appenders.begin(), m_appenders.end(), appender);
+            if (pos == m_appenders.end())
+                return;
+            m_appenders.erase(pos);
+            m_cond.wait(lock, [&]() { return m_current != appender; });
+            auto it = m_dirs.find(FSUtil::Dirname(appender->m_filename));
+            if (it != m_dirs.end() && --it->second.refs == 0)
+            {
+                if (it->second.wd >= 0)
+                    inotify_rm_watch(m_inotifyFd, it->second.wd);
+                m_dirs.erase(it);
+            }
+        }
+
+    private:
+        struct Dir
+        {
+            int wd = -1; // inotify监听描述符，目录不存在或监听失败时为-1
+            int refs = 0;
+        };
+
+        Watcher()
+        {
+            m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (m_inotifyFd < 0)
+                std::cout << "[ERROR] FileLogAppender inotify_init1 error: " << strerror(errno)
+                          << ", fallback to periodic check" << std::endl;
+            std::thread(&Watcher::run, this).detach();
+        }
+
+        int addWatch(const std::string &dir)
+        {
+            if (m_inotifyFd < 0)
+                return -1;
+            return inotify_add_watch(m_inotifyFd, dir.c_str(),
+                                     IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+        }
+
+        /*
+        @brief 读出所有inotify事件，被删除目录的监听会失效，记下来等定期检查时重新监听
+        @return 是否有事件
+        */
+        bool drainEvents()
+        {
+            alignas(struct inotify_event) char buf[4096];
+            bool got = false;
+            ssize_t n;
+            while ((n = read(m_inotifyFd, buf, sizeof(buf))) > 0)
+            {
+                got = true;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (char *p = buf; p < buf + n;)
+                {
+                    struct inotify_event *ev = (struct inotify_event *)p;
+                    if (ev->mask & IN_IGNORED)
+                    {
+                        for (auto &i : m_dirs)
+                        {
+                            if (i.second.wd == ev->wd)
+                                i.second.wd = -1;
+                        }
+                    }
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+            return got;
+        }
+
+        /*
+        @brief 检查各appender是否需要重新打开
+        @details stat、open、刷盘都可能很慢，不能持有m_mutex做，否则期间add/del（即创建、析构appender）都被阻塞；
+                 先在锁内取出名单，再逐个标记为m_current后在锁外处理，del据此等待正在处理的appender
+        */
+        void check(bool rewatch)
+        {
+            std::vector<FileLogAppender *> targets;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (rewatch)
+                {
+                    for (auto &i : m_dirs)
+                    {
+                        if (i.second.wd < 0)
+                            i.second.wd = addWatch(i.first);
+                    }
+                }
+                targets = m_appenders;
+            }
+            for (auto i : targets)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (std::find(m_appenders.begin(), m_appenders.end(), i) == m_appenders.end())
+                        continue; // 取出名单后已被del
+                    m_current = i;
+                }
+                if (i->needReopen())
+                    i->reopen();
+                if (rewatch)
+                    i->flushDirectIfStale();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_current = nullptr;
+                m_cond.notify_all();
+            }
+        }
+
+        void run()
+        {
+            ThreadRegistry::Register("log_watcher");
+            uint64_t last_check = Clock::MonotonicMS();
+            while (true)
+            {
+                bool event = false;
+                if (m_inotifyFd >= 0)
+                {
+                    struct pollfd pfd = {m_inotifyFd, POLLIN, 0};
+                    if (poll(&pfd, 1, s_watch_interval * 1000) > 0)
+                        event = drainEvents();
+                }
+                else
+                {
+                    sleep(s_watch_interval);
+                }
+                uint64_t now = Clock::MonotonicMS();
+                bool periodic = now >= last_check + s_watch_interval * 1000;
+                if (periodic)
+                    last_check = now;
+                if (event || periodic)
+                    check(periodic);
+            }
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cond;     // m_current变化时通知del
+        std::vector<FileLogAppender *> m_appenders;
+        FileLogAppender *m_current = nullptr; // 后台线程正在锁外检查的appender
+        std::map<std::string, Dir> m_dirs;  // 被监听的目录
+        int m_inotifyFd = -1;
+    };
+
+    FileLogAppender::FileLogAppender(const std::string &file, IOPolicy policy)
+        : LogAppender(LogFormatter::ptr(new LogFormatter)), m_filename(file), m_policy(policy)
+    {
+        if (m_policy == DIRECT)
+        {
+            void *buf = nullptr;
+            if (posix_memalign(&buf, s_direct_align, s_direct_capacity) == 0)
+                m_directBuf = (char *)buf;
+        }
+        reopen(); // 失败时由后台线程定期重试
+        Watcher::GetInstance().add(this);
+    }
+
+    FileLogAppender::~FileLogAppender()
+    {
+        // 先停止监视，之后后台线程不会再调用reopen
+        Watcher::GetInstance().del(this);
+        MutexType::Lock lock(m_mutex);
+        closeLocked();
+        free(m_directBuf);
+    }
+
+    void FileLogAppender::closeLocked()
     {
-        if (!reopen())
-            std::cout << "reopen file " << m_filename << " error" << std::endl;
+        if (m_fd < 0)
+            return;
+        if (m_direct)
+            flushDirectLocked();
+        if (m_policy == SYNC)
+            fdatasync(m_fd); // 保证旧文件上已经返回的日志都已落盘
+        if (m_policy == DONTNEED)
+        {
+            fdatasync(m_fd);
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    int FileLogAppender::openFile(bool &direct)
+    {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+        direct = false;
+        int direct_errno = 0;
+        if (m_policy == DIRECT && m_directBuf)
+        {
+            // O_DIRECT下用pwrite按块对齐的偏移写入，不能带O_APPEND
+            int fd = open(m_filename.c_str(), flags | O_DIRECT, 0644);
+            if (fd >= 0)
+            {
+                direct = true;
+                return fd;
+            }
+            direct_errno = errno;
+        }
+        int fd = open(m_filename.c_str(), flags | O_APPEND, 0644);
+        // 只有普通方式能打开时才说明是文件系统不支持O_DIRECT
+        if (fd >= 0 && direct_errno != 0)
+            std::cout << "[ERROR] FileLogAppender::reopen() open " << m_filename << " with O_DIRECT error: "
+                      << strerror(direct_errno) << ", fallback to BUFFERED" << std::endl;
+        return fd;
+    }
+
+    bool FileLogAppender::needReopen()
+    {
+        struct stat st;
+        bool exists = stat(m_filename.c_str(), &st) == 0;
+        MutexType::Lock lock(m_mutex);
+        if (m_fd < 0)
+            return true;
+        return !exists || st.st_dev != m_dev || st.st_ino != m_inode;
     }
 
     bool FileLogAppender::reopen()
+    {
+        // 打开和fstat都在锁外完成，写线程只在交换文件描述符时等待
+        bool direct = false;
+        int fd = openFile(direct);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+        int old_fd = -1;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (fd < 0)
+            {
+                // 打开失败时继续写旧文件，错误只在第一次失败时输出
+                if (!m_reopenError)
+                    std::cout << "[ERROR] FileLogAppender::reopen() open " << m_filename << " error: " << strerror(errno) << std::endl;
+                m_reopenError = true;
+                return false;
+            }
+            m_reopenError = false;
+            if (m_fd >= 0)
+            {
+                // DIRECT缓冲区里属于旧文件的尾块必须先写回旧文件
+                if (m_direct)
+                    flushDirectLocked();
+                if (m_policy == SYNC)
+                    fdatasync(m_fd); // 保证旧文件上已经返回的日志都已落盘
+            }
+            old_fd = m_fd;
+            m_fd = fd;
+            m_direct = direct;
+            m_dev = st.st_dev;
+            m_inode = st.st_ino;
+            m_fileSize = st.st_size;
+            m_kickedBytes = m_advisedBytes = m_fileSize;
+            if (m_direct)
+            {
+                // 文件末尾不足一块的部分读回缓冲区，之后连同新日志一起整块重写
+                m_directOffset = m_fileSize & ~(off_t)(s_direct_align - 1);
+                m_directLen = m_fileSize - m_directOffset;
+                if (m_directLen > 0)
+                {
+                    int rfd = open(m_filename.c_str(), O_RDONLY | O_CLOEXEC);
+                    if (rfd < 0 || pread(rfd, m_directBuf, m_directLen, m_directOffset) != (ssize_t)m_directLen)
+                    {
+                        // 读不回来就从下一个块开始写，中间留下的空洞由0填充
+                        m_directOffset += s_direct_align;
+                        m_directLen = 0;
+                    }
+                    if (rfd >= 0)
+                        close(rfd);
+                }
+            }
+        }
+        if (old_fd >= 0)
+        {
+            if (m_policy == DONTNEED)
+            {
+                fdatasync(old_fd);
+                posix_fadvise(old_fd, 0, 0, POSIX_FADV_DONTNEED);
+            }
+            close(old_fd);
+        }
+        return true;
+    }
+
+    void FileLogAppender::flushDirectIfStale()
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_fd < 0 || !m_direct || m_directLen == 0)
+            return;
+        if (Clock::MonotonicMS() < m_directFlushTime + s_direct_flush_interval)
+            return;
+        if (!flushDirectLocked())
+            std::cout << "[ERROR] FileLogAppender flush " << m_filename << " error: " << strerror(errno) << std::endl;
+    }
+
+    bool FileLogAppender::flushDirectLocked()
+    {
+        m_directFlushTime = Clock::MonotonicMS();
+        if (m_directLen == 0)
+            return true;
+        size_t padded = (m_directLen + s_direct_align - 1) & ~(s_direct_align - 1);
+        memset(m_directBuf + m_directLen, 0, padded - m_directLen);
+        if (pwrite(m_fd, m_directBuf, padded, m_directOffset) != (ssize_t)padded)
+            return false;
+        if (ftruncate(m_fd, m_directOffset + m_directLen) != 0)
+            return false;
+        // 已写满的块不再需要，末尾不足一块的部分留在缓冲区里等下次补齐重写
+        size_t full = m_directLen & ~(s_direct_align - 1);
+        if (full > 0)
+        {
+            memmove(m_directBuf, m_directBuf + full, m_directLen - full);
+            m_directOffset += full;
+            m_directLen -= full;
+        }
+        return true;
+    }
+
+    bool FileLogAppender::writeLocked(const char *data, size_t len)
+    {
+        if (m_fd < 0)
+            return false;
+        if (m_direct)
+        {
+            const char *ptr = data;
+            size_t left = len;
+            while (left > 0)
+            {
+                size_t n = std::min(left, s_direct_capacity - m_directLen);
+                memcpy(m_directBuf + m_directLen, ptr, n);
+                m_directLen += n;
+                ptr += n;
+                left -= n;
+                if (m_directLen == s_direct_capacity)
+                {
+                    if (pwrite(m_fd, m_directBuf, s_direct_capacity, m_directOffset) != (ssize_t)s_direct_capacity)
+                        return false;
+                    m_directOffset += s_direct_capacity;
+                    m_directLen = 0;
+                    m_directFlushTime = Clock::MonotonicMS();
+                }
+            }
+            // 不足一块的尾部由后台线程定期补齐写出，写线程只写整个缓冲区
+            m_fileSize += len;
+            return true;
+        }
+
+        const char *ptr = data;
+        size_t left = len;
+        while (left > 0)
+        {
+            ssize_t n = ::write(m_fd, ptr, left);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            ptr += n;
+            left -= n;
+        }
+        m_fileSize += len;
+
+        if (m_policy == DONTNEED && m_fileSize - m_kickedBytes >= s_dontneed_window)
+        {
+            // 新写入的区间只发起异步回写；上一个区间此时基本已经写完，等待其完成后丢弃页缓存
+            sync_file_range(m_fd, m_kickedBytes, m_fileSize - m_kickedBytes, SYNC_FILE_RANGE_WRITE);
+            if (m_kickedBytes > m_advisedBytes)
+            {
+                sync_file_range(m_fd, m_advisedBytes, m_kickedBytes - m_advisedBytes, SYNC_FILE_RANGE_WAIT_BEFORE);
+                posix_fadvise(m_fd, m_advisedBytes, m_kickedBytes - m_advisedBytes, POSIX_FADV_DONTNEED);
+                m_advisedBytes = m_kickedBytes;
+            }
+            m_kickedBytes = m_fileSize;
+        }
+        return true;
+    }
+
+    void FileLogAppender::waitDurable(uint64_t seq)
+    {
+        std::unique_lock<std::mutex> lk(m_syncMutex);
+        while (m_syncedSeq < seq)
+        {
+            if (m_syncing)
+            {
+                m_syncCond.wait(lk);
+                continue;
+            }
+            // 成为本轮的leader：这一次fdatasync覆盖截至目前所有已写入的日志
+            m_syncing = true;
+            uint64_t target;
+            int fd;
+            {
+                MutexType::Lock lock(m_mutex);
+                target = m_writeSeq;
+                fd = m_fd >= 0 ? dup(m_fd) : -1; // 防止落盘期间reopen关闭了文件
+            }
+            lk.unlock();
+            int rt = fd >= 0 ? fdatasync(fd) : -1;
+            if (fd >= 0)
+                close(fd);
+            lk.lock();
+            if (rt != 0)
+                std::cout << "[ERROR] FileLogAppender::log() fdatasync " << m_filename << " error: " << strerror(errno) << std::endl;
+            // 失败时也推进序号，避免等待者永远阻塞
+            m_syncedSeq = std::max(m_syncedSeq, target);
+            m_syncing = false;
+            m_syncCond.notify_all();
+        }
+    }
+
+    bool FileLogAppender::flush()
     {
         MutexType::Lock lock(m_mutex);
-        if (m_filestream)
-            m_filestream.close();
-        m_filestream.open(m_filename, std::ios::app);
-        m_reopenError = !m_filestream;
-        return !m_reopenError;
+        if (m_fd < 0)
+            return false;
+        if (m_direct && !flushDirectLocked())
+            return false;
+        return fdatasync(m_fd) == 0;
     }
 
     void FileLogAppender::log(LogEvent::ptr event)
     {
-        time_t now = event->getTime();
-        if (now >= (m_lastTime + 3)) // 如果一个日志事件距离上次写日志超过3秒，那就重新打开一次日志文件
+        std::string str = getFormatter()->format(event);
+        logFormatted(event, str.data(), str.size());
+    }
+
+    void FileLogAppender::logFormatted(LogEvent::ptr /*event*/, const char *data, size_t len)
+    {
+        uint64_t seq = 0;
         {
-            if (!reopen())
+            MutexType::Lock lock(m_mutex);
+            if (!writeLocked(data, len))
             {
-                std::cout << "reopen file " << m_filename << " error" << std::endl;
+                std::cout << "[ERROR] FileLogAppender::log() write " << m_filename << " error: " << strerror(errno) << std::endl;
                 return;
             }
+            seq = ++m_writeSeq;
+        }
+        if (m_policy == SYNC)
+            waitDurable(seq);
+    }
+
+    std::string FileLogAppender::toYamlString()
+    {
+        MutexType::Lock lock(m_mutex);
+        YAML::Node node;
+        node["type"] = "FileLogAppender";
+        node["file"] = m_filename;
+        node["policy"] = PolicyToString(m_policy);
+        node["pattern"] = m_formatter ? m_formatter->getPattern() : m_defaultformatter->getPattern();
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+
+    /*
+    @brief 一个线程的分片，由线程本地缓存持有，Appender只保留weak_ptr；
+           线程退出或Appender析构时关闭文件，两者都通过交换fd关闭，不会重复关闭
+    */
+    struct ShardedFileLogAppender::Shard
+    {
+        std::atomic<int> fd{-1};
+        std::atomic<bool> retired{false}; // Appender已析构，线程本地缓存可以删除该分片
+        std::string filename;
+        LogFormatter::ptr formatter;
+        uint64_t formatterVersion = 0;
+        std::string buf;       // 记录头和日志拼好后一次write
+
+        ~Shard() { close(); }
+
+        void close()
+        {
+            int old = fd.exchange(-1);
+            if (old >= 0)
+                ::close(old);
         }
-        m_lastTime = now;
+    };
+
+    static std::atomic<uint64_t> s_sharded_appender_id{0}; // 分片Appender实例编号
+    static std::atomic<uint64_t> s_shard_sequence{0};      // 所有分片共用的日志序号，线程按批预留
+
+    /*
+    @brief 取下一个全局日志序号
+    @details 每个线程一次从全局计数器预留64个序号，写入路径上平均每64条日志才碰一次共享的缓存行；
+             同一线程内的序号严格递增，不同线程之间的序号不反映先后，只用于时间戳相同时确定顺序
+    */
+    static uint64_t NextShardSequence()
+    {
+        static const uint64_t s_batch = 64;
+        static thread_local uint64_t t_next = 0;
+        static thread_local uint64_t t_end = 0;
+        if (t_next == t_end)
+        {
+            t_next = s_shard_sequence.fetch_add(s_batch, std::memory_order_relaxed) + 1;
+            t_end = t_next + s_batch;
+        }
+        return t_next++;
+    }
+
+    ShardedFileLogAppender::ShardedFileLogAppender(const std::string &file)
+        : LogAppender(LogFormatter::ptr(new LogFormatter)), m_filename(file), m_id(++s_sharded_appender_id)
+    {
+    }
+
+    ShardedFileLogAppender::~ShardedFileLogAppender()
+    {
         MutexType::Lock lock(m_mutex);
-        if (m_formatter)
+        for (auto &i : m_shards)
         {
-            if (!m_formatter->format(m_filestream, event))
+            std::shared_ptr<Shard> shard = i.lock();
+            if (shard)
             {
-                std::cout << "[ERROR] FileLogAppender::log() format error" << std::endl;
+                shard->retired = true;
+                shard->close();
             }
         }
-        else
+    }
+
+    void ShardedFileLogAppender::setFormatter(LogFormatter::ptr fmt)
+    {
+        LogAppender::setFormatter(fmt);
+        ++m_formatterVersion;
+    }
+
+    ShardedFileLogAppender::Shard *ShardedFileLogAppender::getShard()
+    {
+        // 线程退出时缓存析构，释放其中的分片并关闭文件；之后线程在其他线程本地对象的析构中再写日志时直接丢弃
+        // 析构时同时清掉最近一次的缓存，并且先检查t_exited再走快速路径，避免拿到已释放的分片
+        static thread_local bool t_exited = false;
+        static thread_local uint64_t t_last_id = 0;
+        static thread_local Shard *t_last_shard = nullptr;
+        struct ShardCache
+        {
+            std::unordered_map<uint64_t, std::shared_ptr<Shard>> shards;
+            ~ShardCache()
+            {
+                t_exited = true;
+                t_last_id = 0;
+                t_last_shard = nullptr;
+            }
+        };
+        static thread_local ShardCache t_cache;
+        if (t_exited)
+            return nullptr;
+        if (t_last_id == m_id)
+            return t_last_shard;
+
+        std::shared_ptr<Shard> &shard = t_cache.shards[m_id];
+        if (!shard)
         {
-            if (!m_defaultformatter->format(m_filestream, event))
+            // 新Appender第一次在本线程写入时，顺便清理已析构Appender留下的分片
+            for (auto it = t_cache.shards.begin(); it != t_cache.shards.end();)
             {
-                std::cout << "[ERROR] FileLogAppender::log() format error" << std::endl;
+                if (it->second && it->second->retired)
+                    it = t_cache.shards.erase(it);
+                else
+                    ++it;
             }
+            shard.reset(new Shard);
+            shard->filename = m_filename + "." + std::to_string(GetThreadId());
+            shard->fd = open(shard->filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (shard->fd < 0)
+                std::cout << "[ERROR] ShardedFileLogAppender open " << shard->filename << " error: " << strerror(errno) << std::endl;
+            MutexType::Lock lock(m_mutex);
+            m_shards.erase(std::remove_if(m_shards.begin(), m_shards.end(), [](const std::weak_ptr<Shard> &i) {
+                               return i.expired();
+                           }),
+                           m_shards.end());
+            m_shards.push_back(shard);
         }
+        t_last_id = m_id;
+        t_last_shard = shard.get();
+        return t_last_shard;
     }
 
-    std::string FileLogAppender::toYamlString()
+    void ShardedFileLogAppender::log(LogEvent::ptr event)
+    {
+        Shard *shard = getShard();
+        if (!shard || shard->fd.load(std::memory_order_relaxed) < 0)
+            return;
+        uint64_t version = m_formatterVersion.load(std::memory_order_acquire);
+        if (!shard->formatter || shard->formatterVersion != version)
+        {
+            shard->formatter = getFormatter();
+            shard->formatterVersion = version;
+        }
+        std::string str = shard->formatter->format(event);
+        writeRecord(shard, str.data(), str.size());
+    }
+
+    void ShardedFileLogAppender::logFormatted(LogEvent::ptr /*event*/, const char *data, size_t len)
+    {
+        Shard *shard = getShard();
+        if (!shard || shard->fd.load(std::memory_order_relaxed) < 0)
+            return;
+        writeRecord(shard, data, len);
+    }
+
+    void ShardedFileLogAppender::writeRecord(Shard *shard, const char *data, size_t len)
+    {
+        // 单调时钟不受系统时间调整影响，分片内时间戳不回退；序号全局唯一，归并时用来区分时间戳相同的记录
+        uint64_t now = Clock::MonotonicNS();
+        uint64_t seq = NextShardSequence();
+
+        char head[64];
+        int n = snprintf(head, sizeof(head), "#%lu %lu %zu\n", (unsigned long)seq,
+                         (unsigned long)now, len);
+        shard->buf.assign(head, n);
+        shard->buf.append(data, len);
+        if (::write(shard->fd.load(std::memory_order_relaxed), shard->buf.data(), shard->buf.size()) != (ssize_t)shard->buf.size())
+        {
+            std::cout << "[ERROR] ShardedFileLogAppender::log() write " << shard->filename << " error" << std::endl;
+        }
+    }
+
+    std::string ShardedFileLogAppender::toYamlString()
     {
         MutexType::Lock lock(m_mutex);
         YAML::Node node;
-        node["type"] = "FileLogAppender";
+        node["type"] = "ShardedFileLogAppender";
         node["file"] = m_filename;
         node["pattern"] = m_formatter ? m_formatter->getPattern() : m_defaultformatter->getPattern();
         std::stringstream ss;
@@ -455,8 +1176,481 @@ namespace MyServer
         return ss.str();
     }
 
+    void ShardedFileLogAppender::ListShards(std::vector<std::string> &shards, const std::string &file)
+    {
+        std::string dirname = FSUtil::Dirname(file);
+        std::string prefix = FSUtil::Basename(file) + ".";
+        DIR *dir = opendir(dirname.c_str());
+        if (dir == nullptr)
+            return;
+        struct dirent *dp = nullptr;
+        while ((dp = readdir(dir)) != nullptr)
+        {
+            const char *name = dp->d_name;
+            if (strncmp(name, prefix.c_str(), prefix.size()) != 0)
+                continue;
+            const char *tid = name + prefix.size();
+            if (*tid == '\0' || strspn(tid, "0123456789") != strlen(tid))
+                continue;
+            shards.push_back(dirname + "/" + name);
+        }
+        closedir(dir);
+        std::sort(shards.begin(), shards.end());
+    }
+
+    namespace
+    {
+        /*
+        @brief 顺序读取一个分片文件中的记录
+        */
+        struct ShardReader
+        {
+            std::ifstream ifs;
+            std::string path;
+            uint64_t seq = 0;
+            uint64_t ts = 0;
+            std::string data;
+            bool error = false;
+
+            bool next()
+            {
+                std::string head;
+                if (!std::getline(ifs, head))
+                    return false;
+                unsigned long s, t;
+                size_t len;
+                if (sscanf(head.c_str(), "#%lu %lu %zu", &s, &t, &len) != 3)
+                {
+                    std::cerr << "[ERROR] ShardedFileLogAppender::MergeShards() bad record head in " << path << std::endl;
+                    error = true;
+                    return false;
+                }
+                data.resize(len);
+                if (!ifs.read(&data[0], len))
+                {
+                    std::cerr << "[ERROR] ShardedFileLogAppender::MergeShards() truncated record in " << path << std::endl;
+                    error = true;
+                    return false;
+                }
+                seq = s;
+                ts = t;
+                return true;
+            }
+        };
+    }
+
+    bool ShardedFileLogAppender::MergeShards(const std::vector<std::string> &shards, std::ostream &os)
+    {
+        std::vector<std::unique_ptr<ShardReader>> readers;
+        auto cmp = [&readers](size_t a, size_t b)
+        {
+            // priority_queue是大顶堆，返回a排在b之后；按(时间戳, 序号)排序，序号全局唯一，结果与分片列表的顺序无关
+            if (readers[a]->ts != readers[b]->ts)
+                return readers[a]->ts > readers[b]->ts;
+            return readers[a]->seq > readers[b]->seq;
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(cmp)> heap(cmp);
+
+        bool ok = true;
+        for (auto &i : shards)
+        {
+            std::unique_ptr<ShardReader> reader(new ShardReader);
+            reader->path = i;
+            reader->ifs.open(i, std::ios::binary);
+            if (!reader->ifs)
+            {
+                std::cerr << "[ERROR] ShardedFileLogAppender::MergeShards() open " << i << " error" << std::endl;
+                ok = false;
+                continue;
+            }
+            readers.push_back(std::move(reader));
+            if (readers.back()->next())
+                heap.push(readers.size() - 1);
+        }
+
+        while (!heap.empty())
+        {
+            size_t idx = heap.top();
+            heap.pop();
+            os.write(readers[idx]->data.data(), readers[idx]->data.size());
+            if (readers[idx]->next())
+                heap.push(idx);
+        }
+        for (auto &i : readers)
+        {
+            if (i->error)
+                ok = false;
+        }
+        return ok && (bool)os;
+    }
+
+    /*
+    @brief 每秒输出一次窗口已到期的汇总，进程内所有DedupLogAppender共用
+    @details 汇总事件在持有各Appender的锁时取出，在所有锁外输出，输出慢时不阻塞Appender的创建和析构
+    */
+    class DedupLogAppender::Sweeper
+    {
+    public:
+        static Sweeper &GetInstance()
+        {
+            static Sweeper *s_sweeper = new Sweeper; // 线程常驻到进程退出，不析构
+            return *s_sweeper;
+        }
+
+        void add(DedupLogAppender *appender)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_appenders.push_back(appender);
+        }
+
+        /*
+        @brief 移除appender，返回后后台线程不会再访问它
+        */
+        void del(DedupLogAppender *appender)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_appenders.erase(std::remove(m_appenders.begin(), m_appenders.end(), appender), m_appenders.end());
+        }
+
+    private:
+        Sweeper()
+        {
+            std::thread(&Sweeper::run, this).detach();
+        }
+
+        void run()
+        {
+            ThreadRegistry::Register("log_dedup");
+            std::vector<std::pair<LogAppender::ptr, LogEvent::ptr>> repeats;
+            while (true)
+            {
+                sleep(1);
+                time_t now = time(0);
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    for (auto i : m_appenders)
+                    {
+                        MutexType::Lock lock(i->m_mutex);
+                        if (i->m_repeat > 0 && now >= i->m_firstTime + (time_t)i->m_window)
+                            repeats.emplace_back(i->m_appender, i->takeRepeatEvent());
+                    }
+                }
+                for (auto &i : repeats)
+                {
+                    i.first->log(i.second);
+                }
+                repeats.clear();
+            }
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<DedupLogAppender *> m_appenders;
+    };
+
+    DedupLogAppender::DedupLogAppender(LogAppender::ptr appender, uint32_t window)
+        : LogAppender(LogFormatter::ptr(new LogFormatter)), m_appender(appender), m_window(window)
+    {
+        Sweeper::GetInstance().add(this);
+    }
+
+    DedupLogAppender::~DedupLogAppender()
+    {
+        Sweeper::GetInstance().del(this);
+        flush();
+    }
+
+    void DedupLogAppender::flush()
+    {
+        LogEvent::ptr repeat;
+        {
+            MutexType::Lock lock(m_mutex);
+            repeat = takeRepeatEvent();
+        }
+        if (repeat)
+            m_appender->log(repeat);
+    }
+
+    LogEvent::ptr DedupLogAppender::takeRepeatEvent()
+    {
+        if (m_repeat == 0)
+            return nullptr;
+        LogEvent::ptr last = m_lastEvent;
+        LogEvent::ptr event(new LogEvent(last->getLoggerNameId(), last->getLevel(), last->getFile(), last->getLine(),
+                                         last->getElapse(), last->getThreadId(), last->getFiberId(), last->getTime(), last->getThreadNameId()));
+        event->getSS() << "last message repeated " << m_repeat << " times";
+        m_repeat = 0;
+        return event;
+    }
+
+    void DedupLogAppender::log(LogEvent::ptr event)
+    {
+        // 直接对事件缓冲区中的内容计算哈希，不复制
+        std::string_view content = event->getContentView();
+        const char *file = event->getFile();
+        uint64_t key[2] = {((uint64_t)event->getLevel() << 32) | (uint32_t)event->getLine(), event->getLoggerNameId()};
+        uint64_t hash = Hash64(content.data(), content.size());
+        hash = Hash64(file, file ? strlen(file) : 0, hash);
+        hash = Hash64(key, sizeof(key), hash);
+
+        LogEvent::ptr repeat;
+        {
+            MutexType::Lock lock(m_mutex);
+            // 哈希相同时再与上一条日志的内容比较一次，上一条日志已经输出，内容不会再变
+            if (m_lastEvent && hash == m_lastHash && event->getTime() < m_firstTime + (time_t)m_window &&
+                content == m_lastEvent->getContentView())
+            {
+                ++m_repeat;
+                m_lastEvent = event;
+                return;
+            }
+            repeat = takeRepeatEvent();
+            m_lastHash = hash;
+            m_lastEvent = event;
+            m_firstTime = event->getTime();
+        }
+        // 汇总事件和新日志在锁外输出，两者之间的顺序由当前线程保证
+        if (repeat)
+            m_appender->log(repeat);
+        m_appender->log(event);
+    }
+
+    std::string DedupLogAppender::toYamlString()
+    {
+        MutexType::Lock lock(m_mutex);
+        YAML::Node node;
+        node["type"] = "DedupLogAppender";
+        node["window"] = m_window;
+        node["appender"] = YAML::Load(m_appender->toYamlString());
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+
+    /*
+    @brief 飞行记录仪缓冲区中的一条记录，其后紧跟len字节的日志内容
+    */
+    struct FlightRecorderLogAppender::Record
+    {
+        uint64_t timestamp; // 单调纳秒，用于窗口判断和跨线程排序
+        const char *file;
+        int64_t elapse;
+        uint64_t fiberId;
+        time_t time;
+        uint32_t loggerNameId;
+        uint32_t threadNameId;
+        uint32_t threadId;
+        int32_t line;
+        int32_t level;
+        uint32_t len;
+    };
+
+    /*
+    @brief 单个线程的环形缓冲区，head和tail只增不减，取模后为缓冲区下标
+    @details 只有所属线程写入，dump时由其他线程读取，两者通过mutex同步，平时锁没有竞争
+    */
+    struct FlightRecorderLogAppender::Ring
+    {
+        std::mutex mutex;
+        std::vector<char> buf;
+        uint64_t head = 0; // 下一条记录的写入位置
+        uint64_t tail = 0; // 最旧记录的位置
+        std::atomic<bool> orphaned{false}; // 所属的Appender已析构，线程本地缓存可以丢弃
+
+        explicit Ring(size_t size) : buf(size) {}
+
+        void write(uint64_t pos, const void *data, size_t len)
+        {
+            size_t off = pos & (buf.size() - 1);
+            size_t n = std::min(len, buf.size() - off);
+            memcpy(&buf[off], data, n);
+            memcpy(&buf[0], (const char *)data + n, len - n);
+        }
+
+        void read(uint64_t pos, void *data, size_t len) const
+        {
+            size_t off = pos & (buf.size() - 1);
+            size_t n = std::min(len, buf.size() - off);
+            memcpy(data, &buf[off], n);
+            memcpy((char *)data + n, &buf[0], len - n);
+        }
+    };
+
+    static std::atomic<uint64_t> s_flight_recorder_id{0}; // 飞行记录仪实例编号
+
+    FlightRecorderLogAppender::FlightRecorderLogAppender(LogAppender::ptr appender, LogLevel::Level forward,
+                                                         LogLevel::Level trigger, uint32_t window, size_t ring_size)
+        : LogAppender(LogFormatter::ptr(new LogFormatter)), m_appender(appender), m_forward(forward), m_trigger(trigger),
+          m_window(window), m_id(++s_flight_recorder_id)
+    {
+        m_ringSize = 4096;
+        while (m_ringSize < ring_size)
+            m_ringSize <<= 1;
+    }
+
+    FlightRecorderLogAppender::~FlightRecorderLogAppender()
+    {
+        MutexType::Lock lock(m_mutex);
+        for (auto &i : m_rings)
+            i->orphaned.store(true, std::memory_order_relaxed);
+    }
+
+    FlightRecorderLogAppender::Ring *FlightRecorderLogAppender::getRing()
+    {
+        // 缓冲区同时由线程和Appender持有：线程退出后缓冲区中的记录仍可被dump。
+        // 线程退出时缓存析构，之后线程在其他线程本地对象的析构中再写日志时不再访问缓存，直接丢弃
+        static thread_local bool t_exited = false;
+        static thread_local uint64_t t_last_id = 0;
+        static thread_local Ring *t_last_ring = nullptr;
+        struct RingCache
+        {
+            std::unordered_map<uint64_t, std::shared_ptr<Ring>> rings;
+            ~RingCache()
+            {
+                t_exited = true;
+                t_last_id = 0;
+                t_last_ring = nullptr;
+            }
+        };
+        static thread_local RingCache t_cache;
+        if (t_exited)
+            return nullptr;
+        if (t_last_id == m_id)
+            return t_last_ring;
+
+        std::shared_ptr<Ring> &ring = t_cache.rings[m_id];
+        if (!ring)
+        {
+            // 新建缓冲区时顺便释放已析构的Appender留在本线程的缓冲区
+            for (auto it = t_cache.rings.begin(); it != t_cache.rings.end();)
+            {
+                if (it->second && it->second->orphaned.load(std::memory_order_relaxed))
+                    it = t_cache.rings.erase(it);
+                else
+                    ++it;
+            }
+            ring.reset(new Ring(m_ringSize));
+            MutexType::Lock lock(m_mutex);
+            m_rings.push_back(ring);
+        }
+        t_last_id = m_id;
+        t_last_ring = ring.get();
+        return t_last_ring;
+    }
+
+    void FlightRecorderLogAppender::record(LogEvent::ptr event)
+    {
+        std::string_view content = event->getContentView();
+        Record rec;
+        rec.timestamp = Clock::MonotonicNS(Clock::TSC);
+        rec.file = event->getFile();
+        rec.elapse = event->getElapse();
+        rec.fiberId = event->getFiberId();
+        rec.time = event->getTime();
+        rec.loggerNameId = event->getLoggerNameId();
+        rec.threadNameId = event->getThreadNameId();
+        rec.threadId = event->getThreadId();
+        rec.line = event->getLine();
+        rec.level = event->getLevel();
+        // 单条记录最多占缓冲区的1/4，过长的内容截断
+        rec.len = std::min(content.size(), m_ringSize / 4 - sizeof(Record));
+
+        Ring *ring = getRing();
+        if (!ring)
+            return;
+        size_t size = sizeof(Record) + rec.len;
+        std::lock_guard<std::mutex> lock(ring->mutex);
+        while (ring->head - ring->tail + size > ring->buf.size())
+        {
+            Record old;
+            ring->read(ring->tail, &old, sizeof(old));
+            ring->tail += sizeof(Record) + old.len;
+        }
+        ring->write(ring->head, &rec, sizeof(rec));
+        ring->write(ring->head + sizeof(rec), content.data(), rec.len);
+        ring->head += size;
+    }
+
+    void FlightRecorderLogAppender::log(LogEvent::ptr event)
+    {
+        LogLevel::Level level = event->getLevel();
+        if (level <= m_trigger)
+            dump();
+        if (level <= m_forward || level <= m_trigger)
+            m_appender->log(event);
+        else
+            record(event);
+    }
+
+    size_t FlightRecorderLogAppender::dump()
+    {
+        std::lock_guard<std::mutex> dump_lock(m_dumpMutex);
+        std::vector<std::shared_ptr<Ring>> rings;
+        {
+            MutexType::Lock lock(m_mutex);
+            // 线程已退出且记录已转发完的缓冲区不再保留
+            m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const std::shared_ptr<Ring> &r) {
+                              std::lock_guard<std::mutex> lock(r->mutex);
+                              return r.use_count() == 1 && r->head == r->tail;
+                          }),
+                          m_rings.end());
+            rings = m_rings;
+        }
+
+        uint64_t now = Clock::MonotonicNS(Clock::TSC);
+        uint64_t cutoff = now > m_window * 1000000000ull ? now - m_window * 1000000000ull : 0;
+        std::vector<std::pair<uint64_t, LogEvent::ptr>> events;
+        std::string content;
+        for (auto &r : rings)
+        {
+            std::lock_guard<std::mutex> lock(r->mutex);
+            for (uint64_t pos = r->tail; pos != r->head;)
+            {
+                Record rec;
+                r->read(pos, &rec, sizeof(rec));
+                pos += sizeof(rec);
+                if (rec.timestamp >= cutoff)
+                {
+                    LogEvent::ptr event(new LogEvent(rec.loggerNameId, (LogLevel::Level)rec.level, rec.file, rec.line, rec.elapse,
+                                                     rec.threadId, rec.fiberId, rec.time, rec.threadNameId));
+                    content.resize(rec.len);
+                    r->read(pos, &content[0], rec.len);
+                    event->getSS().write(content.data(), rec.len);
+                    events.emplace_back(rec.timestamp, event);
+                }
+                pos += rec.len;
+            }
+            r->tail = r->head;
+        }
+
+        std::stable_sort(events.begin(), events.end(), [](const std::pair<uint64_t, LogEvent::ptr> &a, const std::pair<uint64_t, LogEvent::ptr> &b) {
+            return a.first < b.first;
+        });
+        for (auto &i : events)
+        {
+            m_appender->log(i.second);
+        }
+        return events.size();
+    }
+
+    std::string FlightRecorderLogAppender::toYamlString()
+    {
+        MutexType::Lock lock(m_mutex);
+        YAML::Node node;
+        node["type"] = "FlightRecorderLogAppender";
+        node["forward"] = LogLevel::ToString(m_forward);
+        node["trigger"] = LogLevel::ToString(m_trigger);
+        node["window"] = m_window;
+        node["ring_size"] = m_ringSize;
+        node["threads"] = m_rings.size();
+        node["appender"] = YAML::Load(m_appender->toYamlString());
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+
     Logger::Logger(const std::string &name)
-        : m_name(name), m_level(LogLevel::INFO), m_createTime(GetElapsedMS())
+        : m_name(name), m_nameId(SymbolTable::Intern(name)), m_level(LogLevel::INFO), m_createTime(GetElapsedMS())
     {
     }
 
@@ -488,11 +1682,56 @@ namespace MyServer
     void Logger::log(LogEvent::ptr event)
     {
         if (event->getLevel() <= m_level)
+            forceLog(event);
+    }
+
+    void Logger::forceLog(LogEvent::ptr event)
+    {
+        if (m_appenders.size() == 1)
+        {
+            m_appenders.front()->log(event);
+            return;
+        }
+
+        // 按格式模板分组，每种格式只格式化一次，结果交给同组的所有Appender；
+        // 组数等于不同格式的个数，一般只有一两个，线性查找即可。
+        // 格式器按驻留的模板id比较，取格式器不加锁，每条日志上没有共享锁、引用计数和字符串比较
+        struct Layout
+        {
+            uint32_t patternId;
+            std::string data;
+        };
+        Layout layouts[4];
+        size_t count = 0;
+        for (auto &i : m_appenders)
         {
-            for (auto &i : m_appenders)
+            if (!i->usesFormatter())
             {
                 i->log(event);
+                continue;
+            }
+            LogFormatter *formatter = i->getCurrentFormatter();
+            Layout *layout = nullptr;
+            for (size_t j = 0; j < count; j++)
+            {
+                if (layouts[j].patternId == formatter->getPatternId())
+                {
+                    layout = &layouts[j];
+                    break;
+                }
+            }
+            if (!layout)
+            {
+                if (count == sizeof(layouts) / sizeof(layouts[0]))
+                {
+                    i->log(event);
+                    continue;
+                }
+                layout = &layouts[count++];
+                layout->patternId = formatter->getPatternId();
+                layout->data = formatter->format(event);
             }
+            i->logFormatted(event, layout->data.data(), layout->data.size());
         }
     }
 
@@ -511,14 +1750,17 @@ namespace MyServer
         return ss.str();
     }
 
-    LogEventWrap::LogEventWrap(Logger::ptr logger, LogEvent::ptr event)
-        : m_logger(logger), m_event(event)
+    LogEventWrap::LogEventWrap(Logger::ptr logger, LogEvent::ptr event, bool force)
+        : m_logger(logger), m_event(event), m_force(force)
     {
     }
 
     LogEventWrap::~LogEventWrap()
     {
-        m_logger->log(m_event);
+        if (m_force)
+            m_logger->forceLog(m_event);
+        else
+            m_logger->log(m_event);
     }
 
     LoggerManager::LoggerManager()
@@ -555,4 +1797,214 @@ namespace MyServer
         ss << node;
         return ss.str();
     }
-} // end MyServer
\ No newline at end of file
+
+    LogEvent::ptr MakeLogEvent(const Logger &logger, LogLevel::Level level, const char *file, int32_t line)
+    {
+        return LogEvent::ptr(new LogEvent(logger.getNameId(), level, file, line, GetElapsedMS() - logger.getCreateTime(),
+                                          GetThreadId(), GetFiberId(), time(0), GetThreadNameId()));
+    }
+
+    /**
+     * @brief 匹配某个调用点的规则，按添加顺序排列，构造后不再修改
+     */
+    struct LogSiteRules
+    {
+        // 日志器名称通配符（nullptr表示所有日志器）和是否强制输出
+        std::vector<std::pair<const char *, bool>> rules;
+
+        bool operator==(const LogSiteRules &rhs) const { return rules == rhs.rules; }
+    };
+
+    namespace
+    {
+        struct SiteRule
+        {
+            std::string fileGlob;
+            int32_t lineBegin;
+            int32_t lineEnd;
+            const char *loggerGlob; // 指向SiteState::globs中的字符串，nullptr表示所有日志器
+            bool enable;
+        };
+
+        struct SiteState
+        {
+            std::mutex mutex;
+            std::vector<LogSite *> sites; // 已登记的调用点
+            std::vector<SiteRule> rules;
+            std::set<std::string> globs; // 日志器名称通配符，只增不删，调用点可以一直持有其指针
+            std::list<LogSiteRules> siteRules; // 调用点的规则列表，相同的只存一份，只增不删
+        };
+
+        static SiteState &GetSiteState()
+        {
+            static SiteState *s_state = new SiteState; // 静态对象析构期间仍可能有日志输出，不析构
+            return *s_state;
+        }
+
+        static bool MatchFile(const std::string &glob, const char *file)
+        {
+            if (!fnmatch(glob.c_str(), file, 0))
+                return true;
+            const char *base = strrchr(file, '/');
+            return base && !fnmatch(glob.c_str(), base + 1, 0);
+        }
+
+        static bool MatchRule(const SiteRule &rule, const LogSite &site)
+        {
+            return site.line >= rule.lineBegin && site.line <= rule.lineEnd && MatchFile(rule.fileGlob, site.file);
+        }
+
+        /**
+         * @brief 按全部规则重新计算调用点的状态，调用时持有st.mutex
+         */
+        static void ApplyRules(SiteState &st, LogSite &site)
+        {
+            LogSiteRules rules;
+            bool forced = false;
+            for (auto &i : st.rules)
+            {
+                if (!MatchRule(i, site))
+                    continue;
+                // 对所有日志器生效的规则覆盖之前的全部规则
+                if (!i.loggerGlob)
+                {
+                    rules.rules.clear();
+                    forced = false;
+                }
+                rules.rules.emplace_back(i.loggerGlob, i.enable);
+                forced |= i.enable;
+            }
+            if (!forced)
+            {
+                site.state.store(LogSite::DEFAULT, std::memory_order_release);
+                return;
+            }
+            auto it = std::find(st.siteRules.begin(), st.siteRules.end(), rules);
+            if (it == st.siteRules.end())
+                it = st.siteRules.insert(st.siteRules.end(), std::move(rules));
+            site.rules.store(&*it, std::memory_order_relaxed);
+            site.state.store(LogSite::FORCED, std::memory_order_release);
+        }
+
+        static size_t AddRule(const std::string &file_glob, int32_t line_begin, int32_t line_end,
+                              const std::string &logger_glob, bool enable)
+        {
+            SiteState &st = GetSiteState();
+            std::lock_guard<std::mutex> lock(st.mutex);
+            SiteRule rule;
+            rule.fileGlob = file_glob;
+            rule.lineBegin = line_begin;
+            rule.lineEnd = line_end;
+            rule.loggerGlob = logger_glob == "*" ? nullptr : st.globs.insert(logger_glob).first->c_str();
+            rule.enable = enable;
+            // 相同范围、相同日志器（或新规则对所有日志器生效）的旧规则已被新规则完全覆盖，去掉以免反复开关时规则无限增长
+            st.rules.erase(std::remove_if(st.rules.begin(), st.rules.end(), [&](const SiteRule &r) {
+                               return r.fileGlob == rule.fileGlob && r.lineBegin == rule.lineBegin && r.lineEnd == rule.lineEnd &&
+                                      (!rule.loggerGlob || r.loggerGlob == rule.loggerGlob);
+                           }),
+                           st.rules.end());
+            st.rules.push_back(rule);
+            size_t n = 0;
+            for (auto i : st.sites)
+            {
+                if (MatchRule(rule, *i))
+                {
+                    ApplyRules(st, *i);
+                    ++n;
+                }
+            }
+            return n;
+        }
+    }
+
+    bool LogSites::Check(LogSite &site, const Logger &logger)
+    {
+        uint8_t state = site.state.load(std::memory_order_acquire);
+        if (state == LogSite::UNREGISTERED)
+        {
+            SiteState &st = GetSiteState();
+            std::lock_guard<std::mutex> lock(st.mutex);
+            if (site.state.load(std::memory_order_relaxed) == LogSite::UNREGISTERED)
+            {
+                st.sites.push_back(&site);
+                ApplyRules(st, site);
+            }
+            state = site.state.load(std::memory_order_relaxed);
+        }
+        if (state == LogSite::FORCED)
+        {
+            // 从后往前找第一条日志器名称匹配的规则
+            const LogSiteRules *rules = site.rules.load(std::memory_order_relaxed);
+            const char *name = logger.getName().c_str();
+            for (auto it = rules->rules.rbegin(); it != rules->rules.rend(); ++it)
+            {
+                if (!it->first || !fnmatch(it->first, name, 0))
+                {
+                    if (it->second)
+                        return true;
+                    break;
+                }
+            }
+        }
+        return site.level <= logger.getLevel();
+    }
+
+    size_t LogSites::Enable(const std::string &file_glob, int32_t line_begin, int32_t line_end, const std::string &logger_glob)
+    {
+        return AddRule(file_glob, line_begin, line_end, logger_glob, true);
+    }
+
+    size_t LogSites::Disable(const std::string &file_glob, int32_t line_begin, int32_t line_end, const std::string &logger_glob)
+    {
+        return AddRule(file_glob, line_begin, line_end, logger_glob, false);
+    }
+
+    void LogSites::DisableAll()
+    {
+        SiteState &st = GetSiteState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.rules.clear();
+        for (auto i : st.sites)
+        {
+            i->state.store(LogSite::DEFAULT, std::memory_order_release);
+        }
+    }
+
+    std::string LogSites::ToYamlString()
+    {
+        SiteState &st = GetSiteState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        YAML::Node node;
+        node["registered"] = st.sites.size();
+        for (auto &i : st.rules)
+        {
+            YAML::Node n;
+            n["file"] = i.fileGlob;
+            n["lines"].push_back(i.lineBegin);
+            n["lines"].push_back(i.lineEnd);
+            n["logger"] = i.loggerGlob ? i.loggerGlob : "*";
+            n["enable"] = i.enable;
+            node["rules"].push_back(n);
+        }
+        for (auto i : st.sites)
+        {
+            if (i->state.load(std::memory_order_relaxed) != LogSite::FORCED)
+                continue;
+            YAML::Node n;
+            n["file"] = i->file;
+            n["line"] = i->line;
+            n["level"] = LogLevel::ToString(i->level);
+            for (auto &j : i->rules.load(std::memory_order_relaxed)->rules)
+            {
+                YAML::Node r;
+                r["logger"] = j.first ? j.first : "*";
+                r["enable"] = j.second;
+                n["rules"].push_back(r);
+            }
+            node["forced"].push_back(n);
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+} // end MyServer
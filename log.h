@@ -2,6 +2,7 @@
 #define LOG_H
 
 #include <string>
+#include <string_view>
 #include <stdint.h>
 #include <memory>
 #include <list>
@@ -12,6 +13,13 @@
 #include <stdarg.h>
 #include <map>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
+#include "format.h"
+#include "adaptive_mutex.h"
+#include "intern.h"
 
 namespace MyServer
 {
@@ -69,8 +77,8 @@ namespace MyServer
         uint32_t m_threadId = 0;      // 线程id
         uint64_t m_fiberId = 0;       // 协程id
         time_t m_time;                // UTC时间戳
-        std::string m_threadName;     // 线程名称
-        std::string m_loggerName;     // 日志器名称
+        uint32_t m_threadNameId = 0;  // 线程名称在SymbolTable中的id
+        uint32_t m_loggerNameId = 0;  // 日志器名称在SymbolTable中的id
     public:
         typedef std::shared_ptr<LogEvent> ptr;
 
@@ -88,17 +96,33 @@ namespace MyServer
         LogEvent(const std::string &logger_name, LogLevel::Level level, const char *file, int32_t line,
                  int64_t elapse, uint32_t thread_id, uint64_t fiber_id, time_t time, const std::string &thread_name);
 
+        /*
+        @brief 以驻留id构造，避免复制名称字符串
+        @param[in] logger_name_id 日志器名称id，见Logger::getNameId()
+        @param[in] thread_name_id 线程名称id，见GetThreadNameId()
+        @details 其余参数同上
+        */
+        LogEvent(uint32_t logger_name_id, LogLevel::Level level, const char *file, int32_t line,
+                 int64_t elapse, uint32_t thread_id, uint64_t fiber_id, time_t time, uint32_t thread_name_id);
+
         LogLevel::Level getLevel() const { return m_level; }
         std::string getContent() const { return m_ss.str(); }
-        std::string getFile() const { return m_file; }
+
+        /*
+        @brief 直接引用日志内容缓冲区，不复制；继续写入日志内容后失效
+        */
+        std::string_view getContentView() const;
+        const char *getFile() const { return m_file; }
         int32_t getLine() const { return m_line; }
         int64_t getElapse() const { return m_elapse; }
         uint32_t getThreadId() const { return m_threadId; }
         uint64_t getFiberId() const { return m_fiberId; }
         time_t getTime() const { return m_time; }
-        const std::string &getThreadName() const { return m_threadName; }
+        std::string_view getThreadName() const { return SymbolTable::Lookup(m_threadNameId); }
+        uint32_t getThreadNameId() const { return m_threadNameId; }
         std::stringstream &getSS() { return m_ss; }
-        const std::string &getLoggerName() const { return m_loggerName; }
+        std::string_view getLoggerName() const { return SymbolTable::Lookup(m_loggerNameId); }
+        uint32_t getLoggerNameId() const { return m_loggerNameId; }
 
         /*
         @brief printf风格写入日志
@@ -109,6 +133,17 @@ namespace MyServer
         @brief vprintf风格写入日志
         */
         void vprintf(const char *fmt, va_list ap);
+
+        /*
+        @brief {}风格写入日志，直接写入日志内容的缓冲区，不经过中间缓冲区
+        @details fmt为MYSERVER_FMT("...")时在编译期检查，运行期确定的格式串需用FormatRuntime(str)包装
+        */
+        template <class S, class... Args>
+        void format(const S &fmt, const Args &...args)
+        {
+            StreamFormatSink sink(m_ss.rdbuf());
+            FormatTo(sink, fmt, args...);
+        }
     };
 
     class LogFormatter
@@ -159,7 +194,12 @@ namespace MyServer
          */
         std::ostream &format(std::ostream &os, LogEvent::ptr event);
 
-        std::string getPattern() const { return m_pattern; }
+        const std::string &getPattern() const { return m_pattern; }
+
+        /*
+        @brief 格式模板在SymbolTable中的id，模板相同的格式器id相同
+        */
+        uint32_t getPatternId() const { return m_patternId; }
 
         class FormatItem
         {
@@ -175,6 +215,7 @@ namespace MyServer
 
     private:
         std::string m_pattern;                // 日志格式模板
+        uint32_t m_patternId;                 // 日志格式模板在SymbolTable中的id
         std::vector<FormatItem::ptr> m_items; // 解析后格式模板数组
         bool m_error = false;                 // 是否出错
     };
@@ -186,19 +227,37 @@ namespace MyServer
     {
     public:
         typedef std::shared_ptr<LogAppender> ptr;
-        typedef Spinlock MutexType;
+        typedef AdaptiveMutex MutexType;
 
-        LogAppender(LogFormatter::ptr defaultformatter) : m_defaultformatter(defaultformatter){};
+        LogAppender(LogFormatter::ptr defaultformatter) : m_defaultformatter(defaultformatter), m_current(defaultformatter.get()){};
         virtual ~LogAppender(){};
 
-        void setFormatter(LogFormatter::ptr fmt);
+        virtual void setFormatter(LogFormatter::ptr fmt);
         LogFormatter::ptr getFormatter();
 
+        /*
+         @brief 当前使用的格式器，不加锁也不复制shared_ptr，供Logger在每条日志上按格式模板分组
+         @details 被setFormatter替换下来的格式器保留到Appender析构，返回的指针在Appender析构前一直有效
+         */
+        LogFormatter *getCurrentFormatter() const { return m_current.load(std::memory_order_acquire); }
+
         /*
          @brief 写入日志
          */
         virtual void log(LogEvent::ptr event) = 0;
 
+        /*
+         @brief 写入已经按getFormatter()格式化好的日志
+         @details Logger对格式模板相同的多个Appender只格式化一次，再把同一份结果交给每个Appender。
+                  默认实现忽略data，调用log(event)
+         */
+        virtual void logFormatted(LogEvent::ptr event, const char * /*data*/, size_t /*len*/) { log(event); }
+
+        /*
+         @brief 是否按getFormatter()的格式原样输出，是则Logger可以通过logFormatted交给其格式化好的日志
+         */
+        virtual bool usesFormatter() const { return false; }
+
         /*
          @brief 日志输出目标的配置转为yaml string
          */
@@ -208,6 +267,10 @@ namespace MyServer
         MutexType m_mutex;
         LogFormatter::ptr m_formatter;        // 日志格式
         LogFormatter::ptr m_defaultformatter; // 默认日志格式
+
+    private:
+        std::atomic<LogFormatter *> m_current;     // 当前使用的格式器，即getFormatter()的结果
+        std::vector<LogFormatter::ptr> m_replaced; // 被替换下来的格式器，无锁读到的m_current可能仍指向它们
     };
 
     /*
@@ -221,28 +284,292 @@ namespace MyServer
         StdoutLogAppender() : LogAppender(LogFormatter::ptr(new LogFormatter)) {}
 
         void log(LogEvent::ptr event);
+        void logFormatted(LogEvent::ptr event, const char *data, size_t len) override;
+        bool usesFormatter() const override { return true; }
         std::string toYamlString();
     };
 
     /*
     @brief 输出到文件的Appender
+    @details IO策略：
+      - BUFFERED 直接写入页缓存，由内核决定落盘时机（默认）
+      - SYNC     log()返回前保证日志已经fdatasync落盘，同时等待落盘的线程共享同一次fdatasync（组提交）
+      - DIRECT   以O_DIRECT方式写入，日志先写入按块对齐的缓冲区，攒满缓冲区后写出，不占用页缓存；
+                 不足一块的尾部由后台线程每秒补齐写出一次，进程崩溃时最多丢失最近一两秒的日志
+      - DONTNEED 写入一定量后发起回写，并对已回写的区间posix_fadvise(DONTNEED)，适合只写不读的日志
     */
     class FileLogAppender : public LogAppender
     {
     public:
         typedef std::shared_ptr<FileLogAppender> ptr;
 
-        FileLogAppender(const std::string &file);
+        enum IOPolicy
+        {
+            BUFFERED = 0,
+            SYNC = 1,
+            DIRECT = 2,
+            DONTNEED = 3,
+        };
+
+        /*
+        @brief IO策略转字符串
+        */
+        static const char *PolicyToString(IOPolicy policy);
+
+        /*
+        @brief 字符串转IO策略，无法识别时返回BUFFERED
+        */
+        static IOPolicy PolicyFromString(const std::string &str);
+
+        FileLogAppender(const std::string &file, IOPolicy policy = BUFFERED);
+        ~FileLogAppender();
 
+        /*
+        @brief 重新打开日志文件
+        @details 新文件在锁外打开，持锁只交换文件描述符；打开失败时继续写旧文件。
+                 一般不需要手动调用：后台线程通过inotify监听文件所在目录，并定期比较路径与已打开文件的设备号和inode，
+                 文件被移走、删除或替换（如logrotate）后自动重新打开
+        */
         bool reopen();
         void log(LogEvent::ptr event);
+        void logFormatted(LogEvent::ptr event, const char *data, size_t len) override;
+        bool usesFormatter() const override { return true; }
         std::string toYamlString();
 
+        /*
+        @brief 写出DIRECT模式缓冲区中剩余的日志，并fdatasync落盘
+        */
+        bool flush();
+
+        IOPolicy getPolicy() const { return m_policy; }
+
+    private:
+        /*
+        @brief 按IO策略写入一条格式化后的日志，调用方需持有m_mutex
+        */
+        bool writeLocked(const char *data, size_t len);
+
+        /*
+        @brief 把DIRECT缓冲区补齐到块大小后写出，再截断到实际长度，调用方需持有m_mutex
+        */
+        bool flushDirectLocked();
+
+        /*
+        @brief DIRECT缓冲区中的数据滞留超过s_direct_flush_interval时写出，由后台线程调用
+        */
+        void flushDirectIfStale();
+
+        /*
+        @brief 等待序号不大于seq的写入落盘，由第一个等待者执行fdatasync，其余等待者共享其结果
+        */
+        void waitDurable(uint64_t seq);
+
+        void closeLocked();
+
+        /*
+        @brief 打开日志文件，不访问成员状态，可以在锁外调用
+        @param[out] direct O_DIRECT是否生效
+        @return 文件描述符，失败返回-1
+        */
+        int openFile(bool &direct);
+
+        /*
+        @brief 路径指向的文件是否已经不是当前打开的文件，或者当前没有打开文件
+        */
+        bool needReopen();
+
+        class Watcher;
+
     private:
         std::string m_filename;     // 文件路径
-        std::ofstream m_filestream; // 文件流
-        uint64_t m_lastTime = 0;    // 最近打开时间
+        int m_fd = -1;              // 文件描述符
+        IOPolicy m_policy;          // IO策略
         bool m_reopenError = false; // 打开错误标识
+        dev_t m_dev = 0;            // 当前打开文件的设备号
+        ino_t m_inode = 0;          // 当前打开文件的inode
+        off_t m_fileSize = 0;       // 当前写入位置
+
+        // SYNC：组提交
+        std::mutex m_syncMutex;
+        std::condition_variable m_syncCond;
+        std::atomic<uint64_t> m_writeSeq{0}; // 已写入的日志序号
+        uint64_t m_syncedSeq = 0;            // 已落盘的日志序号
+        bool m_syncing = false;              // 是否有线程正在fdatasync
+
+        // DIRECT：对齐缓冲区
+        bool m_direct = false;          // O_DIRECT是否生效，文件系统不支持时退化为BUFFERED
+        char *m_directBuf = nullptr;    // 缓冲区，首地址按块对齐
+        size_t m_directLen = 0;         // 缓冲区中的数据长度
+        off_t m_directOffset = 0;       // 缓冲区首字节对应的文件偏移，按块对齐
+        uint64_t m_directFlushTime = 0; // 最近一次写出缓冲区的单调时间（毫秒）
+
+        // DONTNEED：回写与丢弃进度
+        off_t m_kickedBytes = 0;  // 已发起回写的位置
+        off_t m_advisedBytes = 0; // 已丢弃页缓存的位置
+    };
+
+    /*
+    @brief 按线程分片输出到文件的Appender
+    @details 每个线程写自己的分片文件"文件路径.线程id"，写入路径上没有共享锁。
+             每条日志前带一行记录头"#序号 纳秒时间戳 长度"，随后是长度为"长度"字节的格式化日志。
+             序号全局唯一，每个线程一次从全局计数器预留64个，平均每64条日志才访问一次共享的原子变量；
+             时间戳取自单调时钟Clock::MonotonicNS()，不受系统时间调整影响，只在同一次开机内可比；
+             MergeShards按(时间戳, 序号)把各分片流式归并回一份有序日志。
+             分片由写入线程的线程本地缓存持有，线程退出时关闭，Appender析构时关闭所有仍在使用的分片
+    */
+    class ShardedFileLogAppender : public LogAppender
+    {
+    public:
+        typedef std::shared_ptr<ShardedFileLogAppender> ptr;
+
+        ShardedFileLogAppender(const std::string &file);
+        ~ShardedFileLogAppender();
+
+        void setFormatter(LogFormatter::ptr fmt) override;
+        void log(LogEvent::ptr event);
+        void logFormatted(LogEvent::ptr event, const char *data, size_t len) override;
+        bool usesFormatter() const override { return true; }
+        std::string toYamlString();
+
+        /*
+        @brief 列出file对应的所有分片文件
+        @param[out] shards 分片文件列表
+        @param[in] file 创建Appender时使用的文件路径
+        */
+        static void ListShards(std::vector<std::string> &shards, const std::string &file);
+
+        /*
+        @brief k路归并分片文件，去掉记录头后输出
+        @param[in] shards 分片文件列表
+        @param[out] os 输出流
+        @return 是否所有分片都完整读取，记录头损坏的分片会在出错处停止读取
+        */
+        static bool MergeShards(const std::vector<std::string> &shards, std::ostream &os);
+
+    private:
+        struct Shard;
+
+        /*
+        @brief 获取当前线程的分片，首次调用时创建
+        */
+        Shard *getShard();
+
+        /*
+        @brief 加上记录头写入分片
+        */
+        void writeRecord(Shard *shard, const char *data, size_t len);
+
+    private:
+        std::string m_filename;                          // 文件路径前缀
+        uint64_t m_id;                                   // 实例编号，用于线程本地缓存查找
+        std::atomic<uint64_t> m_formatterVersion{0};     // 日志格式版本，分片据此刷新缓存的格式器
+        std::vector<std::weak_ptr<Shard>> m_shards;      // 所有分片，由m_mutex保护
+    };
+
+    /*
+    @brief 合并连续重复日志的Appender
+    @details 包装另一个Appender。对日志器名称、级别、文件名、行号和内容计算哈希，内容直接在事件缓冲区上计算，不复制；
+             与上一条相同且仍在窗口期内的日志只计数不输出；遇到不同的日志时先输出一条"last message repeated N times"。
+             没有新日志到来时，由后台线程在窗口到期后一秒内输出汇总，flush()和析构时也会输出
+    */
+    class DedupLogAppender : public LogAppender
+    {
+    public:
+        typedef std::shared_ptr<DedupLogAppender> ptr;
+
+        /*
+        @param[in] appender 实际输出的Appender
+        @param[in] window 合并窗口，单位秒
+        */
+        DedupLogAppender(LogAppender::ptr appender, uint32_t window = 10);
+        ~DedupLogAppender();
+
+        void log(LogEvent::ptr event);
+        std::string toYamlString();
+
+        /*
+        @brief 立即输出当前被合并日志的汇总
+        */
+        void flush();
+
+        LogAppender::ptr getAppender() const { return m_appender; }
+
+    private:
+        /*
+        @brief 生成被合并日志的汇总事件并清零计数，调用方需持有m_mutex
+        */
+        LogEvent::ptr takeRepeatEvent();
+
+        class Sweeper;
+
+    private:
+        LogAppender::ptr m_appender; // 实际输出的Appender
+        uint32_t m_window;           // 合并窗口（秒）
+        uint64_t m_lastHash = 0;     // 上一条日志的哈希
+        LogEvent::ptr m_lastEvent;   // 上一条日志，哈希相同时再比较一次内容
+        time_t m_firstTime = 0;      // 本轮窗口开始时间
+        uint32_t m_repeat = 0;       // 本轮被合并的条数
+    };
+
+    /*
+    @brief 飞行记录仪Appender
+    @details 包装另一个Appender。级别不低于forward的日志直接转发；其余日志（如DEBUG）以紧凑形式写入当前线程的环形缓冲区，
+             写满后覆盖最旧的记录，写入时只持有本线程缓冲区的锁，不格式化。
+             收到级别不低于trigger的日志时，先把所有线程缓冲区中最近window秒内的记录按时间顺序转发，再转发触发的日志；
+             也可以调用dump()手动转发。转发过的记录从缓冲区中移除，不会重复输出。
+             记录只保存文件名指针，LogEvent的文件名必须是__FILE__这样的静态字符串。
+             Logger按自己的级别过滤后才交给Appender，日志器级别必须设为DEBUG（不高于要记录的级别），否则缓冲区里什么也没有；
+             此时同一日志器上的其他Appender也会收到DEBUG日志，应让本Appender作为日志器唯一的Appender，
+             其他输出通过appender参数包装（可以用多个Appender组合），由forward决定直接输出的级别
+    */
+    class FlightRecorderLogAppender : public LogAppender
+    {
+    public:
+        typedef std::shared_ptr<FlightRecorderLogAppender> ptr;
+
+        /*
+        @param[in] appender 实际输出的Appender
+        @param[in] forward 不低于该级别的日志直接转发
+        @param[in] trigger 不低于该级别的日志触发转发缓冲区中的记录
+        @param[in] window 触发时转发最近多少秒的记录
+        @param[in] ring_size 每个线程缓冲区的字节数，向上取整到2的幂
+        */
+        FlightRecorderLogAppender(LogAppender::ptr appender, LogLevel::Level forward = LogLevel::INFO,
+                                  LogLevel::Level trigger = LogLevel::ERROR, uint32_t window = 5, size_t ring_size = 256 * 1024);
+        ~FlightRecorderLogAppender();
+
+        void log(LogEvent::ptr event);
+        std::string toYamlString();
+
+        /*
+        @brief 按时间顺序转发所有线程缓冲区中最近window秒内的记录
+        @return 转发的日志条数
+        */
+        size_t dump();
+
+        LogAppender::ptr getAppender() const { return m_appender; }
+
+    private:
+        struct Record;
+        struct Ring;
+
+        /*
+        @brief 获取当前线程的缓冲区，首次调用时创建
+        @return 线程退出、线程本地缓存已析构时返回nullptr
+        */
+        Ring *getRing();
+
+        void record(LogEvent::ptr event);
+
+    private:
+        LogAppender::ptr m_appender;               // 实际输出的Appender
+        LogLevel::Level m_forward;                 // 直接转发级别
+        LogLevel::Level m_trigger;                 // 触发级别
+        uint32_t m_window;                         // 触发时转发的时间窗口（秒）
+        size_t m_ringSize;                         // 每个线程缓冲区的字节数
+        uint64_t m_id;                             // 实例编号，用于线程本地缓存查找
+        std::mutex m_dumpMutex;                    // 串行化dump，避免两次转发交错
+        std::vector<std::shared_ptr<Ring>> m_rings; // 所有线程的缓冲区，由m_mutex保护
     };
 
     /*
@@ -252,11 +579,12 @@ namespace MyServer
     {
     public:
         typedef std::shared_ptr<Logger> ptr;
-        typedef Spinlock MutexType;
+        typedef AdaptiveMutex MutexType;
 
         Logger(const std::string &name = "default");
 
         const std::string &getName() const { return m_name; }
+        uint32_t getNameId() const { return m_nameId; }
         const uint64_t &getCreateTime() const { return m_createTime; }
         void setLevel(LogLevel::Level level) { m_level = level; }
         LogLevel::Level getLevel() const { return m_level; }
@@ -264,11 +592,18 @@ namespace MyServer
         void delAppender(LogAppender::ptr appender);
         void clearAppenders();
         void log(LogEvent::ptr event);
+
+        /*
+        @brief 不检查日志器级别，直接交给所有Appender输出
+        @details 用于调用点已经判断过是否输出的场景，如日志宏和被强制打开的调用点
+        */
+        void forceLog(LogEvent::ptr event);
         std::string toYamlString();
 
     private:
         MutexType m_mutex;
         std::string m_name;                      // 日志器名称
+        uint32_t m_nameId;                       // 日志器名称在SymbolTable中的id
         LogLevel::Level m_level;                 // 等级
         std::list<LogAppender::ptr> m_appenders; // LogAppender集合
         uint64_t m_createTime;                   // 创建时间（毫秒）
@@ -280,17 +615,22 @@ namespace MyServer
     class LogEventWrap
     {
     public:
-        LogEventWrap(Logger::ptr logger, LogEvent::ptr event);
+        /*
+        @param[in] force 为true时析构时调用Logger::forceLog，不再检查日志器级别
+        */
+        LogEventWrap(Logger::ptr logger, LogEvent::ptr event, bool force = false);
         /*
         @brief 析构函数
         @details 日志事件在析构时由日志器进行输出
         */
         ~LogEventWrap();
         LogEvent::ptr getLogEvent() const { return m_event; }
+        std::stringstream &getSS() { return m_event->getSS(); }
 
     private:
         Logger::ptr m_logger;
         LogEvent::ptr m_event;
+        bool m_force;
     }
 
     /*
@@ -299,7 +639,7 @@ namespace MyServer
     class LoggerManager
     {
     public:
-        typedef Spinlock MutexType;
+        typedef AdaptiveMutex MutexType;
         LoggerManager();
         // void init();
 
@@ -319,6 +659,172 @@ namespace MyServer
 
     typedef  Singleton<LoggerManager> LoggerMgr; // 日志器管理类单例
 
+    /*
+    @brief 按当前时间、线程和协程创建日志事件，供日志宏使用
+    */
+    LogEvent::ptr MakeLogEvent(const Logger &logger, LogLevel::Level level, const char *file, int32_t line);
+
+    struct LogSiteRules;
+
+    /*
+    @brief 日志调用点描述符
+    @details 每个日志宏展开处有一个常量初始化的静态描述符，没有构造开销。
+             state为0时只按日志器级别判断是否输出，这是唯一的热路径：一次静态变量读和一次可预测的分支；
+             非0时进入LogSites::Check，首次执行时向LogSites登记，被强制打开时不受日志器级别限制
+    */
+    struct alignas(32) LogSite
+    {
+        enum State
+        {
+            DEFAULT = 0,      // 已登记，按日志器级别输出
+            FORCED = 1,       // 已登记，至少有一个日志器被强制输出，按rules逐个日志器判断
+            UNREGISTERED = 2, // 尚未执行过
+        };
+
+        const char *file;
+        int32_t line;
+        LogLevel::Level level;
+        std::atomic<const LogSiteRules *> rules; // 匹配本调用点的规则，FORCED时有效，指向的对象不会释放
+        std::atomic<uint8_t> state;
+    };
+
+    /*
+    @brief 调用点级别的动态日志开关
+    @details 按文件名通配符、行号范围和日志器名称通配符强制打开或关闭调用点，不影响日志器级别。
+             规则按添加顺序生效，对某个日志器而言，后添加的规则覆盖先添加的，日志器名称不匹配的规则不影响它；
+             尚未执行过的调用点在首次执行登记时应用已有规则。
+             文件名通配符同时匹配完整的__FILE__和其中的文件名部分，语法同fnmatch
+    @code
+        // 只打开log.cpp第100到200行的DEBUG日志
+        MyServer::LogSites::Enable("log.cpp", 100, 200);
+    @endcode
+    */
+    class LogSites
+    {
+    public:
+        /*
+        @brief 判断调用点是否输出，调用点关闭时只有一次分支
+        */
+        static bool Enabled(LogSite &site, const Logger &logger)
+        {
+            if (__builtin_expect(site.state.load(std::memory_order_relaxed) != LogSite::DEFAULT, 0))
+                return Check(site, logger);
+            return site.level <= logger.getLevel();
+        }
+
+        /*
+        @brief 强制打开匹配的调用点
+        @param[in] file_glob 文件名通配符
+        @param[in] line_begin,line_end 行号范围，闭区间
+        @param[in] logger_glob 日志器名称通配符，只有匹配的日志器才强制输出
+        @return 当前已登记的调用点中受影响的个数
+        */
+        static size_t Enable(const std::string &file_glob, int32_t line_begin = 0, int32_t line_end = INT32_MAX,
+                             const std::string &logger_glob = "*");
+
+        /*
+        @brief 关闭匹配的调用点，恢复为按日志器级别输出，参数同Enable
+        @details 只对名称匹配logger_glob的日志器生效，其他日志器仍按之前的规则强制输出
+        */
+        static size_t Disable(const std::string &file_glob, int32_t line_begin = 0, int32_t line_end = INT32_MAX,
+                              const std::string &logger_glob = "*");
+
+        /*
+        @brief 清除所有规则，所有调用点恢复为按日志器级别输出
+        */
+        static void DisableAll();
+
+        /*
+        @brief 规则和被强制打开的调用点转为yaml string
+        */
+        static std::string ToYamlString();
+
+    private:
+        /*
+        @brief 慢路径：首次执行时登记，强制打开时按规则匹配日志器名称
+        */
+        static bool Check(LogSite &site, const Logger &logger);
+    };
+
 } // end MyServer
 
+/*
+@brief 日志宏的公共部分，其后的语句只在调用点需要输出时执行，可在其中使用_myserver_logger
+@details logger只求值一次；调用点描述符为常量初始化的静态变量，level必须是常量
+*/
+#define MYSERVER_LOG_IF(logger, level)                                                                      \
+    if (const MyServer::Logger::ptr &_myserver_logger = (logger); false)                                    \
+    {                                                                                                       \
+    }                                                                                                       \
+    else if (static MyServer::LogSite _myserver_site = {__FILE__, __LINE__, (level), {nullptr},             \
+                                                        {MyServer::LogSite::UNREGISTERED}};                 \
+             !MyServer::LogSites::Enabled(_myserver_site, *_myserver_logger))                               \
+    {                                                                                                       \
+    }                                                                                                       \
+    else
+
+#define MYSERVER_LOG_WRAP(level) \
+    MyServer::LogEventWrap(_myserver_logger, MyServer::MakeLogEvent(*_myserver_logger, (level), __FILE__, __LINE__), true)
+
+/*
+@brief 流式写入日志
+@code
+    MYSERVER_LOG_INFO(g_logger) << "user " << name << " login";
+@endcode
+*/
+#define MYSERVER_LOG_LEVEL(logger, level) \
+    MYSERVER_LOG_IF(logger, level) MYSERVER_LOG_WRAP(level).getSS()
+
+#define MYSERVER_LOG_FATAL(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::FATAL)
+#define MYSERVER_LOG_ALERT(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::ALERT)
+#define MYSERVER_LOG_CRIT(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::CRIT)
+#define MYSERVER_LOG_ERROR(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::ERROR)
+#define MYSERVER_LOG_WARN(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::WARN)
+#define MYSERVER_LOG_NOTICE(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::NOTICE)
+#define MYSERVER_LOG_INFO(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::INFO)
+#define MYSERVER_LOG_DEBUG(logger) MYSERVER_LOG_LEVEL(logger, MyServer::LogLevel::DEBUG)
+
+/*
+@brief printf风格写入日志
+*/
+#define MYSERVER_LOG_FMT_LEVEL(logger, level, fmt, ...) \
+    MYSERVER_LOG_IF(logger, level) MYSERVER_LOG_WRAP(level).getLogEvent()->printf(fmt, ##__VA_ARGS__)
+
+#define MYSERVER_LOG_FMT_FATAL(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FMT_ALERT(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::ALERT, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FMT_CRIT(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::CRIT, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FMT_ERROR(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FMT_WARN(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FMT_NOTICE(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::NOTICE, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FMT_INFO(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FMT_DEBUG(logger, fmt, ...) MYSERVER_LOG_FMT_LEVEL(logger, MyServer::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+
+/*
+@brief {}风格写入日志，编译期检查格式串与参数个数，fmt必须是字符串字面量
+@code
+    MYSERVER_LOG_FORMAT_INFO(g_logger, "user {} login from {}:{}", name, ip, port);
+@endcode
+*/
+#define MYSERVER_LOG_FORMAT_LEVEL(logger, level, fmt, ...) \
+    MYSERVER_LOG_IF(logger, level) MYSERVER_LOG_WRAP(level).getLogEvent()->format(MYSERVER_FMT(fmt), ##__VA_ARGS__)
+
+#define MYSERVER_LOG_FORMAT_FATAL(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FORMAT_ALERT(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::ALERT, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FORMAT_CRIT(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::CRIT, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FORMAT_ERROR(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FORMAT_WARN(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FORMAT_NOTICE(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::NOTICE, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FORMAT_INFO(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define MYSERVER_LOG_FORMAT_DEBUG(logger, fmt, ...) MYSERVER_LOG_FORMAT_LEVEL(logger, MyServer::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+
+/*
+@brief 获取root日志器
+*/
+#define MYSERVER_LOG_ROOT() MyServer::LoggerMgr::GetInstance()->getRoot()
+
+/*
+@brief 获取指定名称的日志器
+*/
+#define MYSERVER_LOG_NAME(name) MyServer::LoggerMgr::GetInstance()->getLogger(name)
+
 #endif
\ No newline at end of file
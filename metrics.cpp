@@ -0,0 +1,312 @@
+#include <sstream>
+#include <yaml-cpp/yaml.h>
+#include "metrics.h"
+#include "clock.h"
+
+namespace MyServer
+{
+    static std::atomic<uint64_t> s_histogram_id{0}; // 直方图实例编号
+
+    HistogramSnapshot::HistogramSnapshot()
+        : m_buckets(Histogram::BUCKETS, 0)
+    {
+    }
+
+    void HistogramSnapshot::merge(const HistogramSnapshot &other)
+    {
+        for (int i = 0; i < Histogram::BUCKETS; i++)
+        {
+            m_buckets[i] += other.m_buckets[i];
+        }
+        m_count += other.m_count;
+    }
+
+    uint64_t HistogramSnapshot::percentile(double q) const
+    {
+        if (m_count == 0)
+            return 0;
+        if (q < 0)
+            q = 0;
+        if (q > 1)
+            q = 1;
+        // 第rank个值（从1开始）所在的桶
+        uint64_t rank = (uint64_t)(q * m_count + 0.5);
+        if (rank == 0)
+            rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < Histogram::BUCKETS; i++)
+        {
+            seen += m_buckets[i];
+            if (seen >= rank)
+                return Histogram::BucketHigh(i);
+        }
+        return Histogram::BucketHigh(Histogram::BUCKETS - 1);
+    }
+
+    double HistogramSnapshot::getMean() const
+    {
+        if (m_count == 0)
+            return 0;
+        double sum = 0;
+        for (int i = 0; i < Histogram::BUCKETS; i++)
+        {
+            if (m_buckets[i])
+                sum += m_buckets[i] * ((Histogram::BucketLow(i) + Histogram::BucketHigh(i)) / 2.0);
+        }
+        return sum / m_count;
+    }
+
+    uint64_t HistogramSnapshot::getMin() const
+    {
+        for (int i = 0; i < Histogram::BUCKETS; i++)
+        {
+            if (m_buckets[i])
+                return Histogram::BucketLow(i);
+        }
+        return 0;
+    }
+
+    uint64_t HistogramSnapshot::getMax() const
+    {
+        for (int i = Histogram::BUCKETS - 1; i >= 0; i--)
+        {
+            if (m_buckets[i])
+                return Histogram::BucketHigh(i);
+        }
+        return 0;
+    }
+
+    Histogram::Shard::Shard()
+    {
+        for (auto &i : buckets)
+            i.store(0, std::memory_order_relaxed);
+    }
+
+    Histogram::Histogram()
+        : m_id(++s_histogram_id), m_retired(BUCKETS, 0), m_base(BUCKETS, 0)
+    {
+    }
+
+    Histogram::~Histogram()
+    {
+        MutexType::Lock lock(m_mutex);
+        for (auto &i : m_shards)
+            i->orphaned.store(true, std::memory_order_relaxed);
+    }
+
+    int Histogram::BucketIndex(uint64_t value)
+    {
+        if (value < (1ull << SUB_BITS))
+            return value;
+        if (value >= (1ull << MAX_BITS))
+            return BUCKETS - 1;
+        // 最高位决定所在的2的幂区间，其后SUB_BITS位决定区间内的桶
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - SUB_BITS;
+        return ((shift + 1) << SUB_BITS) + ((value >> shift) & ((1 << SUB_BITS) - 1));
+    }
+
+    uint64_t Histogram::BucketLow(int index)
+    {
+        if (index < (1 << SUB_BITS))
+            return index;
+        int shift = (index >> SUB_BITS) - 1;
+        uint64_t sub = index & ((1 << SUB_BITS) - 1);
+        return ((1ull << SUB_BITS) + sub) << shift;
+    }
+
+    uint64_t Histogram::BucketHigh(int index)
+    {
+        if (index < (1 << SUB_BITS))
+            return index;
+        int shift = (index >> SUB_BITS) - 1;
+        return BucketLow(index) + (1ull << shift) - 1;
+    }
+
+    Histogram::Shard *Histogram::getShard()
+    {
+        // 线程本地缓存按直方图编号索引；线程退出时缓存析构，把自己的桶标记为已退出，之后在其他线程本地对象的析构中记录的值走m_exiting
+        static thread_local bool t_exited = false;
+        static thread_local uint64_t t_last_id = 0;
+        static thread_local Shard *t_last_shard = nullptr;
+        struct ShardCache
+        {
+            std::vector<std::shared_ptr<Shard>> shards;
+            ~ShardCache()
+            {
+                t_exited = true;
+                t_last_id = 0;
+                t_last_shard = nullptr;
+                // release：合并时看到exited就能看到本线程之前对桶的所有写入
+                for (auto &i : shards)
+                {
+                    if (i)
+                        i->exited.store(true, std::memory_order_release);
+                }
+            }
+        };
+        static thread_local ShardCache t_cache;
+        if (t_exited)
+            return nullptr;
+        if (t_last_id == m_id)
+            return t_last_shard;
+
+        if (m_id >= t_cache.shards.size())
+        {
+            // 缓存扩大时顺便释放已析构的直方图留在本线程的桶
+            for (auto &i : t_cache.shards)
+            {
+                if (i && i->orphaned.load(std::memory_order_relaxed))
+                    i.reset();
+            }
+            t_cache.shards.resize(m_id + 1);
+        }
+        std::shared_ptr<Shard> &shard = t_cache.shards[m_id];
+        if (!shard)
+        {
+            shard.reset(new Shard);
+            MutexType::Lock lock(m_mutex);
+            // 新线程登记时合并已退出线程的桶，线程反复创建退出时登记表不会增长
+            for (auto it = m_shards.begin(); it != m_shards.end();)
+            {
+                if ((*it)->exited.load(std::memory_order_acquire))
+                {
+                    for (int i = 0; i < BUCKETS; i++)
+                        m_retired[i] += (*it)->buckets[i].load(std::memory_order_relaxed);
+                    it = m_shards.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            m_shards.push_back(shard);
+        }
+        t_last_id = m_id;
+        t_last_shard = shard.get();
+        return t_last_shard;
+    }
+
+    void Histogram::record(uint64_t value)
+    {
+        int index = BucketIndex(value);
+        Shard *shard = getShard();
+        if (!shard)
+        {
+            m_exiting.buckets[index].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // 桶只有本线程写，读和写分开即可，不需要带锁前缀的fetch_add
+        std::atomic<uint64_t> &bucket = shard->buckets[index];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void Histogram::total(std::vector<uint64_t> &buckets) const
+    {
+        buckets = m_retired;
+        for (int i = 0; i < BUCKETS; i++)
+            buckets[i] += m_exiting.buckets[i].load(std::memory_order_relaxed);
+        for (auto &shard : m_shards)
+        {
+            for (int i = 0; i < BUCKETS; i++)
+                buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    HistogramSnapshot Histogram::snapshot() const
+    {
+        HistogramSnapshot snap;
+        MutexType::Lock lock(m_mutex);
+        total(snap.m_buckets);
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            // 计数只增不减，减去reset时的计数即为之后记录的值
+            uint64_t n = snap.m_buckets[i] > m_base[i] ? snap.m_buckets[i] - m_base[i] : 0;
+            snap.m_buckets[i] = n;
+            snap.m_count += n;
+        }
+        return snap;
+    }
+
+    void Histogram::reset()
+    {
+        MutexType::Lock lock(m_mutex);
+        total(m_base);
+    }
+
+    Histogram::Timer::Timer(Histogram &histogram)
+        : m_histogram(histogram), m_start(Clock::MonotonicNS(Clock::TSC))
+    {
+    }
+
+    Histogram::Timer::~Timer()
+    {
+        m_histogram.record(Clock::MonotonicNS(Clock::TSC) - m_start);
+    }
+
+    Counter::ptr MetricsManager::getCounter(const std::string &name)
+    {
+        MutexType::Lock lock(m_mutex);
+        Counter::ptr &v = m_counters[name];
+        if (!v)
+            v.reset(new Counter);
+        return v;
+    }
+
+    Gauge::ptr MetricsManager::getGauge(const std::string &name)
+    {
+        MutexType::Lock lock(m_mutex);
+        Gauge::ptr &v = m_gauges[name];
+        if (!v)
+            v.reset(new Gauge);
+        return v;
+    }
+
+    Histogram::ptr MetricsManager::getHistogram(const std::string &name)
+    {
+        MutexType::Lock lock(m_mutex);
+        Histogram::ptr &v = m_histograms[name];
+        if (!v)
+            v.reset(new Histogram);
+        return v;
+    }
+
+    std::string MetricsManager::toYamlString()
+    {
+        std::map<std::string, Counter::ptr> counters;
+        std::map<std::string, Gauge::ptr> gauges;
+        std::map<std::string, Histogram::ptr> histograms;
+        {
+            MutexType::Lock lock(m_mutex);
+            counters = m_counters;
+            gauges = m_gauges;
+            histograms = m_histograms;
+        }
+        YAML::Node node;
+        for (auto &i : counters)
+        {
+            node["counters"][i.first] = i.second->value();
+        }
+        for (auto &i : gauges)
+        {
+            node["gauges"][i.first] = i.second->value();
+        }
+        for (auto &i : histograms)
+        {
+            HistogramSnapshot snap = i.second->snapshot();
+            YAML::Node n;
+            n["count"] = snap.getCount();
+            n["mean"] = snap.getMean();
+            n["min"] = snap.getMin();
+            n["p50"] = snap.percentile(0.5);
+            n["p90"] = snap.percentile(0.9);
+            n["p99"] = snap.percentile(0.99);
+            n["p999"] = snap.percentile(0.999);
+            n["max"] = snap.getMax();
+            node["histograms"][i.first] = n;
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+}
@@ -0,0 +1,218 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+
+namespace MyServer
+{
+    /**
+     * @brief 直方图快照，可以合并多个直方图或多个时间段的快照后再求分位数
+     */
+    class HistogramSnapshot
+    {
+    public:
+        HistogramSnapshot();
+
+        /**
+         * @brief 合并另一份快照
+         */
+        void merge(const HistogramSnapshot &other);
+
+        /**
+         * @brief 分位数
+         * @param[in] q 0到1之间，如0.99
+         * @return 分位数所在桶的上界，相对误差不超过1/16；没有数据时返回0
+         */
+        uint64_t percentile(double q) const;
+
+        uint64_t getCount() const { return m_count; }
+
+        /**
+         * @brief 平均值，按每个桶的中点估算，精度同percentile
+         */
+        double getMean() const;
+
+        /**
+         * @brief 最小值和最大值，精度同percentile
+         */
+        uint64_t getMin() const;
+        uint64_t getMax() const;
+
+        const std::vector<uint64_t> &getBuckets() const { return m_buckets; }
+
+    private:
+        friend class Histogram;
+        std::vector<uint64_t> m_buckets;
+        uint64_t m_count = 0;
+    };
+
+    /**
+     * @brief 固定内存的对数线性直方图（HDR风格）
+     * @details 每个2的幂区间再等分为16个桶，任意值的相对误差不超过1/16，0~15精确记录；
+     *          可记录的最大值为2^40-1（按纳秒约18分钟），更大的值计入最后一个桶。
+     *          每个线程首次记录时创建自己的一组桶并登记到直方图，之后记录只有本线程写，
+     *          是一次relaxed的读和写，没有带锁前缀的原子指令，也不会与其他线程写同一缓存行；
+     *          snapshot汇总所有线程的桶。线程退出后它的桶在下一个线程登记时合并到直方图中，不随线程数无限增长。
+     *          为此不单独累加总和，平均值由桶估算
+     */
+    class Histogram
+    {
+    public:
+        typedef std::shared_ptr<Histogram> ptr;
+
+        typedef Spinlock MutexType;
+
+        static const int SUB_BITS = 4;
+        static const int MAX_BITS = 40;
+        static const int BUCKETS = (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+        Histogram();
+        ~Histogram();
+
+        /**
+         * @brief 记录一个值
+         */
+        void record(uint64_t value);
+
+        /**
+         * @brief 各线程的桶汇总后的快照，不阻塞并发的record，快照中可能包含部分同时记录的值
+         */
+        HistogramSnapshot snapshot() const;
+
+        /**
+         * @brief 清空，记下当前的计数，之后的快照减去这部分；不阻塞并发的record，同时记录的值可能计入清空前
+         */
+        void reset();
+
+        /**
+         * @brief 值所在桶的下标
+         */
+        static int BucketIndex(uint64_t value);
+
+        /**
+         * @brief 桶能表示的最小值和最大值
+         */
+        static uint64_t BucketLow(int index);
+        static uint64_t BucketHigh(int index);
+
+        /**
+         * @brief 作用域计时器，析构时把经过的纳秒数记录到直方图
+         */
+        class Timer
+        {
+        public:
+            explicit Timer(Histogram &histogram);
+            ~Timer();
+
+        private:
+            Histogram &m_histogram;
+            uint64_t m_start;
+        };
+
+    private:
+        /**
+         * @brief 一个线程的桶，由线程本地缓存和直方图共同持有
+         */
+        struct alignas(64) Shard
+        {
+            std::atomic<uint64_t> buckets[BUCKETS];
+            std::atomic<bool> exited{false};   // 写入线程已退出，桶不再变化，可以合并
+            std::atomic<bool> orphaned{false}; // 直方图已析构，线程本地缓存可以释放
+
+            Shard();
+        };
+
+        /**
+         * @brief 获取当前线程的桶，首次调用时创建并登记
+         * @return 线程退出、线程本地缓存已析构时返回nullptr
+         */
+        Shard *getShard();
+
+        /**
+         * @brief 已合并、仍在写入和线程退出过程中记录的计数之和，调用方需持有m_mutex
+         */
+        void total(std::vector<uint64_t> &buckets) const;
+
+    private:
+        // 实例编号，线程本地缓存按编号索引，不用地址，避免析构后地址被新直方图复用
+        const uint64_t m_id;
+        mutable MutexType m_mutex;
+        // 登记的各线程的桶
+        std::vector<std::shared_ptr<Shard>> m_shards;
+        // 已退出线程合并后的计数
+        std::vector<uint64_t> m_retired;
+        // reset时的计数
+        std::vector<uint64_t> m_base;
+        // 线程本地缓存析构后（线程退出过程中）记录的值，多个线程可能同时写，用原子加
+        Shard m_exiting;
+    };
+
+    /**
+     * @brief 计数器，只增不减
+     */
+    class Counter
+    {
+    public:
+        typedef std::shared_ptr<Counter> ptr;
+
+        void add(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> m_value{0};
+    };
+
+    /**
+     * @brief 瞬时值，如队列长度、连接数
+     */
+    class Gauge
+    {
+    public:
+        typedef std::shared_ptr<Gauge> ptr;
+
+        void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+        void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> m_value{0};
+    };
+
+    /**
+     * @brief 指标管理类
+     * @details 按名称登记计数器、瞬时值和直方图，同名指标只创建一次。
+     *          热路径上应保存返回的指针，不要每次按名称查找
+     */
+    class MetricsManager
+    {
+    public:
+        typedef Spinlock MutexType;
+
+        /**
+         * @brief 获取指定名称的指标，不存在时创建
+         */
+        Counter::ptr getCounter(const std::string &name);
+        Gauge::ptr getGauge(const std::string &name);
+        Histogram::ptr getHistogram(const std::string &name);
+
+        /**
+         * @brief 所有指标转为yaml string，直方图输出count、mean、min、p50、p90、p99、p999、max
+         */
+        std::string toYamlString();
+
+    private:
+        MutexType m_mutex;
+        std::map<std::string, Counter::ptr> m_counters;
+        std::map<std::string, Gauge::ptr> m_gauges;
+        std::map<std::string, Histogram::ptr> m_histograms;
+    };
+
+    typedef Singleton<MetricsManager> MetricsMgr; // 指标管理类单例
+}
+
+#endif
@@ -0,0 +1,502 @@
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h> // for sched_yield()
+#include <time.h>
+#include <dirent.h>
+#include <sys/eventfd.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#include "profiler.h"
+#include "util.h"
+#include "clock.h"
+#include "thread_registry.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace MyServer
+{
+    namespace
+    {
+        static const int s_max_depth = 64;      // 每个样本最多保存的栈层数
+        static const uint32_t s_ring_size = 128; // 每个线程缓冲的样本数，必须是2的幂
+        static const int s_drain_interval = 100; // 后台线程取样本的间隔毫秒数
+        static const int s_scan_interval = 1000; // 扫描新线程的间隔毫秒数
+
+        struct Sample
+        {
+            int depth;
+            void *frames[s_max_depth];
+        };
+
+        /**
+         * @brief 单线程样本缓冲区，写者是该线程上的信号处理函数，读者是后台线程
+         * @details timer_delete之后，已产生但未递送的SIGPROF仍带着缓冲区地址，可能在缓冲区回收、分给别的线程后才到达。
+         *          处理函数先增加writers再核对tid是否为当前线程，回收方先把tid清零再等writers归零，
+         *          两边都是顺序一致的原子操作，保证迟到的信号要么被丢弃，要么在回收前写完，缓冲区始终只有一个写者
+         */
+        struct Ring
+        {
+            std::atomic<uint64_t> head{0};      // 写入位置，只由信号处理函数修改
+            std::atomic<uint64_t> tail{0};      // 读取位置，只由后台线程修改
+            std::atomic<uint64_t> dropped{0};   // 缓冲区满时丢弃的样本数
+            std::atomic<uint64_t> handlerNS{0}; // 信号处理函数累计耗时
+            std::atomic<pid_t> tid{0};          // 所属线程，在池中空闲时为0
+            std::atomic<int> writers{0};        // 正在写入的信号处理函数数
+            std::string name; // 创建定时器时的线程名
+            Sample samples[s_ring_size];
+        };
+
+        struct ThreadTimer
+        {
+            timer_t timer;
+            Ring *ring;
+        };
+
+        struct ProfilerState
+        {
+            std::mutex control; // 串行化Start/Stop/InstallSignalToggle
+            std::mutex mutex;   // 保护以下成员
+            std::condition_variable cond;
+            std::thread thread;
+            bool running = false;
+            bool stop = false;
+            uint32_t hz = 0;
+            // 空闲的缓冲区；缓冲区地址会作为定时器的sigev_value，分配后不再释放，避免迟到的信号访问已释放的内存
+            std::vector<Ring *> pool;
+            std::unordered_map<pid_t, ThreadTimer> timers;
+            // 线程名 + '\0' + 返回地址数组 -> 样本数
+            std::unordered_map<std::string, uint64_t> stacks;
+            uint64_t samples = 0;
+            uint64_t dropped = 0;   // 已回收缓冲区上的丢弃数
+            uint64_t handlerNS = 0; // 已回收缓冲区上的处理耗时
+            int toggleFd = -1;
+        };
+
+        static ProfilerState &GetState()
+        {
+            static ProfilerState *s_state = new ProfilerState; // 信号可能在退出过程中到达，不析构
+            return *s_state;
+        }
+
+        static std::atomic<bool> s_sampling{false};
+
+        static uint64_t MonotonicNS()
+        {
+            // 不能用TSC模式的Clock：信号可能打断同一线程上正在进行的校准，读者会一直等待
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        }
+
+        static void ProfHandler(int, siginfo_t *info, void *)
+        {
+            if (info->si_code != SI_TIMER || !s_sampling.load(std::memory_order_relaxed))
+                return;
+            Ring *ring = (Ring *)info->si_value.sival_ptr;
+            if (!ring)
+                return;
+            int saved_errno = errno;
+            ring->writers.fetch_add(1);
+            if (ring->tid.load() != GetThreadId())
+            {
+                // 定时器删除前产生的迟到信号，缓冲区已经回收或分给了别的线程
+                ring->writers.fetch_sub(1);
+                errno = saved_errno;
+                return;
+            }
+            uint64_t start = MonotonicNS();
+            uint64_t head = ring->head.load(std::memory_order_relaxed);
+            if (head - ring->tail.load(std::memory_order_acquire) >= s_ring_size)
+            {
+                ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                Sample &sample = ring->samples[head & (s_ring_size - 1)];
+                // 跳过ProfHandler和内核设置的信号返回桩__restore_rt
+                sample.depth = CaptureStack(sample.frames, s_max_depth, 2);
+                ring->head.store(head + 1, std::memory_order_release);
+            }
+            ring->handlerNS.fetch_add(MonotonicNS() - start, std::memory_order_relaxed);
+            ring->writers.fetch_sub(1);
+            errno = saved_errno;
+        }
+
+        static void DrainLocked(ProfilerState &st, Ring *ring)
+        {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            std::string key;
+            for (; tail != head; ++tail)
+            {
+                const Sample &sample = ring->samples[tail & (s_ring_size - 1)];
+                key.assign(ring->name);
+                key.push_back('\0');
+                key.append((const char *)sample.frames, sample.depth * sizeof(void *));
+                ++st.stacks[key];
+                ++st.samples;
+            }
+            ring->tail.store(tail, std::memory_order_release);
+        }
+
+        static std::string ReadThreadName(pid_t tid)
+        {
+            std::ifstream ifs("/proc/self/task/" + std::to_string(tid) + "/comm");
+            std::string name;
+            std::getline(ifs, name);
+            return name.empty() ? std::to_string(tid) : name;
+        }
+
+        /**
+         * @brief 回收缓冲区：先让迟到的信号不再写入，等正在写的处理函数退出，再取出剩余样本放回池中
+         */
+        static void ReleaseRingLocked(ProfilerState &st, Ring *ring)
+        {
+            ring->tid.store(0);
+            while (ring->writers.load() != 0)
+                sched_yield();
+            DrainLocked(st, ring);
+            st.dropped += ring->dropped;
+            st.handlerNS += ring->handlerNS;
+            st.pool.push_back(ring);
+        }
+
+        static bool AddThreadLocked(ProfilerState &st, pid_t tid)
+        {
+            Ring *ring;
+            if (st.pool.empty())
+            {
+                ring = new Ring;
+            }
+            else
+            {
+                ring = st.pool.back();
+                st.pool.pop_back();
+            }
+            ring->head = ring->tail = 0;
+            ring->dropped = ring->handlerNS = 0;
+            ring->name = ReadThreadName(tid);
+            ring->tid = tid; // 最后设置，之后这个线程上的信号才会写入
+
+            struct sigevent sev;
+            memset(&sev, 0, sizeof(sev));
+            sev.sigev_notify = SIGEV_THREAD_ID;
+            sev.sigev_signo = SIGPROF;
+            sev.sigev_value.sival_ptr = ring;
+            sev.sigev_notify_thread_id = tid;
+            // 线程CPU时钟，等价于内核的MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED)，
+            // pthread_getcpuclockid只能用于本进程创建的pthread_t，这里需要按tid构造
+            clockid_t clock = ((~(clockid_t)tid) << 3) | 6;
+            ThreadTimer tt;
+            tt.ring = ring;
+            if (timer_create(clock, &sev, &tt.timer) != 0)
+            {
+                // 线程已经退出
+                ReleaseRingLocked(st, ring);
+                return false;
+            }
+            struct itimerspec its;
+            its.it_interval.tv_sec = 0;
+            its.it_interval.tv_nsec = 1000000000 / st.hz;
+            its.it_value = its.it_interval;
+            if (timer_settime(tt.timer, 0, &its, nullptr) != 0)
+            {
+                timer_delete(tt.timer);
+                ReleaseRingLocked(st, ring);
+                return false;
+            }
+            st.timers[tid] = tt;
+            return true;
+        }
+
+        static void RemoveThreadLocked(ProfilerState &st, pid_t tid)
+        {
+            auto it = st.timers.find(tid);
+            if (it == st.timers.end())
+                return;
+            timer_delete(it->second.timer);
+            Ring *ring = it->second.ring;
+            ReleaseRingLocked(st, ring);
+            st.timers.erase(it);
+        }
+
+        /**
+         * @brief 为新线程创建定时器，回收已退出线程的定时器，刷新线程名
+         */
+        static void ScanThreadsLocked(ProfilerState &st, pid_t self)
+        {
+            DIR *dir = opendir("/proc/self/task");
+            if (!dir)
+                return;
+            std::unordered_map<pid_t, bool> alive;
+            struct dirent *dp;
+            while ((dp = readdir(dir)) != nullptr)
+            {
+                pid_t tid = atoi(dp->d_name);
+                if (tid <= 0 || tid == self)
+                    continue;
+                alive[tid] = true;
+                auto it = st.timers.find(tid);
+                if (it == st.timers.end())
+                    AddThreadLocked(st, tid);
+                else
+                    it->second.ring->name = ReadThreadName(tid); // 线程可能在创建定时器后才改名
+            }
+            closedir(dir);
+            std::vector<pid_t> gone;
+            for (auto &i : st.timers)
+            {
+                if (!alive.count(i.first))
+                    gone.push_back(i.first);
+            }
+            for (auto tid : gone)
+            {
+                RemoveThreadLocked(st, tid);
+            }
+        }
+
+        static void Run()
+        {
+            ThreadRegistry::Register("profiler");
+            ProfilerState &st = GetState();
+            pid_t self = GetThreadId();
+            uint64_t last_scan = 0;
+            std::unique_lock<std::mutex> lock(st.mutex);
+            while (!st.stop)
+            {
+                uint64_t now = GetElapsedMS();
+                if (last_scan == 0 || now >= last_scan + s_scan_interval)
+                {
+                    ScanThreadsLocked(st, self);
+                    last_scan = now;
+                }
+                st.cond.wait_for(lock, std::chrono::milliseconds(s_drain_interval));
+                for (auto &i : st.timers)
+                {
+                    DrainLocked(st, i.second.ring);
+                }
+            }
+        }
+
+        static void ToggleHandler(int)
+        {
+            int saved_errno = errno;
+            uint64_t v = 1;
+            if (write(GetState().toggleFd, &v, sizeof(v)) < 0)
+            {
+                // 计数溢出时忽略本次信号
+            }
+            errno = saved_errno;
+        }
+    }
+
+    double Profiler::Stats::overhead() const
+    {
+        if (samples + dropped == 0 || hz == 0)
+            return 0;
+        return (double)handlerNS * hz / ((samples + dropped) * 1e9);
+    }
+
+    bool Profiler::Start(uint32_t hz)
+    {
+        ProfilerState &st = GetState();
+        if (hz == 0 || hz > 1000000)
+            return false;
+        std::lock_guard<std::mutex> control(st.control);
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            if (st.running)
+                return false;
+            static bool s_installed = false;
+            if (!s_installed)
+            {
+                // 处理函数一直保留：停止后仍可能有已产生的SIGPROF未递送，恢复默认处理会终止进程
+                struct sigaction sa;
+                memset(&sa, 0, sizeof(sa));
+                sa.sa_sigaction = ProfHandler;
+                sa.sa_flags = SA_SIGINFO | SA_RESTART;
+                sigemptyset(&sa.sa_mask);
+                if (sigaction(SIGPROF, &sa, nullptr) != 0)
+                {
+                    std::cout << "[ERROR] Profiler::Start() sigaction error: " << strerror(errno) << std::endl;
+                    return false;
+                }
+                s_installed = true;
+            }
+            // 预先展开一次栈，加载libgcc，之后在信号处理函数中不会再分配内存
+            void *frames[4];
+            CaptureStack(frames, 4);
+
+            st.running = true;
+            st.stop = false;
+            st.hz = hz;
+            st.stacks.clear();
+            st.samples = st.dropped = st.handlerNS = 0;
+        }
+        s_sampling = true;
+        st.thread = std::thread(Run);
+        return true;
+    }
+
+    void Profiler::Stop()
+    {
+        ProfilerState &st = GetState();
+        std::lock_guard<std::mutex> control(st.control);
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            if (!st.running)
+                return;
+            st.running = false;
+            st.stop = true;
+        }
+        s_sampling = false;
+        st.cond.notify_all();
+        st.thread.join();
+
+        std::lock_guard<std::mutex> lock(st.mutex);
+        std::vector<pid_t> tids;
+        for (auto &i : st.timers)
+        {
+            tids.push_back(i.first);
+        }
+        for (auto tid : tids)
+        {
+            RemoveThreadLocked(st, tid);
+        }
+    }
+
+    bool Profiler::IsRunning()
+    {
+        ProfilerState &st = GetState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        return st.running;
+    }
+
+    void Profiler::Dump(std::ostream &os)
+    {
+        ProfilerState &st = GetState();
+        std::vector<std::pair<std::string, uint64_t>> stacks;
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            for (auto &i : st.timers)
+            {
+                DrainLocked(st, i.second.ring);
+            }
+            stacks.assign(st.stacks.begin(), st.stacks.end());
+        }
+
+        // 符号解析较慢，在锁外进行，每个地址只解析一次
+        std::unordered_map<void *, std::string> symbols;
+        std::string line;
+        for (auto &i : stacks)
+        {
+            size_t pos = i.first.find('\0');
+            const void *const *frames = (const void *const *)(i.first.data() + pos + 1);
+            int depth = (i.first.size() - pos - 1) / sizeof(void *);
+            line.assign(i.first, 0, pos);
+            for (int j = depth - 1; j >= 0; --j)
+            {
+                void *addr = (void *)frames[j];
+                auto it = symbols.find(addr);
+                if (it == symbols.end())
+                {
+                    std::string name = SymbolizeFrame(addr);
+                    std::replace(name.begin(), name.end(), ';', ':'); // ';'是collapsed格式的分隔符
+                    it = symbols.emplace(addr, std::move(name)).first;
+                }
+                line.push_back(';');
+                line.append(it->second);
+            }
+            os << line << ' ' << i.second << '\n';
+        }
+    }
+
+    bool Profiler::DumpToFile(const std::string &file)
+    {
+        std::ofstream ofs;
+        if (!FSUtil::OpenForWrite(ofs, file, std::ios::trunc))
+        {
+            std::cout << "[ERROR] Profiler::DumpToFile() open " << file << " error: " << strerror(errno) << std::endl;
+            return false;
+        }
+        Dump(ofs);
+        return ofs.good();
+    }
+
+    Profiler::Stats Profiler::GetStats()
+    {
+        ProfilerState &st = GetState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        Stats stats;
+        stats.samples = st.samples;
+        stats.dropped = st.dropped;
+        stats.handlerNS = st.handlerNS;
+        for (auto &i : st.timers)
+        {
+            stats.dropped += i.second.ring->dropped;
+            stats.handlerNS += i.second.ring->handlerNS;
+        }
+        stats.threads = st.timers.size();
+        stats.hz = st.hz;
+        return stats;
+    }
+
+    bool Profiler::InstallSignalToggle(int signo, const std::string &file, uint32_t hz)
+    {
+        ProfilerState &st = GetState();
+        std::lock_guard<std::mutex> control(st.control);
+        if (st.toggleFd >= 0)
+            return false;
+        st.toggleFd = eventfd(0, EFD_CLOEXEC);
+        if (st.toggleFd < 0)
+        {
+            std::cout << "[ERROR] Profiler::InstallSignalToggle() eventfd error: " << strerror(errno) << std::endl;
+            return false;
+        }
+        int fd = st.toggleFd;
+        std::thread([fd, file, hz]() {
+            ThreadRegistry::Register("profiler");
+            while (true)
+            {
+                uint64_t v;
+                if (read(fd, &v, sizeof(v)) != sizeof(v))
+                {
+                    if (errno == EINTR)
+                        continue;
+                    return;
+                }
+                if (Profiler::IsRunning())
+                {
+                    Profiler::Stop();
+                    Profiler::DumpToFile(file);
+                }
+                else
+                {
+                    Profiler::Start(hz);
+                }
+            }
+        }).detach();
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = ToggleHandler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(signo, &sa, nullptr) != 0)
+        {
+            std::cout << "[ERROR] Profiler::InstallSignalToggle() sigaction error: " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
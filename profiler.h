@@ -0,0 +1,84 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+
+namespace MyServer
+{
+    /**
+     * @brief 进程内采样CPU剖析器
+     * @details 为进程内每个线程创建一个基于该线程CPU时间的定时器（timer_create + SIGEV_THREAD_ID），
+     *          线程每消耗1/hz秒CPU时间就在该线程上收到一次SIGPROF。信号处理函数用CaptureStack抓取调用栈，
+     *          写入该线程独占的无锁环形缓冲区，不加锁也不分配内存。
+     *          后台线程定期取出样本按调用栈聚合，并每秒扫描/proc/self/task为新线程创建定时器。
+     *          Dump输出collapsed stack格式（"线程名;根函数;...;栈顶函数 样本数"），可直接交给flamegraph.pl生成火焰图
+     * @note 占用SIGPROF，不能与setitimer(ITIMER_PROF)或其他使用SIGPROF的剖析工具同时使用；
+     *       无符号信息的静态函数显示为"模块名(+偏移)"，链接时加-rdynamic可以解析更多函数名
+     */
+    class Profiler
+    {
+    public:
+        /**
+         * @brief 开销统计
+         */
+        struct Stats
+        {
+            // 已聚合的样本数
+            uint64_t samples = 0;
+            // 因缓冲区满被丢弃的样本数
+            uint64_t dropped = 0;
+            // 信号处理函数累计耗时
+            uint64_t handlerNS = 0;
+            // 当前被采样的线程数
+            uint32_t threads = 0;
+            // 采样频率
+            uint32_t hz = 0;
+
+            /**
+             * @brief 剖析本身占被采样CPU时间的比例，即信号处理函数耗时/样本代表的CPU时间
+             */
+            double overhead() const;
+        };
+
+        /**
+         * @brief 开始采样，清空上一次的结果
+         * @param[in] hz 每个线程每秒CPU时间的采样次数，默认99次避免与其他周期性任务同步
+         * @return 是否成功，已经在运行时返回false
+         */
+        static bool Start(uint32_t hz = 99);
+
+        /**
+         * @brief 停止采样，已采集的结果保留到下一次Start
+         */
+        static void Stop();
+
+        static bool IsRunning();
+
+        /**
+         * @brief 以collapsed stack格式输出当前聚合结果，运行中也可以调用
+         */
+        static void Dump(std::ostream &os);
+
+        /**
+         * @brief 输出到文件
+         * @return 是否成功
+         */
+        static bool DumpToFile(const std::string &file);
+
+        static Stats GetStats();
+
+        /**
+         * @brief 用信号在运行时开关剖析：收到第一次信号开始采样，第二次停止并把结果写入file，如此往复
+         * @details 信号处理函数只向eventfd写入通知，启停和写文件在单独的线程中完成
+         * @param[in] signo 信号，如SIGUSR2
+         * @param[in] file 结果文件
+         * @param[in] hz 采样频率
+         * @return 是否成功
+         */
+        static bool InstallSignalToggle(int signo, const std::string &file, uint32_t hz = 99);
+    };
+}
+
+#endif
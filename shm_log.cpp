@@ -0,0 +1,563 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <algorithm>
+#include <sstream>
+#include <yaml-cpp/yaml.h>
+#include "shm_log.h"
+#include "util.h"
+#include "clock.h"
+#include "thread_registry.h"
+
+namespace MyServer
+{
+    static const uint32_t s_shm_magic = 0x474c534d; // "MSLG"
+    static const uint32_t s_shm_version = 1;
+    static const size_t s_shm_header_size = 4096;      // 段头占一页，槽从第二页开始
+    static const uint32_t s_continuation = UINT32_MAX; // 续槽的len标记
+
+    /**
+     * @brief 段头，所有字段都是跨进程共享的
+     */
+    struct ShmLogRing::Header
+    {
+        std::atomic<uint32_t> magic; // 初始化完成后最后写入
+        uint32_t version;
+        uint32_t slotSize;
+        uint32_t slotCount;
+        alignas(64) std::atomic<uint64_t> writePos; // 写者争用的写位置
+        alignas(64) std::atomic<uint64_t> readPos;  // 收集者的读位置，收集者重启后从这里继续
+        std::atomic<uint64_t> written;
+        std::atomic<uint64_t> skipped;
+        std::atomic<uint64_t> corrupt;
+        alignas(64) std::atomic<uint64_t> dropped;
+    };
+
+    /**
+     * @brief 槽头，其后是slotSize - sizeof(Slot)字节的数据
+     * @details 序号为pos表示该槽空闲、可被写位置pos占用（或已被占用尚未提交），pos + 1表示已提交，
+     *          收集者读出后置为pos + slotCount，留给下一圈的写者。
+     *          一条记录占用连续若干个槽，首槽的len为记录总长度、checksum为整条记录的校验和，续槽的len为s_continuation
+     */
+    struct ShmLogRing::Slot
+    {
+        std::atomic<uint64_t> seq;
+        uint32_t len;
+        uint32_t checksum;
+    };
+
+    static_assert(sizeof(std::atomic<uint64_t>) == 8 && std::atomic<uint64_t>::is_always_lock_free,
+                  "shared memory ring requires lock-free 64-bit atomics");
+
+    static inline char *SlotData(void *slot)
+    {
+        return (char *)slot + 16;
+    }
+
+    static uint32_t RoundUpPow2(uint32_t v, uint32_t min)
+    {
+        uint32_t n = min;
+        while (n < v)
+            n <<= 1;
+        return n;
+    }
+
+    ShmLogRing::Slot *ShmLogRing::slot(uint64_t pos) const
+    {
+        return (Slot *)((char *)m_addr + s_shm_header_size + (pos & (m_header->slotCount - 1)) * m_header->slotSize);
+    }
+
+    ShmLogRing::ptr ShmLogRing::Create(const std::string &name, uint32_t slot_size, uint32_t slot_count)
+    {
+        slot_size = RoundUpPow2(slot_size, 64);
+        slot_count = RoundUpPow2(slot_count, 16);
+        size_t size = s_shm_header_size + (size_t)slot_size * slot_count;
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            std::cout << "[ERROR] ShmLogRing::Create shm_open " << name << " error: " << strerror(errno) << std::endl;
+            return nullptr;
+        }
+        // 收集者持有文件锁直到退出，保证同一个环只有一个读者
+        if (flock(fd, LOCK_EX | LOCK_NB) < 0)
+        {
+            std::cout << "[ERROR] ShmLogRing::Create " << name << " already has a collector" << std::endl;
+            close(fd);
+            return nullptr;
+        }
+
+        struct stat st;
+        bool reuse = false;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size == size)
+        {
+            void *addr = mmap(nullptr, s_shm_header_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                Header *header = (Header *)addr;
+                reuse = header->magic.load(std::memory_order_acquire) == s_shm_magic && header->version == s_shm_version &&
+                        header->slotSize == slot_size && header->slotCount == slot_count;
+                munmap(addr, s_shm_header_size);
+            }
+        }
+        if (!reuse && st.st_size != 0)
+        {
+            // 规格不同的旧段：换一个新对象，仍映射着旧段的写者不会因文件被截断而SIGBUS
+            shm_unlink(name.c_str());
+            close(fd);
+            fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (fd < 0 || flock(fd, LOCK_EX | LOCK_NB) < 0)
+            {
+                std::cout << "[ERROR] ShmLogRing::Create recreate " << name << " error: " << strerror(errno) << std::endl;
+                if (fd >= 0)
+                    close(fd);
+                return nullptr;
+            }
+        }
+        if (!reuse && ftruncate(fd, size) < 0)
+        {
+            std::cout << "[ERROR] ShmLogRing::Create ftruncate " << name << " error: " << strerror(errno) << std::endl;
+            close(fd);
+            return nullptr;
+        }
+
+        void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            std::cout << "[ERROR] ShmLogRing::Create mmap " << name << " error: " << strerror(errno) << std::endl;
+            close(fd);
+            return nullptr;
+        }
+        ptr ring(new ShmLogRing);
+        ring->m_name = name;
+        ring->m_fd = fd;
+        ring->m_addr = addr;
+        ring->m_size = size;
+        ring->m_header = (Header *)addr;
+        if (!reuse)
+        {
+            Header *header = ring->m_header;
+            header->version = s_shm_version;
+            header->slotSize = slot_size;
+            header->slotCount = slot_count;
+            header->writePos.store(0, std::memory_order_relaxed);
+            header->readPos.store(0, std::memory_order_relaxed);
+            header->written.store(0, std::memory_order_relaxed);
+            header->skipped.store(0, std::memory_order_relaxed);
+            header->corrupt.store(0, std::memory_order_relaxed);
+            header->dropped.store(0, std::memory_order_relaxed);
+            for (uint32_t i = 0; i < slot_count; i++)
+            {
+                ring->slot(i)->seq.store(i, std::memory_order_relaxed);
+            }
+            header->magic.store(s_shm_magic, std::memory_order_release);
+        }
+        return ring;
+    }
+
+    ShmLogRing::ptr ShmLogRing::Open(const std::string &name)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (fd < 0)
+            return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size <= s_shm_header_size)
+        {
+            close(fd);
+            return nullptr;
+        }
+        void *addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            return nullptr;
+        }
+        Header *header = (Header *)addr;
+        if (header->magic.load(std::memory_order_acquire) != s_shm_magic || header->version != s_shm_version ||
+            (size_t)st.st_size != s_shm_header_size + (size_t)header->slotSize * header->slotCount)
+        {
+            munmap(addr, st.st_size);
+            close(fd);
+            return nullptr;
+        }
+        ptr ring(new ShmLogRing);
+        ring->m_name = name;
+        ring->m_fd = fd; // 写者保留fd，用于检查段是否已被删除
+        ring->m_addr = addr;
+        ring->m_size = st.st_size;
+        ring->m_header = header;
+        return ring;
+    }
+
+    void ShmLogRing::Unlink(const std::string &name)
+    {
+        shm_unlink(name.c_str());
+    }
+
+    bool ShmLogRing::isOrphaned() const
+    {
+        struct stat st;
+        return fstat(m_fd, &st) < 0 || st.st_nlink == 0;
+    }
+
+    ShmLogRing::~ShmLogRing()
+    {
+        if (m_addr)
+            munmap(m_addr, m_size);
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+
+    bool ShmLogRing::write(const char *data, size_t len)
+    {
+        const uint32_t count = m_header->slotCount;
+        const size_t payload = m_header->slotSize - sizeof(Slot);
+        len = std::min(len, payload * (count / 4));
+        uint32_t n = std::max<size_t>(1, (len + payload - 1) / payload);
+
+        // 占用[pos, pos + n)：这些槽的序号都等于各自的位置时才能推进写位置
+        uint64_t pos = m_header->writePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            bool stale = false;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                int64_t diff = (int64_t)(slot(pos + i)->seq.load(std::memory_order_acquire) - (pos + i));
+                if (diff < 0)
+                {
+                    m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false; // 上一圈的记录还没被读出，环满
+                }
+                if (diff > 0)
+                {
+                    stale = true; // 已被其他写者占用，写位置已经过时
+                    break;
+                }
+            }
+            if (stale)
+            {
+                pos = m_header->writePos.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (m_header->writePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                break;
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            Slot *s = slot(pos + i);
+            size_t off = i * payload;
+            size_t part = std::min(payload, len - off);
+            s->len = i == 0 ? (uint32_t)len : s_continuation;
+            s->checksum = i == 0 ? (uint32_t)Hash64(data, len) : 0;
+            memcpy(SlotData(s), data + off, part);
+        }
+        // 从后往前提交，首槽提交时整条记录都已可见；被收集者跳过的槽CAS失败
+        bool ok = true;
+        for (uint32_t i = n; i-- > 0;)
+        {
+            uint64_t expected = pos + i;
+            if (!slot(pos + i)->seq.compare_exchange_strong(expected, pos + i + 1, std::memory_order_release, std::memory_order_relaxed))
+                ok = false;
+        }
+        return ok;
+    }
+
+    size_t ShmLogRing::read(std::string &out, uint64_t stuck_timeout_ns, size_t max)
+    {
+        const uint32_t count = m_header->slotCount;
+        const size_t payload = m_header->slotSize - sizeof(Slot);
+        uint64_t pos = m_header->readPos.load(std::memory_order_relaxed);
+        size_t records = 0;
+
+        // 归还槽给下一圈的写者并立即保存读位置，收集者中途退出后重启不会重读或卡在已归还的槽上
+        auto release = [&](uint64_t p) {
+            slot(p)->seq.store(p + count, std::memory_order_release);
+            pos = p + 1;
+            m_header->readPos.store(pos, std::memory_order_relaxed);
+        };
+        // 槽已被占用但未提交：超时后跳过，返回是否跳过。
+        // 开始等待时记下写位置，在此之前占用的槽都已等满超时时间，之后仍未提交的直接跳过，
+        // 崩溃的写者占用的多个槽只需等待一次
+        auto skipStuck = [&](uint64_t p) {
+            uint64_t now = Clock::MonotonicNS();
+            if (m_stuckPos == UINT64_MAX || p < m_stuckPos || p >= m_stuckEnd)
+            {
+                m_stuckPos = p;
+                m_stuckEnd = m_header->writePos.load(std::memory_order_acquire);
+                m_stuckSince = now;
+                return false;
+            }
+            if (now - m_stuckSince < stuck_timeout_ns)
+                return false;
+            uint64_t expected = p;
+            if (!slot(p)->seq.compare_exchange_strong(expected, p + count, std::memory_order_acq_rel))
+                return false; // 写者恰好提交了，下一轮正常读出
+            m_header->skipped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        };
+
+        while (records < max)
+        {
+            Slot *head = slot(pos);
+            uint64_t seq = head->seq.load(std::memory_order_acquire);
+            if ((int64_t)(seq - (pos + count)) >= 0)
+            {
+                // 已经归还过（等待续槽时跳过，或者上一个收集者归还后没来得及保存读位置），可能已被下一圈的写者占用
+                m_header->readPos.store(++pos, std::memory_order_relaxed);
+                continue;
+            }
+            if (seq != pos + 1)
+            {
+                if (m_header->writePos.load(std::memory_order_acquire) <= pos)
+                    break; // 环已读空
+                if (!skipStuck(pos))
+                    break;
+                m_header->readPos.store(++pos, std::memory_order_relaxed);
+                continue;
+            }
+            if (head->len == s_continuation)
+            {
+                // 首槽被跳过的记录留下的续槽
+                release(pos);
+                continue;
+            }
+
+            uint32_t len = head->len;
+            uint32_t n = std::max<size_t>(1, (len + payload - 1) / payload);
+            if (len > payload * (count / 4))
+            {
+                m_header->corrupt.fetch_add(1, std::memory_order_relaxed);
+                release(pos);
+                continue;
+            }
+            uint32_t ready = 1;
+            while (ready < n && slot(pos + ready)->seq.load(std::memory_order_acquire) == pos + ready + 1 &&
+                   slot(pos + ready)->len == s_continuation)
+            {
+                ++ready;
+            }
+            if (ready < n)
+            {
+                // 续槽还没提交，多半是写者正在复制；超时后丢弃整条记录
+                if (slot(pos + ready)->seq.load(std::memory_order_acquire) == pos + ready && !skipStuck(pos + ready))
+                    break;
+                m_header->corrupt.fetch_add(1, std::memory_order_relaxed);
+                for (uint64_t end = pos + ready; pos < end;)
+                {
+                    release(pos);
+                }
+                continue;
+            }
+
+            size_t old = out.size();
+            out.resize(old + len);
+            for (uint32_t i = 0; i < n; i++)
+            {
+                size_t off = i * payload;
+                memcpy(&out[old + off], SlotData(slot(pos + i)), std::min(payload, len - off));
+            }
+            if ((uint32_t)Hash64(&out[old], len) != head->checksum)
+            {
+                out.resize(old);
+                m_header->corrupt.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                ++records;
+                m_header->written.fetch_add(1, std::memory_order_relaxed);
+            }
+            for (uint64_t end = pos + n; pos < end;)
+            {
+                release(pos);
+            }
+            m_stuckPos = UINT64_MAX;
+        }
+        return records;
+    }
+
+    ShmLogRing::Stats ShmLogRing::getStats() const
+    {
+        Stats stats;
+        stats.written = m_header->written.load(std::memory_order_relaxed);
+        stats.dropped = m_header->dropped.load(std::memory_order_relaxed);
+        stats.skipped = m_header->skipped.load(std::memory_order_relaxed);
+        stats.corrupt = m_header->corrupt.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    ShmLogAppender::ShmLogAppender(const std::string &name)
+        : LogAppender(LogFormatter::ptr(new LogFormatter)), m_name(name)
+    {
+        m_ring = ShmLogRing::Open(m_name);
+        m_lastTry.store(GetElapsedMS(), std::memory_order_relaxed);
+    }
+
+    ShmLogRing::ptr ShmLogAppender::getRing()
+    {
+        // 每秒最多一次：环还没打开时尝试打开，已打开时检查段是否已被删除，是则改开收集者新建的段
+        uint64_t now = GetElapsedMS();
+        uint64_t last = m_lastTry.load(std::memory_order_relaxed);
+        if (now - last >= 1000 && m_lastTry.compare_exchange_strong(last, now, std::memory_order_relaxed))
+        {
+            ShmLogRing::ptr ring;
+            {
+                MutexType::Lock lock(m_mutex);
+                ring = m_ring;
+            }
+            if (!ring || ring->isOrphaned())
+            {
+                ring = ShmLogRing::Open(m_name);
+                MutexType::Lock lock(m_mutex);
+                m_ring = ring;
+            }
+            return ring;
+        }
+        MutexType::Lock lock(m_mutex);
+        return m_ring;
+    }
+
+    void ShmLogAppender::log(LogEvent::ptr event)
+    {
+        if (!getRing())
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::string str = getFormatter()->format(event);
+        logFormatted(event, str.data(), str.size());
+    }
+
+    void ShmLogAppender::logFormatted(LogEvent::ptr /*event*/, const char *data, size_t len)
+    {
+        ShmLogRing::ptr ring = getRing();
+        if (!ring || !ring->write(data, len))
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string ShmLogAppender::toYamlString()
+    {
+        MutexType::Lock lock(m_mutex);
+        YAML::Node node;
+        node["type"] = "ShmLogAppender";
+        node["name"] = m_name;
+        node["pattern"] = m_formatter ? m_formatter->getPattern() : m_defaultformatter->getPattern();
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+
+    ShmLogCollector::ShmLogCollector(const std::string &name, const std::string &file, uint32_t slot_size,
+                                     uint32_t slot_count, uint32_t stuck_timeout_ms)
+        : m_name(name), m_filename(file), m_slotSize(slot_size), m_slotCount(slot_count),
+          m_stuckTimeoutNS(stuck_timeout_ms * 1000000ull)
+    {
+    }
+
+    ShmLogCollector::~ShmLogCollector()
+    {
+        stop();
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+
+    bool ShmLogCollector::init()
+    {
+        if (!m_ring)
+        {
+            m_ring = ShmLogRing::Create(m_name, m_slotSize, m_slotCount);
+            if (!m_ring)
+                return false;
+        }
+        if (m_fd < 0)
+        {
+            m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (m_fd < 0)
+            {
+                std::cout << "[ERROR] ShmLogCollector open " << m_filename << " error: " << strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ShmLogCollector::start()
+    {
+        if (m_running || !init())
+            return false;
+        m_running = true;
+        m_thread = std::thread([this]() {
+            SetThreadName("shm_collector");
+            ThreadRegistry::Register("shm_collector");
+            while (m_running.load(std::memory_order_relaxed))
+            {
+                // 空闲时短暂休眠，写者不需要唤醒收集者，写入路径上没有系统调用
+                if (drain() == 0)
+                    usleep(1000);
+            }
+        });
+        return true;
+    }
+
+    void ShmLogCollector::stop()
+    {
+        if (!m_running)
+            return;
+        m_running = false;
+        if (m_thread.joinable())
+            m_thread.join();
+        while (drain() > 0)
+        {
+        }
+    }
+
+    size_t ShmLogCollector::drain()
+    {
+        if (!init())
+            return 0;
+        m_buf.clear();
+        size_t n = m_ring->read(m_buf, m_stuckTimeoutNS, 4096);
+        const char *ptr = m_buf.data();
+        size_t left = m_buf.size();
+        while (left > 0)
+        {
+            ssize_t w = ::write(m_fd, ptr, left);
+            if (w < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                std::cout << "[ERROR] ShmLogCollector write " << m_filename << " error: " << strerror(errno) << std::endl;
+                break;
+            }
+            ptr += w;
+            left -= w;
+        }
+        return n;
+    }
+
+    ShmLogRing::Stats ShmLogCollector::getStats() const
+    {
+        return m_ring ? m_ring->getStats() : ShmLogRing::Stats();
+    }
+
+    std::string ShmLogCollector::toYamlString() const
+    {
+        ShmLogRing::Stats stats = getStats();
+        YAML::Node node;
+        node["name"] = m_name;
+        node["file"] = m_filename;
+        node["slot_size"] = m_slotSize;
+        node["slot_count"] = m_slotCount;
+        node["written"] = stats.written;
+        node["dropped"] = stats.dropped;
+        node["skipped"] = stats.skipped;
+        node["corrupt"] = stats.corrupt;
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+}
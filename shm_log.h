@@ -0,0 +1,193 @@
+#ifndef SHM_LOG_H
+#define SHM_LOG_H
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include "log.h"
+
+namespace MyServer
+{
+    /**
+     * @brief 共享内存日志环，多个进程写入，一个收集进程读出
+     * @details 段位于/dev/shm（shm_open），由ShmLogCollector创建，布局为一个段头加slotCount个固定大小的槽。
+     *          写入采用Vyukov的有界队列算法：每个槽带一个序号，写者CAS推进写位置占得连续若干个槽，
+     *          复制数据后逐槽提交序号，全程没有系统调用和锁；环满时丢弃并计数，不阻塞写者。
+     *          每条记录带校验和，写者在复制途中崩溃留下的槽会卡住读位置，
+     *          收集者在等待超过超时时间后跳过该槽，以及开始等待前已被占用、仍未提交的后续槽（崩溃的写者占用的其余槽），
+     *          被跳过后才提交的写者提交失败，其数据被丢弃。读位置保存在段头中，每归还一个槽更新一次，收集者重启后从这里继续
+     */
+    class ShmLogRing
+    {
+    public:
+        typedef std::shared_ptr<ShmLogRing> ptr;
+
+        /**
+         * @brief 统计信息
+         */
+        struct Stats
+        {
+            uint64_t written = 0; // 收集者已读出的记录数
+            uint64_t dropped = 0; // 写者因环满丢弃的记录数
+            uint64_t skipped = 0; // 收集者因写者卡住跳过的槽数
+            uint64_t corrupt = 0; // 校验失败或不完整的记录数
+        };
+
+        /**
+         * @brief 创建或打开已有的段，供收集者使用
+         * @details 段已存在且槽的规格相同时沿用，其中未读出的记录不会丢失；否则重新初始化
+         * @param[in] name 段名称，如"/myserver_log"
+         * @param[in] slot_size 槽大小，向上取整到2的幂，至少64
+         * @param[in] slot_count 槽个数，向上取整到2的幂
+         * @return 失败返回nullptr
+         */
+        static ptr Create(const std::string &name, uint32_t slot_size = 256, uint32_t slot_count = 65536);
+
+        /**
+         * @brief 打开已初始化的段，供写者使用
+         * @return 段不存在或未初始化时返回nullptr
+         */
+        static ptr Open(const std::string &name);
+
+        /**
+         * @brief 删除段，已经映射的进程不受影响
+         */
+        static void Unlink(const std::string &name);
+
+        /**
+         * @brief 段是否已被删除（收集者以不同规格重建了段，或者段被Unlink），此后写入的记录不会被读出
+         * @details 需要一次fstat系统调用，不要在每次写入时调用
+         */
+        bool isOrphaned() const;
+
+        ~ShmLogRing();
+
+        /**
+         * @brief 写入一条记录，多个进程、线程可以并发调用
+         * @details 超过环容量1/4的数据被截断
+         * @return 环满或被收集者跳过时返回false
+         */
+        bool write(const char *data, size_t len);
+
+        /**
+         * @brief 读出已提交的记录，按写入顺序追加到out，只能由一个收集者调用
+         * @param[in] stuck_timeout_ns 已被占用但未提交的槽等待多久后跳过
+         * @param[in] max 最多读出的记录数
+         * @return 读出的记录数
+         */
+        size_t read(std::string &out, uint64_t stuck_timeout_ns, size_t max = SIZE_MAX);
+
+        Stats getStats() const;
+
+        const std::string &getName() const { return m_name; }
+
+    private:
+        struct Header;
+        struct Slot;
+
+        ShmLogRing() {}
+
+        Slot *slot(uint64_t pos) const;
+
+    private:
+        std::string m_name;
+        int m_fd = -1;
+        void *m_addr = nullptr;
+        size_t m_size = 0;
+        Header *m_header = nullptr;
+        uint64_t m_stuckPos = UINT64_MAX; // 收集者：开始等待时卡住的位置
+        uint64_t m_stuckEnd = 0;          // 收集者：开始等待时的写位置，此前占用的槽超时后一并跳过
+        uint64_t m_stuckSince = 0;        // 收集者：开始等待的时间
+    };
+
+    /**
+     * @brief 写入共享内存日志环的Appender
+     * @details 日志在本进程格式化后写入环，不经过文件系统；收集进程尚未创建环时丢弃日志，
+     *          并在之后的写入中每秒最多尝试打开一次。已打开的环同样每秒最多检查一次是否已被删除，
+     *          收集者重建段后改写新的段
+     */
+    class ShmLogAppender : public LogAppender
+    {
+    public:
+        typedef std::shared_ptr<ShmLogAppender> ptr;
+
+        ShmLogAppender(const std::string &name);
+
+        void log(LogEvent::ptr event);
+        void logFormatted(LogEvent::ptr event, const char *data, size_t len) override;
+        bool usesFormatter() const override { return true; }
+        std::string toYamlString();
+
+        /**
+         * @brief 本进程因环满或环不存在丢弃的日志条数
+         */
+        uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        ShmLogRing::ptr getRing();
+
+    private:
+        std::string m_name;
+        ShmLogRing::ptr m_ring;             // 由m_mutex保护
+        std::atomic<uint64_t> m_lastTry{0}; // 上一次尝试打开或检查环的时间（毫秒）
+        std::atomic<uint64_t> m_dropped{0};
+    };
+
+    /**
+     * @brief 共享内存日志收集者
+     * @details 创建日志环，后台线程把其中的记录按写入顺序追加到文件。同一个环只能有一个收集者
+     */
+    class ShmLogCollector
+    {
+    public:
+        typedef std::shared_ptr<ShmLogCollector> ptr;
+
+        /**
+         * @param[in] name 段名称
+         * @param[in] file 输出文件
+         * @param[in] slot_size,slot_count 见ShmLogRing::Create
+         * @param[in] stuck_timeout_ms 写者卡住多久后跳过其占用的槽
+         */
+        ShmLogCollector(const std::string &name, const std::string &file, uint32_t slot_size = 256,
+                        uint32_t slot_count = 65536, uint32_t stuck_timeout_ms = 200);
+        ~ShmLogCollector();
+
+        /**
+         * @brief 创建环、打开文件并启动后台线程
+         */
+        bool start();
+
+        /**
+         * @brief 读出剩余记录后停止后台线程
+         */
+        void stop();
+
+        /**
+         * @brief 读出一批记录写入文件，后台线程循环调用，也可以在未start时手动调用
+         * @return 写入的记录数
+         */
+        size_t drain();
+
+        ShmLogRing::Stats getStats() const;
+        std::string toYamlString() const;
+
+    private:
+        bool init();
+
+    private:
+        std::string m_name;
+        std::string m_filename;
+        uint32_t m_slotSize;
+        uint32_t m_slotCount;
+        uint64_t m_stuckTimeoutNS;
+        ShmLogRing::ptr m_ring;
+        int m_fd = -1;
+        std::string m_buf;
+        std::thread m_thread;
+        std::atomic<bool> m_running{false};
+    };
+}
+
+#endif
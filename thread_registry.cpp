@@ -0,0 +1,251 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <yaml-cpp/yaml.h>
+#include "thread_registry.h"
+#include "util.h"
+#include "clock.h"
+
+namespace MyServer
+{
+    namespace
+    {
+        struct Sample
+        {
+            uint64_t time = 0; // 采集时的单调时间
+            uint64_t cpuNS = 0;
+            uint64_t waitNS = 0;
+        };
+
+        struct RegistryState
+        {
+            std::mutex mutex;
+            std::map<pid_t, ThreadRegistry::ThreadInfo> threads;
+            std::unordered_map<pid_t, Sample> last; // 上一次Collect的结果
+        };
+
+        static RegistryState &GetState()
+        {
+            static RegistryState *s_state = new RegistryState; // 线程可能在静态对象析构后才退出，不析构
+            return *s_state;
+        }
+
+        /**
+         * @brief 线程退出时自动注销
+         */
+        struct RegistryGuard
+        {
+            bool registered = false;
+
+            ~RegistryGuard()
+            {
+                if (registered)
+                    ThreadRegistry::Unregister();
+            }
+        };
+
+        static thread_local RegistryGuard t_guard;
+
+        /**
+         * @brief 读取/proc下的小文件，不经过流缓冲
+         * @return 读到的长度，失败返回-1
+         */
+        static ssize_t ReadProcFile(const char *path, char *buf, size_t size)
+        {
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return -1;
+            ssize_t n = read(fd, buf, size - 1);
+            close(fd);
+            if (n >= 0)
+                buf[n] = '\0';
+            return n;
+        }
+
+        static uint64_t FindField(const char *buf, const char *key)
+        {
+            const char *p = strstr(buf, key);
+            return p ? strtoull(p + strlen(key), nullptr, 10) : 0;
+        }
+
+        /**
+         * @brief 读取线程当前的名称，失败时name不变
+         */
+        static void ReadThreadName(pid_t tid, std::string &name)
+        {
+            char path[64];
+            char buf[32];
+            snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+            ssize_t n = ReadProcFile(path, buf, sizeof(buf));
+            if (n <= 0)
+                return;
+            if (buf[n - 1] == '\n')
+                buf[--n] = '\0';
+            name.assign(buf, n);
+        }
+
+        /**
+         * @brief 按线程id读取线程的CPU时间
+         * @details 与pthread_getcpuclockid得到的时钟相同（内核的MAKE_THREAD_CPUCLOCK(tid, CPUCLOCK_SCHED)），
+         *          但不需要pthread_t，线程已退出时clock_gettime返回EINVAL，不会访问已释放的线程
+         */
+        static uint64_t ReadThreadCpuNS(pid_t tid)
+        {
+            clockid_t cid = (~(clockid_t)tid << 3) | 6;
+            struct timespec ts;
+            if (clock_gettime(cid, &ts) != 0)
+                return 0;
+            return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        }
+
+        /**
+         * @brief 读取线程的上下文切换次数和调度统计
+         */
+        static void ReadSchedStats(ThreadRegistry::ThreadStats &stats)
+        {
+            char path[64];
+            char buf[2048];
+            snprintf(path, sizeof(path), "/proc/self/task/%d/status", stats.tid);
+            if (ReadProcFile(path, buf, sizeof(buf)) > 0)
+            {
+                // "nonvoluntary_ctxt_switches"包含"voluntary_ctxt_switches"，要带上行首的换行符匹配
+                stats.voluntarySwitches = FindField(buf, "\nvoluntary_ctxt_switches:");
+                stats.involuntarySwitches = FindField(buf, "\nnonvoluntary_ctxt_switches:");
+            }
+            snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", stats.tid);
+            if (ReadProcFile(path, buf, sizeof(buf)) > 0)
+            {
+                // 三个字段：在CPU上运行的时间、在运行队列上等待的时间、运行次数
+                char *end;
+                strtoull(buf, &end, 10);
+                stats.waitNS = strtoull(end, &end, 10);
+                stats.timeslices = strtoull(end, &end, 10);
+            }
+        }
+    }
+
+    void ThreadRegistry::Register(const std::string &role)
+    {
+        RegistryState &st = GetState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        ThreadInfo &info = st.threads[GetThreadId()];
+        info.tid = GetThreadId();
+        info.name = GetThreadName();
+        info.role = role;
+        info.thread = pthread_self();
+        t_guard.registered = true;
+    }
+
+    void ThreadRegistry::Unregister()
+    {
+        RegistryState &st = GetState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.threads.erase(GetThreadId());
+        st.last.erase(GetThreadId());
+        t_guard.registered = false;
+    }
+
+    std::vector<ThreadRegistry::ThreadInfo> ThreadRegistry::List()
+    {
+        RegistryState &st = GetState();
+        std::vector<ThreadInfo> infos;
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            for (auto &i : st.threads)
+                infos.push_back(i.second);
+        }
+        // 在锁外按线程id读取名称，不阻塞线程登记和注销
+        for (auto &i : infos)
+            ReadThreadName(i.tid, i.name);
+        return infos;
+    }
+
+    std::vector<ThreadRegistry::ThreadStats> ThreadRegistry::Collect()
+    {
+        // 锁内只复制登记表，读/proc在锁外进行，期间线程可以正常登记和注销；
+        // 锁外只按线程id访问，线程已退出时读取失败，统计为0
+        std::vector<ThreadInfo> infos = List();
+        std::vector<ThreadStats> result;
+        result.reserve(infos.size());
+        for (auto &i : infos)
+        {
+            ThreadStats stats;
+            stats.tid = i.tid;
+            stats.name = i.name;
+            stats.role = i.role;
+            stats.cpuNS = ReadThreadCpuNS(i.tid);
+            ReadSchedStats(stats);
+            result.push_back(stats);
+        }
+
+        RegistryState &st = GetState();
+        uint64_t now = Clock::MonotonicNS(Clock::PRECISE);
+        std::lock_guard<std::mutex> lock(st.mutex);
+        for (auto &stats : result)
+        {
+            // 采集期间已注销的线程不再记录上一次的结果
+            if (st.threads.find(stats.tid) == st.threads.end())
+                continue;
+            Sample &last = st.last[stats.tid];
+            if (last.time && now > last.time)
+            {
+                double elapsed = now - last.time;
+                stats.cpuUsage = (stats.cpuNS - last.cpuNS) / elapsed;
+                stats.waitRatio = (stats.waitNS - last.waitNS) / elapsed;
+            }
+            last.time = now;
+            last.cpuNS = stats.cpuNS;
+            last.waitNS = stats.waitNS;
+        }
+        return result;
+    }
+
+    std::string ThreadRegistry::ToYamlString()
+    {
+        std::vector<ThreadStats> stats = Collect();
+        YAML::Node node;
+        std::map<std::string, YAML::Node> roles;
+        for (auto &i : stats)
+        {
+            YAML::Node n;
+            n["tid"] = i.tid;
+            n["name"] = i.name;
+            n["role"] = i.role;
+            n["cpu_ns"] = i.cpuNS;
+            n["wait_ns"] = i.waitNS;
+            n["timeslices"] = i.timeslices;
+            n["voluntary_switches"] = i.voluntarySwitches;
+            n["involuntary_switches"] = i.involuntarySwitches;
+            if (i.cpuUsage >= 0)
+            {
+                n["cpu_usage"] = i.cpuUsage;
+                n["wait_ratio"] = i.waitRatio;
+            }
+            node["threads"].push_back(n);
+
+            // 按角色汇总：使用率和等待比例相加，除以线程数即为池内平均值
+            YAML::Node &r = roles[i.role];
+            r["threads"] = r["threads"].as<int>(0) + 1;
+            r["cpu_ns"] = r["cpu_ns"].as<uint64_t>(0) + i.cpuNS;
+            r["involuntary_switches"] = r["involuntary_switches"].as<uint64_t>(0) + i.involuntarySwitches;
+            if (i.cpuUsage >= 0)
+            {
+                r["cpu_usage"] = r["cpu_usage"].as<double>(0) + i.cpuUsage;
+                r["wait_ratio"] = r["wait_ratio"].as<double>(0) + i.waitRatio;
+            }
+        }
+        for (auto &i : roles)
+        {
+            node["roles"][i.first] = i.second;
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef THREAD_REGISTRY_H
+#define THREAD_REGISTRY_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+namespace MyServer
+{
+    /**
+     * @brief 框架线程登记表
+     * @details 线程启动后调用Register登记自己的角色（如"worker"、"io"、"timer"），线程退出时自动注销。
+     *          Collect按需读取每个线程的CPU时间（线程CPU时钟）、
+     *          主动/被动上下文切换次数（/proc/self/task/<tid>/status）和在运行队列上等待的时间（/proc/self/task/<tid>/schedstat），
+     *          并与上一次Collect比较得出区间内的CPU使用率和等待比例；每个线程只读几个小文件，可以每秒轮询。
+     *          读取在登记表的锁外进行，采集期间线程的登记和注销不被阻塞。
+     *          框架自己的线程已按角色登记：worker（CopyTree等使用的工作线程池）、log_watcher、log_dedup、
+     *          tsc_resync、profiler、shm_collector
+     */
+    class ThreadRegistry
+    {
+    public:
+        /**
+         * @brief 登记信息
+         */
+        struct ThreadInfo
+        {
+            pid_t tid = 0;
+            std::string name;
+            std::string role;
+            pthread_t thread;
+        };
+
+        /**
+         * @brief 线程统计
+         */
+        struct ThreadStats
+        {
+            pid_t tid = 0;
+            std::string name;
+            std::string role;
+            // 累计CPU时间
+            uint64_t cpuNS = 0;
+            // 累计在运行队列上等待的时间，内核不支持schedstat时为0
+            uint64_t waitNS = 0;
+            // 累计被调度运行的次数
+            uint64_t timeslices = 0;
+            // 主动让出CPU的次数，如等待锁、IO
+            uint64_t voluntarySwitches = 0;
+            // 被抢占的次数，持续偏高说明CPU不够用
+            uint64_t involuntarySwitches = 0;
+            // 与上一次Collect之间的CPU使用率，1表示占满一个核；首次采集时为-1
+            double cpuUsage = -1;
+            // 与上一次Collect之间在运行队列上等待的时间比例；首次采集时为-1
+            double waitRatio = -1;
+        };
+
+        /**
+         * @brief 登记当前线程，重复调用时更新角色
+         * @param[in] role 线程角色，用于按线程池汇总
+         */
+        static void Register(const std::string &role);
+
+        /**
+         * @brief 注销当前线程，线程退出时会自动注销
+         */
+        static void Unregister();
+
+        /**
+         * @brief 列出已登记的线程，线程名为当前名称
+         */
+        static std::vector<ThreadInfo> List();
+
+        /**
+         * @brief 采集所有已登记线程的统计
+         */
+        static std::vector<ThreadStats> Collect();
+
+        /**
+         * @brief 采集统计并按角色汇总，转为yaml string
+         */
+        static std::string ToYamlString();
+    };
+}
+
+#endif
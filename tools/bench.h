@@ -0,0 +1,60 @@
+#ifndef TOOLS_BENCH_H
+#define TOOLS_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include "../clock.h"
+
+/*
+@brief tools下基准测试程序共用的计时和输出函数
+*/
+namespace bench
+{
+    /*
+    @brief 阻止编译器把v的计算当作无用代码优化掉
+    */
+    template <class T>
+    inline void DoNotOptimize(const T &v)
+    {
+        asm volatile("" : : "g"(&v) : "memory");
+    }
+
+    inline uint64_t NowNS()
+    {
+        return MyServer::Clock::MonotonicNS(MyServer::Clock::PRECISE);
+    }
+
+    /*
+    @brief 反复调用fn，每轮次数翻倍，直到一轮运行时间不少于min_ns
+    @return 最后一轮每次调用的平均纳秒数
+    */
+    template <class F>
+    double Measure(F &&fn, uint64_t min_ns = 200000000ull)
+    {
+        fn(); // 预热
+        for (uint64_t iters = 1;; iters *= 2)
+        {
+            uint64_t start = NowNS();
+            for (uint64_t i = 0; i < iters; ++i)
+                fn();
+            uint64_t elapsed = NowNS() - start;
+            if (elapsed >= min_ns)
+                return (double)elapsed / iters;
+        }
+    }
+
+    /*
+    @brief 输出一行结果，bytes为每次调用处理的字节数，非0时同时输出吞吐量
+    */
+    inline void Report(const std::string &name, double ns, size_t bytes = 0)
+    {
+        if (bytes)
+            printf("%-44s %12.1f ns/op %10.1f MB/s\n", name.c_str(), ns, bytes * 1000.0 / ns);
+        else
+            printf("%-44s %12.1f ns/op\n", name.c_str(), ns);
+        fflush(stdout);
+    }
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include <time.h>
+#include <sys/time.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include "bench.h"
+#include "../clock.h"
+
+/*
+@brief Clock各模式单次取时的开销
+@details 用法：bench_clock [线程数] [检查秒数]
+  先测量单线程下PRECISE/COARSE/TSC三种模式和time/gettimeofday/std::chrono的单次耗时，
+  再用多个线程同时按TSC模式取时（跨过多次后台对齐），检查每个线程内的时间不回退
+*/
+
+using namespace MyServer;
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    printf("tsc available: %s\n", Clock::TscAvailable() ? "yes" : "no");
+
+    printf("== single thread ==\n");
+    bench::Report("time(nullptr)", bench::Measure([]() {
+                      time_t t = time(nullptr);
+                      bench::DoNotOptimize(t);
+                  }));
+    bench::Report("gettimeofday", bench::Measure([]() {
+                      struct timeval tv;
+                      gettimeofday(&tv, nullptr);
+                      bench::DoNotOptimize(tv);
+                  }));
+    bench::Report("std::chrono::steady_clock::now", bench::Measure([]() {
+                      auto t = std::chrono::steady_clock::now();
+                      bench::DoNotOptimize(t);
+                  }));
+    for (Clock::Mode mode : {Clock::PRECISE, Clock::COARSE, Clock::TSC})
+    {
+        bench::Report(std::string("Clock::NowNS(") + Clock::ModeToString(mode) + ")", bench::Measure([mode]() {
+                          uint64_t t = Clock::NowNS(mode);
+                          bench::DoNotOptimize(t);
+                      }));
+        bench::Report(std::string("Clock::MonotonicNS(") + Clock::ModeToString(mode) + ")", bench::Measure([mode]() {
+                          uint64_t t = Clock::MonotonicNS(mode);
+                          bench::DoNotOptimize(t);
+                      }));
+    }
+
+    printf("== %d threads, TSC, %d s ==\n", threads, seconds);
+    std::atomic<uint64_t> calls{0}, backwards{0};
+    uint64_t deadline = Clock::MonotonicNS(Clock::PRECISE) + seconds * 1000000000ull;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            uint64_t n = 0, back = 0, last = 0;
+            while (true)
+            {
+                uint64_t now = Clock::MonotonicNS(Clock::TSC);
+                back += now < last;
+                last = now;
+                if ((++n & 1023) == 0 && Clock::MonotonicNS(Clock::PRECISE) >= deadline)
+                    break;
+            }
+            calls += n;
+            backwards += back;
+        });
+    }
+    for (auto &i : workers)
+        i.join();
+    printf("calls %lu, %.1f ns/call per thread, went backwards %lu times\n", (unsigned long)calls.load(),
+           seconds * 1e9 * threads / calls.load(), (unsigned long)backwards.load());
+    return backwards.load() == 0 ? 0 : 1;
+}
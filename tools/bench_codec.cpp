@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "../util.h"
+
+/*
+@brief base64、十六进制编解码和Crc32c的基准测试
+@details 用法：bench_codec
+  对64字节、1KB和64KB的随机数据，分别在打开和关闭SIMD时测量StringUtil的编码、解码和校验和的吞吐量，
+  并与常见的逐字节手写实现（逐字符push_back的base64、snprintf("%02x")、逐位计算的CRC32C）对比
+*/
+
+using namespace MyServer;
+
+static const char s_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static std::string NaiveBase64Encode(const std::string &data)
+{
+    std::string out;
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3)
+    {
+        uint32_t v = (uint8_t)data[i] << 16 | (uint8_t)data[i + 1] << 8 | (uint8_t)data[i + 2];
+        out.push_back(s_alphabet[v >> 18]);
+        out.push_back(s_alphabet[(v >> 12) & 0x3f]);
+        out.push_back(s_alphabet[(v >> 6) & 0x3f]);
+        out.push_back(s_alphabet[v & 0x3f]);
+    }
+    if (i < data.size())
+    {
+        uint32_t v = (uint8_t)data[i] << 16 | (i + 1 < data.size() ? (uint8_t)data[i + 1] << 8 : 0);
+        out.push_back(s_alphabet[v >> 18]);
+        out.push_back(s_alphabet[(v >> 12) & 0x3f]);
+        out.push_back(i + 1 < data.size() ? s_alphabet[(v >> 6) & 0x3f] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+static std::string NaiveBase64Decode(const std::string &str)
+{
+    std::string out;
+    uint32_t v = 0;
+    int bits = 0;
+    for (char c : str)
+    {
+        const char *p = strchr(s_alphabet, c);
+        if (c == '=' || !c || !p)
+            break;
+        v = v << 6 | (uint32_t)(p - s_alphabet);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back((char)(v >> bits));
+        }
+    }
+    return out;
+}
+
+static std::string NaiveHexEncode(const std::string &data)
+{
+    std::string out;
+    char buf[3];
+    for (unsigned char c : data)
+    {
+        snprintf(buf, sizeof(buf), "%02x", c);
+        out += buf;
+    }
+    return out;
+}
+
+static uint32_t NaiveCrc32c(const std::string &data)
+{
+    uint32_t crc = ~0u;
+    for (unsigned char c : data)
+    {
+        crc ^= c;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void Run(const std::string &data, const std::string &prefix, bool simd)
+{
+    StringUtil::SetSimdEnabled(simd);
+    std::string name = prefix + (simd ? " simd" : " scalar");
+    std::string b64 = StringUtil::Base64Encode(data);
+    std::string hex = StringUtil::HexEncode(data);
+    std::string out;
+    bench::Report(name + " Base64EncodeTo", bench::Measure([&]() {
+                      out.clear();
+                      StringUtil::Base64EncodeTo(out, data);
+                      bench::DoNotOptimize(out);
+                  }),
+                  data.size());
+    bench::Report(name + " Base64DecodeTo", bench::Measure([&]() {
+                      out.clear();
+                      bool ok = StringUtil::Base64DecodeTo(out, b64);
+                      bench::DoNotOptimize(ok);
+                  }),
+                  b64.size());
+    bench::Report(name + " HexEncodeTo", bench::Measure([&]() {
+                      out.clear();
+                      StringUtil::HexEncodeTo(out, data);
+                      bench::DoNotOptimize(out);
+                  }),
+                  data.size());
+    bench::Report(name + " HexDecodeTo", bench::Measure([&]() {
+                      out.clear();
+                      bool ok = StringUtil::HexDecodeTo(out, hex);
+                      bench::DoNotOptimize(ok);
+                  }),
+                  hex.size());
+    bench::Report(name + " Crc32c", bench::Measure([&]() {
+                      uint32_t crc = StringUtil::Crc32c(data);
+                      bench::DoNotOptimize(crc);
+                  }),
+                  data.size());
+}
+
+static void RunNaive(const std::string &data, const std::string &prefix)
+{
+    std::string name = prefix + " naive";
+    std::string b64 = NaiveBase64Encode(data);
+    bench::Report(name + " base64 encode", bench::Measure([&]() {
+                      std::string out = NaiveBase64Encode(data);
+                      bench::DoNotOptimize(out);
+                  }),
+                  data.size());
+    bench::Report(name + " base64 decode", bench::Measure([&]() {
+                      std::string out = NaiveBase64Decode(b64);
+                      bench::DoNotOptimize(out);
+                  }),
+                  b64.size());
+    bench::Report(name + " hex encode", bench::Measure([&]() {
+                      std::string out = NaiveHexEncode(data);
+                      bench::DoNotOptimize(out);
+                  }),
+                  data.size());
+    bench::Report(name + " crc32c bitwise", bench::Measure([&]() {
+                      uint32_t crc = NaiveCrc32c(data);
+                      bench::DoNotOptimize(crc);
+                  }),
+                  data.size());
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    int ret = 0;
+    for (size_t size : {64, 1024, 65536})
+    {
+        std::string data(size, '\0');
+        for (auto &c : data)
+            c = (char)rng();
+        std::string prefix = std::to_string(size) + "B";
+        printf("== %zu bytes ==\n", size);
+        // 对照实现的结果应与StringUtil一致
+        if (NaiveBase64Encode(data) != StringUtil::Base64Encode(data) ||
+            NaiveBase64Decode(NaiveBase64Encode(data)) != data || NaiveHexEncode(data) != StringUtil::HexEncode(data) ||
+            NaiveCrc32c(data) != StringUtil::Crc32c(data))
+        {
+            printf("[FAIL] naive implementation differs from StringUtil\n");
+            ret = 1;
+        }
+        RunNaive(data, prefix);
+        Run(data, prefix, false);
+        Run(data, prefix, true);
+    }
+    return ret;
+}
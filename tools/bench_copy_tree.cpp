@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#include "bench.h"
+#include "../util.h"
+
+/*
+@brief CopyTree/RemoveTree的基准测试
+@details 用法：bench_copy_tree [目录] [子目录数] [每个子目录的文件数] [文件大小]
+  在目录下生成一棵两层的目录树，分别用cp -a/rm -rf和不同并行度的CopyTree/RemoveTree复制、删除，输出耗时；
+  每一步之前都先sync，避免前一步留下的脏页回写影响后面的结果
+*/
+
+using namespace MyServer;
+
+static void MakeTree(const std::string &root, int dirs, int files, size_t size)
+{
+    std::string data(size, 'x');
+    for (int d = 0; d < dirs; ++d)
+    {
+        std::string dir = root + "/d" + std::to_string(d) + "/sub";
+        FSUtil::Mkdir(dir);
+        for (int f = 0; f < files; ++f)
+        {
+            std::string file = dir + (f % 2 ? "/../f" : "/f") + std::to_string(f);
+            int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd >= 0)
+            {
+                if (write(fd, data.data(), data.size()) != (ssize_t)data.size())
+                    std::cout << "[ERROR] write " << file << " failed" << std::endl;
+                close(fd);
+            }
+        }
+    }
+}
+
+static uint64_t Start()
+{
+    sync();
+    return bench::NowNS();
+}
+
+static double Seconds(uint64_t start)
+{
+    return (bench::NowNS() - start) / 1e9;
+}
+
+static int Shell(const std::string &cmd)
+{
+    return system(cmd.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp";
+    int dirs = argc > 2 ? atoi(argv[2]) : 100;
+    int files = argc > 3 ? atoi(argv[3]) : 100;
+    size_t size = argc > 4 ? atoi(argv[4]) : 4096;
+    std::string src = dir + "/bench_copy_tree.src";
+    std::string dst = dir + "/bench_copy_tree.dst";
+    FSUtil::RemoveTree(src);
+    FSUtil::RemoveTree(dst);
+    MakeTree(src, dirs, files, size);
+    printf("tree: %d dirs x %d files x %zu bytes\n", dirs * 2, files / 2, size);
+
+    uint64_t start = Start();
+    Shell("cp -a " + src + " " + dst);
+    printf("%-24s copy %8.3f s", "cp -a / rm -rf", Seconds(start));
+    start = Start();
+    Shell("rm -rf " + dst);
+    printf("  remove %8.3f s\n", Seconds(start));
+
+    for (size_t threads : {1, 2, 4, 0})
+    {
+        std::vector<std::string> errors;
+        start = Start();
+        bool copied = FSUtil::CopyTree(src, dst, threads, &errors);
+        double copy = Seconds(start);
+        start = Start();
+        bool removed = FSUtil::RemoveTree(dst, threads, &errors);
+        double remove = Seconds(start);
+        printf("%-24s copy %8.3f s  remove %8.3f s%s\n", ("threads=" + std::to_string(threads)).c_str(), copy, remove,
+               copied && removed ? "" : "  (failed)");
+        for (auto &i : errors)
+            printf("  %s\n", i.c_str());
+    }
+    FSUtil::RemoveTree(src);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <thread>
+#include "bench.h"
+#include "../log.h"
+#include "../metrics.h"
+
+/*
+@brief FileLogAppender各IO策略的延迟和吞吐量基准测试
+@details 用法：bench_file_appender [目录] [线程数] [每线程日志条数] [日志长度]
+  每种策略下多个线程并发写同一个Appender，统计单次log()的延迟分布、总吞吐量（含最后的flush），
+  以及写完后文件仍驻留在页缓存中的大小
+*/
+
+using namespace MyServer;
+
+// 文件在页缓存中驻留的字节数
+static size_t CachedBytes(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    size_t cached = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            size_t page = sysconf(_SC_PAGESIZE);
+            std::vector<unsigned char> vec((st.st_size + page - 1) / page);
+            if (mincore(addr, st.st_size, vec.data()) == 0)
+            {
+                for (auto i : vec)
+                    cached += (i & 1) ? page : 0;
+            }
+            munmap(addr, st.st_size);
+        }
+    }
+    close(fd);
+    return cached;
+}
+
+static void Run(FileLogAppender::IOPolicy policy, const std::string &dir, int threads, int count, const std::string &line)
+{
+    std::string path = dir + "/bench_file_appender." + FileLogAppender::PolicyToString(policy) + ".log";
+    unlink(path.c_str());
+    FileLogAppender::ptr appender(new FileLogAppender(path, policy));
+    LogEvent::ptr event(new LogEvent("bench", LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, time(0), "bench"));
+    Histogram latency;
+
+    uint64_t start = bench::NowNS();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            for (int i = 0; i < count; ++i)
+            {
+                uint64_t begin = bench::NowNS();
+                appender->logFormatted(event, line.data(), line.size());
+                latency.record(bench::NowNS() - begin);
+            }
+        });
+    }
+    for (auto &i : workers)
+        i.join();
+    appender->flush();
+    double seconds = (bench::NowNS() - start) / 1e9;
+
+    HistogramSnapshot snap = latency.snapshot();
+    uint64_t total = (uint64_t)threads * count;
+    printf("%-9s %10.0f ev/s %8.1f MB/s  p50 %8lu ns  p99 %8lu ns  p999 %9lu ns  max %10lu ns  cached %6.1f MB\n",
+           FileLogAppender::PolicyToString(policy), total / seconds, total * line.size() / seconds / 1e6,
+           (unsigned long)snap.percentile(0.5), (unsigned long)snap.percentile(0.99),
+           (unsigned long)snap.percentile(0.999), (unsigned long)snap.getMax(), CachedBytes(path) / 1e6);
+    fflush(stdout);
+    appender.reset();
+    unlink(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "/tmp";
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int count = argc > 3 ? atoi(argv[3]) : 20000;
+    int len = argc > 4 ? atoi(argv[4]) : 128;
+    if (threads <= 0 || count <= 0 || len <= 1)
+    {
+        std::cout << "usage: " << argv[0] << " [dir] [threads] [events per thread] [line length]" << std::endl;
+        return 1;
+    }
+    std::string line(len - 1, 'x');
+    line.push_back('\n');
+
+    printf("dir=%s threads=%d events=%d line=%d bytes\n", dir.c_str(), threads, threads * count, len);
+    Run(FileLogAppender::BUFFERED, dir, threads, count, line);
+    Run(FileLogAppender::SYNC, dir, threads, count, line);
+    Run(FileLogAppender::DIRECT, dir, threads, count, line);
+    Run(FileLogAppender::DONTNEED, dir, threads, count, line);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include "bench.h"
+#include "../format.h"
+#include "../log.h"
+#include "../util.h"
+
+/*
+@brief {}风格格式化与printf路径的基准测试
+@details 用法：bench_format
+  分别比较格式化到栈上缓冲区、生成std::string、写入日志事件三种场景下，
+  FormatTo/FormatToString/LogEvent::format与snprintf/StringUtil::Format/LogEvent::printf的单次耗时
+*/
+
+using namespace MyServer;
+
+int main()
+{
+    const char *user = "alice";
+    std::string ip = "192.168.100.200";
+    int port = 8080;
+    uint64_t bytes = 1234567890123ull;
+    double ratio = 0.731;
+
+    printf("== integer and floating point ==\n");
+    uint64_t n = 0;
+    bench::Report("snprintf %lu", bench::Measure([&]() {
+                      char buf[32];
+                      snprintf(buf, sizeof(buf), "%lu", (unsigned long)++n);
+                      bench::DoNotOptimize(buf);
+                  }));
+    bench::Report("FormatUInt", bench::Measure([&]() {
+                      char buf[FORMAT_NUMBER_SIZE];
+                      char *p = FormatUInt(buf + sizeof(buf), ++n);
+                      bench::DoNotOptimize(p);
+                  }));
+    double d = 0.1;
+    bench::Report("snprintf %.17g", bench::Measure([&]() {
+                      char buf[32];
+                      snprintf(buf, sizeof(buf), "%.17g", d += 1.37);
+                      bench::DoNotOptimize(buf);
+                  }));
+    bench::Report("FormatDouble", bench::Measure([&]() {
+                      char buf[FORMAT_NUMBER_SIZE];
+                      size_t len = FormatDouble(buf, d += 1.37);
+                      bench::DoNotOptimize(len);
+                      bench::DoNotOptimize(buf);
+                  }));
+
+    printf("== message into a stack buffer ==\n");
+    bench::Report("snprintf", bench::Measure([&]() {
+                      char buf[512];
+                      int len = snprintf(buf, sizeof(buf), "user %s login from %s:%d, sent %lu bytes, ratio %g",
+                                         user, ip.c_str(), port, (unsigned long)bytes, ratio);
+                      bench::DoNotOptimize(len);
+                      bench::DoNotOptimize(buf);
+                  }));
+    bench::Report("FormatTo(FormatBuffer)", bench::Measure([&]() {
+                      FormatBuffer buf;
+                      FormatTo(buf, MYSERVER_FMT("user {} login from {}:{}, sent {} bytes, ratio {}"),
+                               user, ip, port, bytes, ratio);
+                      bench::DoNotOptimize(buf);
+                  }));
+
+    printf("== message into std::string ==\n");
+    bench::Report("StringUtil::Format", bench::Measure([&]() {
+                      std::string str = StringUtil::Format("user %s login from %s:%d, sent %lu bytes, ratio %g",
+                                                           user, ip.c_str(), port, (unsigned long)bytes, ratio);
+                      bench::DoNotOptimize(str);
+                  }));
+    bench::Report("MYSERVER_FORMAT", bench::Measure([&]() {
+                      std::string str = MYSERVER_FORMAT("user {} login from {}:{}, sent {} bytes, ratio {}",
+                                                        user, ip, port, bytes, ratio);
+                      bench::DoNotOptimize(str);
+                  }));
+
+    printf("== message into a LogEvent ==\n");
+    LogEvent::ptr event(new LogEvent("bench", LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, time(0), "bench"));
+    bench::Report("LogEvent::printf", bench::Measure([&]() {
+                      event->getSS().str(std::string());
+                      event->printf("user %s login from %s:%d, sent %lu bytes, ratio %g",
+                                    user, ip.c_str(), port, (unsigned long)bytes, ratio);
+                  }));
+    bench::Report("LogEvent::format", bench::Measure([&]() {
+                      event->getSS().str(std::string());
+                      event->format(MYSERVER_FMT("user {} login from {}:{}, sent {} bytes, ratio {}"),
+                                    user, ip, port, bytes, ratio);
+                  }));
+    bench::Report("operator<<", bench::Measure([&]() {
+                      event->getSS().str(std::string());
+                      event->getSS() << "user " << user << " login from " << ip << ":" << port << ", sent "
+                                     << bytes << " bytes, ratio " << ratio;
+                  }));
+    return 0;
+}
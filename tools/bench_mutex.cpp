@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../adaptive_mutex.h"
+
+/*
+@brief AdaptiveMutex与std::mutex、Spinlock的对比
+@details 用法：bench_mutex [线程数] [短临界区每线程加锁次数] [阻塞临界区每线程加锁次数]
+  依次测量：单线程无竞争时一次加解锁的耗时；多线程争抢只做一次自增的短临界区；
+  持锁线程在临界区内阻塞（模拟appender写文件）时的墙钟时间和整个进程消耗的CPU时间。
+  最后打开竞争剖析重跑一遍AdaptiveMutex的短临界区，输出剖析结果
+*/
+
+using namespace MyServer;
+
+static uint64_t CpuNS()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+@brief threads个线程各加锁ops次，每次持锁期间执行critical
+@return 是否所有加锁都互斥（计数器等于总次数）
+*/
+template <class M, class F>
+static bool Contend(const char *name, int threads, int ops, F critical)
+{
+    M mutex;
+    uint64_t counter = 0;
+    std::vector<std::thread> workers;
+    uint64_t start = bench::NowNS(), cpu = CpuNS();
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            for (int i = 0; i < ops; ++i)
+            {
+                mutex.lock();
+                ++counter;
+                critical();
+                mutex.unlock();
+            }
+        });
+    }
+    for (auto &i : workers)
+        i.join();
+    uint64_t wall = bench::NowNS() - start;
+    cpu = CpuNS() - cpu;
+    uint64_t total = (uint64_t)threads * ops;
+    printf("%-24s wall %10.1f ns/op  cpu %10.1f ns/op  cpu/wall %5.2f\n", name, (double)wall / total,
+           (double)cpu / total, (double)cpu / wall);
+    fflush(stdout);
+    return counter == total;
+}
+
+template <class M>
+static void Uncontended(const char *name)
+{
+    M mutex;
+    bench::Report(std::string(name) + " lock+unlock", bench::Measure([&]() {
+                      mutex.lock();
+                      bench::DoNotOptimize(mutex);
+                      mutex.unlock();
+                  }));
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int short_ops = argc > 2 ? atoi(argv[2]) : 1000000;
+    int block_ops = argc > 3 ? atoi(argv[3]) : 200;
+    bool ok = true;
+
+    // 进程里还没有其他线程时glibc的pthread_mutex会省掉原子操作，先起一个线程，和实际使用时的条件一致
+    std::thread([]() {}).join();
+    printf("== uncontended ==\n");
+    Uncontended<Spinlock>("Spinlock");
+    Uncontended<std::mutex>("std::mutex");
+    Uncontended<AdaptiveMutex>("AdaptiveMutex");
+
+    auto nothing = []() {};
+    printf("== %d threads, increment only, %d ops each ==\n", threads, short_ops);
+    ok &= Contend<Spinlock>("Spinlock", threads, short_ops, nothing);
+    ok &= Contend<std::mutex>("std::mutex", threads, short_ops, nothing);
+    ok &= Contend<AdaptiveMutex>("AdaptiveMutex", threads, short_ops, nothing);
+
+    // 持锁时睡眠100us，相当于appender在锁内等一次慢速写盘
+    auto blocking = []() { usleep(100); };
+    printf("== %d threads, holder blocks 100us, %d ops each ==\n", threads, block_ops);
+    ok &= Contend<Spinlock>("Spinlock", threads, block_ops, blocking);
+    ok &= Contend<std::mutex>("std::mutex", threads, block_ops, blocking);
+    ok &= Contend<AdaptiveMutex>("AdaptiveMutex", threads, block_ops, blocking);
+
+    printf("== AdaptiveMutex profiling on ==\n");
+    AdaptiveMutex::ResetProfile();
+    AdaptiveMutex::SetProfiling(true);
+    ok &= Contend<AdaptiveMutex>("AdaptiveMutex", threads, short_ops / 10, nothing);
+    AdaptiveMutex::SetProfiling(false);
+    printf("%s\n", AdaptiveMutex::ProfileToYamlString(3).c_str());
+
+    if (!ok)
+        printf("[FAIL] lost updates, mutual exclusion broken\n");
+    return ok ? 0 : 1;
+}
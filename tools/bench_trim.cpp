@@ -0,0 +1,96 @@
+#include <vector>
+#include "bench.h"
+#include "../util.h"
+
+/*
+@brief Trim/Split的基准测试
+@details 用法：bench_trim
+  比较返回std::string的Trim与返回子串的TrimView，以及按std::string::find_first_of切分成vector<std::string>
+  与Split/Tokenize迭代器，分别在打开和关闭SIMD时测量
+*/
+
+using namespace MyServer;
+
+// 切分成vector<std::string>的常见写法，作为对照
+static std::vector<std::string> SplitToVector(const std::string &str, const std::string &delims)
+{
+    std::vector<std::string> ret;
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = str.find_first_of(delims, start);
+        if (end == std::string::npos)
+        {
+            ret.push_back(str.substr(start));
+            return ret;
+        }
+        ret.push_back(str.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+static void RunTrim(const char *name, const std::string &str, bool simd)
+{
+    StringUtil::SetSimdEnabled(simd);
+    std::string prefix = std::string(name) + (simd ? " simd" : " scalar");
+    bench::Report(prefix + " Trim", bench::Measure([&]() {
+                      std::string ret = StringUtil::Trim(str);
+                      bench::DoNotOptimize(ret);
+                  }),
+                  str.size());
+    bench::Report(prefix + " TrimView", bench::Measure([&]() {
+                      std::string_view ret = StringUtil::TrimView(str);
+                      bench::DoNotOptimize(ret);
+                  }),
+                  str.size());
+}
+
+static void RunSplit(const char *name, const std::string &str, const std::string &delims, bool simd)
+{
+    StringUtil::SetSimdEnabled(simd);
+    std::string prefix = std::string(name) + (simd ? " simd" : " scalar");
+    bench::Report(prefix + " vector<string>", bench::Measure([&]() {
+                      std::vector<std::string> ret = SplitToVector(str, delims);
+                      bench::DoNotOptimize(ret);
+                  }),
+                  str.size());
+    bench::Report(prefix + " Split", bench::Measure([&]() {
+                      size_t total = 0;
+                      for (std::string_view field : StringUtil::Split(str, delims))
+                          total += field.size();
+                      bench::DoNotOptimize(total);
+                  }),
+                  str.size());
+    bench::Report(prefix + " Tokenize", bench::Measure([&]() {
+                      size_t total = 0;
+                      for (std::string_view field : StringUtil::Tokenize(str, delims))
+                          total += field.size();
+                      bench::DoNotOptimize(total);
+                  }),
+                  str.size());
+}
+
+int main()
+{
+    std::string header = "  application/json  ";
+    std::string padded = std::string(40, ' ') + "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36" + std::string(40, '\t');
+    std::string csv = "1024,alice,192.168.100.200,8080,GET,/api/v2/users/1234567/orders,200,3532,0.731,"
+                      "Mozilla/5.0 (X11; Linux x86_64),https://www.example.com/landing/spring-sale/index.html";
+    std::string text;
+    for (int i = 0; i < 20; ++i)
+        text += "the quick brown fox  jumps over\tthe lazy dog\r\n";
+
+    for (bool simd : {false, true})
+    {
+        printf("== trim, %s ==\n", simd ? "simd" : "scalar");
+        RunTrim("header value", header, simd);
+        RunTrim("padded line", padded, simd);
+    }
+    for (bool simd : {false, true})
+    {
+        printf("== split, %s ==\n", simd ? "simd" : "scalar");
+        RunSplit("csv line", csv, ",", simd);
+        RunSplit("text", text, " \t\r\n", simd);
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <vector>
+#include "bench.h"
+#include "../util.h"
+
+/*
+@brief TypeUtil数值解析的基准测试
+@details 用法：bench_typeutil
+  比较atoi/strtoll/atof与TypeUtil::Parse解析单个整数和浮点数的耗时，
+  以及按逗号切分后逐项strtoll/strtod与TypeUtil::ParseList解析数值列表的吞吐量
+*/
+
+using namespace MyServer;
+
+int main()
+{
+    const char *ints[] = {"0", "42", "8080", "-1234567", "9223372036854775807", "  +31536000"};
+    const char *doubles[] = {"0.5", "3.14159", "-2.5e-3", "1234567.891", "6.02214076e23", "  +0.731"};
+
+    printf("== single integer ==\n");
+    size_t k = 0;
+    bench::Report("atoi", bench::Measure([&]() {
+                      int v = atoi(ints[k++ % 6]);
+                      bench::DoNotOptimize(v);
+                  }));
+    bench::Report("strtoll", bench::Measure([&]() {
+                      long long v = strtoll(ints[k++ % 6], nullptr, 10);
+                      bench::DoNotOptimize(v);
+                  }));
+    bench::Report("TypeUtil::Atoi(const char *)", bench::Measure([&]() {
+                      int64_t v = TypeUtil::Atoi(ints[k++ % 6]);
+                      bench::DoNotOptimize(v);
+                  }));
+    std::vector<std::string_view> int_views(ints, ints + 6);
+    bench::Report("TypeUtil::Parse(int64_t)", bench::Measure([&]() {
+                      int64_t v = 0;
+                      TypeUtil::ParseResult rt = TypeUtil::Parse(int_views[k++ % 6], v);
+                      bench::DoNotOptimize(rt);
+                      bench::DoNotOptimize(v);
+                  }));
+
+    printf("== single double ==\n");
+    bench::Report("atof", bench::Measure([&]() {
+                      double v = atof(doubles[k++ % 6]);
+                      bench::DoNotOptimize(v);
+                  }));
+    bench::Report("TypeUtil::Atof(const char *)", bench::Measure([&]() {
+                      double v = TypeUtil::Atof(doubles[k++ % 6]);
+                      bench::DoNotOptimize(v);
+                  }));
+    std::vector<std::string_view> double_views(doubles, doubles + 6);
+    bench::Report("TypeUtil::Parse(double)", bench::Measure([&]() {
+                      double v = 0;
+                      TypeUtil::ParseResult rt = TypeUtil::Parse(double_views[k++ % 6], v);
+                      bench::DoNotOptimize(rt);
+                      bench::DoNotOptimize(v);
+                  }));
+
+    printf("== list of 256 numbers ==\n");
+    std::string int_list, double_list;
+    for (int i = 0; i < 256; ++i)
+    {
+        int_list += (i ? ", " : "") + std::to_string((int64_t)i * 7919 - 500000);
+        double_list += (i ? "," : "") + std::to_string(i * 0.37 - 20);
+    }
+    std::vector<int64_t> int_values;
+    bench::Report("strtoll loop", bench::Measure([&]() {
+                      int_values.clear();
+                      const char *p = int_list.c_str();
+                      while (*p)
+                      {
+                          char *end;
+                          int_values.push_back(strtoll(p, &end, 10));
+                          p = *end == ',' ? end + 1 : end;
+                      }
+                      bench::DoNotOptimize(int_values);
+                  }),
+                  int_list.size());
+    bench::Report("TypeUtil::ParseList(int64_t)", bench::Measure([&]() {
+                      int_values.clear();
+                      TypeUtil::ParseResult rt = TypeUtil::ParseList(int_list, ',', int_values);
+                      bench::DoNotOptimize(rt);
+                      bench::DoNotOptimize(int_values);
+                  }),
+                  int_list.size());
+    std::vector<double> double_values;
+    bench::Report("strtod loop", bench::Measure([&]() {
+                      double_values.clear();
+                      const char *p = double_list.c_str();
+                      while (*p)
+                      {
+                          char *end;
+                          double_values.push_back(strtod(p, &end));
+                          p = *end == ',' ? end + 1 : end;
+                      }
+                      bench::DoNotOptimize(double_values);
+                  }),
+                  double_list.size());
+    bench::Report("TypeUtil::ParseList(double)", bench::Measure([&]() {
+                      double_values.clear();
+                      TypeUtil::ParseResult rt = TypeUtil::ParseList(double_list, ',', double_values);
+                      bench::DoNotOptimize(rt);
+                      bench::DoNotOptimize(double_values);
+                  }),
+                  double_list.size());
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <vector>
+#include "bench.h"
+#include "../util.h"
+
+/*
+@brief UrlEncode/UrlDecode的基准测试
+@details 用法：bench_url
+  对几类常见的url和查询串，分别在打开和关闭SIMD时测量编码、解码和原地解码的吞吐量
+*/
+
+using namespace MyServer;
+
+struct Sample
+{
+    const char *name;
+    std::string raw; // 解码后的原文
+};
+
+static std::vector<Sample> MakeSamples()
+{
+    std::vector<Sample> samples;
+    samples.push_back({"short query", "q=hello world&page=2&sort=desc"});
+    samples.push_back({"api path", "/api/v2/users/1234567/orders?status=shipped&from=2024-01-01T00:00:00Z&limit=50"});
+    samples.push_back({"tracking url",
+                       "https://www.example.com/landing/spring-sale/index.html?utm_source=newsletter&utm_medium=email"
+                       "&utm_campaign=spring_sale_2024&utm_content=hero_banner_v3&gclid=EAIaIQobChMI8Z3x5r7q_AIVgd_ICh0"
+                       "ZSgF3EAAYASAAEgJx3_D_BwE&ref=partner.example.org/path/to/page"});
+    samples.push_back({"cjk search", "q=上海 浦东新区 咖啡馆 推荐&city=上海&lang=zh-CN"});
+    std::string token = "token=";
+    for (int i = 0; i < 512; ++i)
+        token.push_back("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[(i * 37) % 64]);
+    samples.push_back({"base64 token", token});
+    return samples;
+}
+
+static void Run(const Sample &sample, bool simd)
+{
+    StringUtil::SetSimdEnabled(simd);
+    std::string encoded = StringUtil::UrlEncode(sample.raw);
+    std::string prefix = std::string(sample.name) + (simd ? " simd" : " scalar");
+    std::string out;
+    bench::Report(prefix + " encode", bench::Measure([&]() {
+                      out.clear();
+                      StringUtil::UrlEncodeTo(out, sample.raw);
+                      bench::DoNotOptimize(out);
+                  }),
+                  sample.raw.size());
+    bench::Report(prefix + " decode", bench::Measure([&]() {
+                      out.clear();
+                      StringUtil::UrlDecodeTo(out, encoded);
+                      bench::DoNotOptimize(out);
+                  }),
+                  encoded.size());
+    std::string buf;
+    bench::Report(prefix + " decode in place", bench::Measure([&]() {
+                      buf = encoded;
+                      StringUtil::UrlDecodeInPlace(buf);
+                      bench::DoNotOptimize(buf);
+                  }),
+                  encoded.size());
+}
+
+int main()
+{
+    for (auto &i : MakeSamples())
+    {
+        printf("== %s: %zu bytes ==\n", i.name, i.raw.size());
+        Run(i, false);
+        Run(i, true);
+    }
+    return 0;
+}
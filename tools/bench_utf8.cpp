@@ -0,0 +1,149 @@
+#include <locale.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <vector>
+#include "bench.h"
+#include "../util.h"
+
+/*
+@brief UTF-8校验与转码的基准测试
+@details 用法：bench_utf8
+  对以ASCII为主的日志文本、以中文为主的文本和两者混合的文本，分别在打开和关闭SIMD时测量
+  ValidateUtf8、UTF-8与UTF-16/UTF-32/wchar_t之间转换的吞吐量，并与基于区域设置的mbstowcs/wcstombs对比；
+  同时检查两种实现的结果一致
+*/
+
+using namespace MyServer;
+
+struct Sample
+{
+    const char *name;
+    std::string text;
+};
+
+static std::vector<Sample> MakeSamples()
+{
+    std::string ascii, cjk, mixed;
+    for (int i = 0; i < 64; ++i)
+    {
+        ascii += "2024-05-01 12:00:00 INFO [http] GET /api/v2/users/" + std::to_string(i * 7919) +
+                 " 200 3532 bytes in 0.731ms\n";
+        cjk += "服务器启动完成，监听端口八千零八十，当前连接数为零，配置文件已加载。";
+        mixed += "user=张三 action=登录 ip=192.168.1." + std::to_string(i) + " result=成功\n";
+    }
+    return {{"ascii log", ascii}, {"cjk text", cjk}, {"mixed", mixed}};
+}
+
+static bool g_mismatch = false;
+
+template <class F>
+static void Check(const char *what, const Sample &sample, F f)
+{
+    StringUtil::SetSimdEnabled(false);
+    auto expect = f();
+    StringUtil::SetSimdEnabled(true);
+    if (f() != expect)
+    {
+        printf("[FAIL] %s: %s differs between scalar and simd\n", sample.name, what);
+        g_mismatch = true;
+    }
+}
+
+static void Run(const Sample &sample, bool simd)
+{
+    StringUtil::SetSimdEnabled(simd);
+    const std::string &text = sample.text;
+    std::string prefix = std::string(sample.name) + (simd ? " simd" : " scalar");
+    std::u16string u16;
+    std::u32string u32;
+    std::string u8;
+    StringUtil::Utf8ToUtf16(text, u16);
+    StringUtil::Utf8ToUtf32(text, u32);
+
+    bench::Report(prefix + " ValidateUtf8", bench::Measure([&]() {
+                      bool ok = StringUtil::ValidateUtf8(text);
+                      bench::DoNotOptimize(ok);
+                  }),
+                  text.size());
+    bench::Report(prefix + " Utf8ToUtf16", bench::Measure([&]() {
+                      std::u16string out;
+                      StringUtil::Utf8ToUtf16(text, out);
+                      bench::DoNotOptimize(out);
+                  }),
+                  text.size());
+    bench::Report(prefix + " Utf8ToUtf32", bench::Measure([&]() {
+                      std::u32string out;
+                      StringUtil::Utf8ToUtf32(text, out);
+                      bench::DoNotOptimize(out);
+                  }),
+                  text.size());
+    bench::Report(prefix + " Utf16ToUtf8", bench::Measure([&]() {
+                      u8.clear();
+                      StringUtil::Utf16ToUtf8(u16, u8);
+                      bench::DoNotOptimize(u8);
+                  }),
+                  text.size());
+    bench::Report(prefix + " Utf32ToUtf8", bench::Measure([&]() {
+                      u8.clear();
+                      StringUtil::Utf32ToUtf8(u32, u8);
+                      bench::DoNotOptimize(u8);
+                  }),
+                  text.size());
+}
+
+static void RunLocale(const Sample &sample)
+{
+    const std::string &text = sample.text;
+    std::string prefix = std::string(sample.name) + " locale";
+    std::wstring ws(text.size() + 1, L'\0');
+    bench::Report(prefix + " mbstowcs", bench::Measure([&]() {
+                      size_t n = mbstowcs(&ws[0], text.c_str(), ws.size());
+                      bench::DoNotOptimize(n);
+                      bench::DoNotOptimize(ws);
+                  }),
+                  text.size());
+    std::wstring wide = StringUtil::StringToWString(text);
+    std::string out(text.size() + 1, '\0');
+    bench::Report(prefix + " wcstombs", bench::Measure([&]() {
+                      size_t n = wcstombs(&out[0], wide.c_str(), out.size());
+                      bench::DoNotOptimize(n);
+                      bench::DoNotOptimize(out);
+                  }),
+                  text.size());
+    bench::Report(std::string(sample.name) + " StringToWString", bench::Measure([&]() {
+                      std::wstring w = StringUtil::StringToWString(text);
+                      bench::DoNotOptimize(w);
+                  }),
+                  text.size());
+    bench::Report(std::string(sample.name) + " WStringToString", bench::Measure([&]() {
+                      std::string s = StringUtil::WStringToString(wide);
+                      bench::DoNotOptimize(s);
+                  }),
+                  text.size());
+}
+
+int main()
+{
+    if (!setlocale(LC_ALL, "C.UTF-8"))
+        printf("[WARN] C.UTF-8 locale not available, mbstowcs/wcstombs results are meaningless\n");
+    for (auto &i : MakeSamples())
+    {
+        printf("== %s: %zu bytes ==\n", i.name, i.text.size());
+        Check("Utf8ToUtf16", i, [&]() {
+            std::u16string out;
+            StringUtil::Utf8ToUtf16(i.text, out);
+            return out;
+        });
+        Check("Utf8ToUtf32 round trip", i, [&]() {
+            std::u32string u32;
+            std::string out;
+            StringUtil::Utf8ToUtf32(i.text, u32);
+            StringUtil::Utf32ToUtf8(u32, out);
+            return out;
+        });
+        Run(i, false);
+        Run(i, true);
+        RunLocale(i);
+    }
+    return g_mismatch ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <random>
+#include <iostream>
+#include <vector>
+#include "../util.h"
+
+/*
+@brief base64、十六进制编解码和Crc32c的测试，检查SIMD实现与标量实现结果一致
+@details 用法：fuzz_codec [轮数] [随机种子]
+  先对长度0~256的每个长度逐一检查：编码结果、编码后再解码得到原文、去掉或多加'='填充、
+  在每个位置换入非法字符后的解码结果，以及Crc32c的分段计算；再用随机长度（0~1023）和内容跑指定轮数，
+  随机轮次只在随机的几个位置换入非法字符。
+  解码结果追加在已有内容之后，同时检查失败时out恢复为调用前的内容；发现不一致时输出输入的十六进制并返回1
+*/
+
+using namespace MyServer;
+
+static const size_t s_max_len = 256;
+
+static std::string Hex(const std::string &str)
+{
+    bool simd = StringUtil::IsSimdEnabled();
+    StringUtil::SetSimdEnabled(false);
+    std::string ret = StringUtil::HexEncode(str);
+    StringUtil::SetSimdEnabled(simd);
+    return ret;
+}
+
+static std::string RandomBytes(std::mt19937 &rng, size_t len)
+{
+    std::string str(len, '\0');
+    for (auto &c : str)
+        c = (char)rng();
+    return str;
+}
+
+template <class F>
+static bool Same(const char *what, const std::string &input, F f)
+{
+    StringUtil::SetSimdEnabled(false);
+    std::string expect = f();
+    StringUtil::SetSimdEnabled(true);
+    std::string actual = f();
+    if (expect == actual)
+        return true;
+    std::cout << "[FAIL] " << what << " input=" << Hex(input) << " scalar=" << Hex(expect)
+              << " simd=" << Hex(actual) << std::endl;
+    return false;
+}
+
+// 解码结果追加在前缀之后，返回值和out一起比较
+static std::string Base64Decode(const std::string &str, bool url)
+{
+    std::string out = "prefix";
+    bool ok = StringUtil::Base64DecodeTo(out, str, url);
+    return (ok ? "ok:" : "fail:") + out;
+}
+
+static std::string HexDecode(const std::string &str)
+{
+    std::string out = "prefix";
+    bool ok = StringUtil::HexDecodeTo(out, str);
+    return (ok ? "ok:" : "fail:") + out;
+}
+
+static std::string Crc(const std::string &data, size_t split)
+{
+    uint32_t whole = StringUtil::Crc32c(data);
+    uint32_t parts = StringUtil::Crc32c(data.substr(split), StringUtil::Crc32c(data.substr(0, split)));
+    return std::to_string(whole) + "/" + std::to_string(parts);
+}
+
+/*
+@brief 非法字符出现的位置：逐个长度检查时取每个位置，随机轮次中随机抽几个位置
+*/
+static std::vector<size_t> Positions(std::mt19937 &rng, size_t len, bool every)
+{
+    std::vector<size_t> pos;
+    if (every)
+    {
+        for (size_t i = 0; i < len; ++i)
+            pos.push_back(i);
+    }
+    else
+    {
+        for (int i = 0; len && i < 8; ++i)
+            pos.push_back(rng() % len);
+    }
+    return pos;
+}
+
+static bool CheckBase64(std::mt19937 &rng, const std::string &data, bool url, bool every)
+{
+    const char *what = url ? "base64url" : "base64";
+    if (!Same(what, data, [&]() { return StringUtil::Base64Encode(data, url); }))
+        return false;
+    std::string encoded = StringUtil::Base64Encode(data, url);
+    if (Base64Decode(encoded, url) != "ok:prefix" + data)
+    {
+        std::cout << "[FAIL] " << what << " round trip input=" << Hex(data) << std::endl;
+        return false;
+    }
+    // 去掉填充，或者多加一个'='
+    std::string unpadded = encoded.substr(0, encoded.find('='));
+    bool ok = Same(what, unpadded, [&]() { return Base64Decode(unpadded, url); }) &&
+              Same(what, encoded + "=", [&]() { return Base64Decode(encoded + "=", url); });
+    if (ok && Base64Decode(unpadded, url) != "ok:prefix" + data)
+    {
+        std::cout << "[FAIL] " << what << " unpadded input=" << Hex(data) << std::endl;
+        return false;
+    }
+    // 换入字母表以外的字符，包括另一个字母表特有的两个字符
+    std::string invalid = std::string("=* \n\0\x80\xff", 7) + (url ? "+/" : "-_");
+    for (size_t i : Positions(rng, encoded.size(), every))
+    {
+        for (char c : invalid)
+        {
+            std::string bad = encoded;
+            bad[i] = c;
+            if (!Same(what, bad, [&]() { return Base64Decode(bad, url); }))
+                return false;
+        }
+    }
+    return ok;
+}
+
+static bool CheckHex(std::mt19937 &rng, const std::string &data, bool every)
+{
+    bool ok = Same("hex", data, [&]() { return StringUtil::HexEncode(data); }) &&
+              Same("hex upper", data, [&]() { return StringUtil::HexEncode(data, true); });
+    if (!ok)
+        return false;
+    std::string encoded = StringUtil::HexEncode(data);
+    // 大小写混合
+    std::string mixed = encoded;
+    for (size_t i = 0; i < mixed.size(); i += 3)
+        mixed[i] = toupper(mixed[i]);
+    if (HexDecode(mixed) != "ok:prefix" + data)
+    {
+        std::cout << "[FAIL] hex round trip input=" << Hex(data) << std::endl;
+        return false;
+    }
+    ok = Same("hex decode", mixed, [&]() { return HexDecode(mixed); }) &&
+         Same("hex decode odd", encoded + "a", [&]() { return HexDecode(encoded + "a"); });
+    // 紧挨着'0'~'9'、'A'~'F'、'a'~'f'的字符
+    static const std::string s_invalid("gG/:@`\0 \x80", 9);
+    for (size_t i : Positions(rng, encoded.size(), every))
+    {
+        for (char c : s_invalid)
+        {
+            std::string bad = encoded;
+            bad[i] = c;
+            if (!Same("hex decode", bad, [&]() { return HexDecode(bad); }))
+                return false;
+        }
+    }
+    return ok;
+}
+
+static bool Check(std::mt19937 &rng, const std::string &data, bool every)
+{
+    size_t split = data.empty() ? 0 : rng() % data.size();
+    return CheckBase64(rng, data, false, every) && CheckBase64(rng, data, true, every) && CheckHex(rng, data, every) &&
+           Same("crc32c", data, [&]() { return Crc(data, split); });
+}
+
+int main(int argc, char **argv)
+{
+    long rounds = argc > 1 ? atol(argv[1]) : 20000;
+    unsigned seed = argc > 2 ? atoi(argv[2]) : std::random_device()();
+    std::mt19937 rng(seed);
+    std::cout << "rounds=" << rounds << " seed=" << seed << std::endl;
+
+    // RFC 3720附录B.4的测试向量
+    if (StringUtil::Crc32c("123456789") != 0xE3069283)
+    {
+        std::cout << "[FAIL] crc32c test vector" << std::endl;
+        return 1;
+    }
+    for (size_t len = 0; len <= s_max_len; ++len)
+    {
+        if (!Check(rng, RandomBytes(rng, len), true))
+            return 1;
+    }
+    for (long r = 0; r < rounds; ++r)
+    {
+        size_t len = rng() % (4 * s_max_len);
+        if (!Check(rng, RandomBytes(rng, len), false))
+            return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
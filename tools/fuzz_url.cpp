@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <random>
+#include <iostream>
+#include "../util.h"
+
+/*
+@brief UrlEncode/UrlDecode的随机测试，检查SIMD实现与标量实现结果一致
+@details 用法：fuzz_url [轮数] [随机种子]
+  随机生成长度0~300、偏向url常见字符和'%'、'+'的输入，比较两种实现的编码、解码、原地解码结果，
+  并检查编码后再解码得到原文；发现不一致时输出输入的十六进制并返回1
+*/
+
+using namespace MyServer;
+
+static std::string RandomInput(std::mt19937 &rng)
+{
+    static const char s_chars[] = "abcXYZ019-._~ %+&=/?#%%%++";
+    size_t len = rng() % 301;
+    std::string str(len, '\0');
+    for (auto &c : str)
+    {
+        switch (rng() % 4)
+        {
+        case 0:
+            c = (char)rng(); // 任意字节，包括>=0x80
+            break;
+        case 1:
+            c = "0123456789abcdefABCDEF"[rng() % 22]; // 让'%'后面常常跟着合法的十六进制
+            break;
+        default:
+            c = s_chars[rng() % (sizeof(s_chars) - 1)];
+            break;
+        }
+    }
+    return str;
+}
+
+static std::string Hex(const std::string &str)
+{
+    return StringUtil::HexEncode(str);
+}
+
+template <class F>
+static bool Same(const char *what, const std::string &input, F f)
+{
+    StringUtil::SetSimdEnabled(false);
+    std::string expect = f();
+    StringUtil::SetSimdEnabled(true);
+    std::string actual = f();
+    if (expect == actual)
+        return true;
+    std::cout << "[FAIL] " << what << " input=" << Hex(input) << " scalar=" << Hex(expect)
+              << " simd=" << Hex(actual) << std::endl;
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+    unsigned seed = argc > 2 ? atoi(argv[2]) : std::random_device()();
+    std::mt19937 rng(seed);
+    std::cout << "rounds=" << rounds << " seed=" << seed << std::endl;
+
+    for (long r = 0; r < rounds; ++r)
+    {
+        std::string input = RandomInput(rng);
+        bool plus = rng() & 1;
+        bool ok = Same("encode", input, [&]() { return StringUtil::UrlEncode(input, plus); }) &&
+                  Same("decode", input, [&]() { return StringUtil::UrlDecode(input, plus); }) &&
+                  Same("decode in place", input, [&]() {
+                      std::string buf = "prefix" + input;
+                      buf.resize(6 + StringUtil::UrlDecodeInPlace(&buf[6], input.size(), plus));
+                      return buf;
+                  });
+        if (ok && StringUtil::UrlDecode(StringUtil::UrlEncode(input, plus), plus) != input)
+        {
+            std::cout << "[FAIL] round trip input=" << Hex(input) << std::endl;
+            ok = false;
+        }
+        if (!ok)
+            return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <random>
+#include <iostream>
+#include "../util.h"
+
+/*
+@brief UTF-8校验与解码的随机测试，检查SIMD实现与标量实现结果一致
+@details 用法：fuzz_utf8 [轮数] [随机种子]
+  随机生成0~300个码点，每8轮中有一轮生成0~3000个，ASCII、2字节、3字节、4字节各占一定比例，包括各长度的边界码点，
+  一部分输入以其中一种长度为主（如连续的中文）；编码为UTF-8后，
+  一半的输入再随机替换、删除几个字节或截断，替换时偏向0x80、0xC0、0xED、0xF4这类边界字节；
+  比较两种实现的ValidateUtf8、Utf8ToUtf16、Utf8ToUtf32的返回值、出错位置和输出，
+  并检查合法输入经UTF-32转回后得到原文；发现不一致时输出输入的十六进制并返回1
+*/
+
+using namespace MyServer;
+
+// favor为偏向的分支，小于0时不偏向
+static char32_t RandomCodePoint(std::mt19937 &rng, int favor)
+{
+    static const char32_t s_edges[] = {0, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFFFD, 0xFFFF, 0x10000, 0x10FFFF};
+    switch (favor >= 0 && rng() % 16 ? favor : rng() % 8)
+    {
+    case 0:
+    case 1:
+    case 2:
+        return rng() % 0x80;
+    case 3:
+        return 0x80 + rng() % (0x800 - 0x80);
+    case 4:
+    case 5:
+    {
+        char32_t cp = 0x800 + rng() % (0x10000 - 0x800);
+        return (cp >= 0xD800 && cp <= 0xDFFF) ? 0x4E2D : cp;
+    }
+    case 6:
+        return 0x10000 + rng() % (0x110000 - 0x10000);
+    default:
+        return s_edges[rng() % (sizeof(s_edges) / sizeof(s_edges[0]))];
+    }
+}
+
+static std::string RandomInput(std::mt19937 &rng, bool &valid)
+{
+    static const unsigned char s_bytes[] = {0x00, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF,
+                                            0xE0, 0xED, 0xEF, 0xF0, 0xF4, 0xF5, 0xF8, 0xFF};
+    // 偶尔生成跨过4KB分段校验边界的长输入
+    std::u32string cps(rng() % 8 == 0 ? rng() % 3001 : rng() % 301, U'\0');
+    static const int s_favors[] = {-1, -1, 0, 3, 4, 6};
+    int favor = s_favors[rng() % (sizeof(s_favors) / sizeof(s_favors[0]))];
+    for (auto &c : cps)
+        c = RandomCodePoint(rng, favor);
+    std::string str;
+    StringUtil::Utf32ToUtf8(cps, str);
+    valid = true;
+    if (str.empty() || rng() % 2)
+        return str;
+    valid = false;
+    for (int n = 1 + rng() % 3; n > 0 && !str.empty(); --n)
+    {
+        size_t pos = rng() % str.size();
+        switch (rng() % 4)
+        {
+        case 0:
+            str[pos] = (char)rng();
+            break;
+        case 1:
+            str.erase(pos, 1);
+            break;
+        case 2:
+            str.resize(pos);
+            break;
+        default:
+            str[pos] = (char)s_bytes[rng() % sizeof(s_bytes)];
+            break;
+        }
+    }
+    return str;
+}
+
+static std::string Hex(const std::string &str)
+{
+    return StringUtil::HexEncode(str);
+}
+
+template <class F>
+static bool Same(const char *what, const std::string &input, F f)
+{
+    StringUtil::SetSimdEnabled(false);
+    std::string expect = f();
+    StringUtil::SetSimdEnabled(true);
+    std::string actual = f();
+    if (expect == actual)
+        return true;
+    std::cout << "[FAIL] " << what << " input=" << Hex(input) << " scalar=" << expect << " simd=" << actual << std::endl;
+    return false;
+}
+
+// 返回值、出错位置和追加在前缀之后的输出一起比较
+template <class CharT>
+static std::string Decode(const std::string &input, bool (*decode)(std::string_view, std::basic_string<CharT> &, size_t *))
+{
+    std::basic_string<CharT> out(3, (CharT)'p');
+    size_t offset = 0;
+    bool ok = decode(input, out, &offset);
+    std::string ret = ok ? "ok" : "fail@" + std::to_string(offset);
+    for (CharT c : out)
+        ret += " " + std::to_string((uint32_t)c);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    long rounds = argc > 1 ? atol(argv[1]) : 200000;
+    unsigned seed = argc > 2 ? atoi(argv[2]) : std::random_device()();
+    std::mt19937 rng(seed);
+    std::cout << "rounds=" << rounds << " seed=" << seed << std::endl;
+
+    for (long r = 0; r < rounds; ++r)
+    {
+        bool valid;
+        std::string input = RandomInput(rng, valid);
+        bool ok = Same("ValidateUtf8", input, [&]() {
+                      size_t offset = 0;
+                      bool ok = StringUtil::ValidateUtf8(input, &offset);
+                      return ok ? std::string("ok") : "fail@" + std::to_string(offset);
+                  }) &&
+                  Same("Utf8ToUtf16", input, [&]() { return Decode(input, &StringUtil::Utf8ToUtf16); }) &&
+                  Same("Utf8ToUtf32", input, [&]() { return Decode(input, &StringUtil::Utf8ToUtf32); });
+        if (ok && valid)
+        {
+            std::u32string u32;
+            std::string back;
+            if (!StringUtil::Utf8ToUtf32(input, u32) || !StringUtil::Utf32ToUtf8(u32, back) || back != input)
+            {
+                std::cout << "[FAIL] round trip input=" << Hex(input) << std::endl;
+                ok = false;
+            }
+        }
+        if (!ok)
+            return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
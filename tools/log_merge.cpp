@@ -0,0 +1,32 @@
+#include <iostream>
+#include "../log.h"
+
+/*
+@brief 把ShardedFileLogAppender写出的分片文件按时间顺序归并到标准输出
+@details 用法：
+  log_merge <file>              归并file.<线程id>形式的全部分片
+  log_merge <shard> <shard>...  归并指定的分片文件
+*/
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " <file> | <shard> <shard>..." << std::endl;
+        return 1;
+    }
+    std::vector<std::string> shards;
+    if (argc == 2)
+    {
+        MyServer::ShardedFileLogAppender::ListShards(shards, argv[1]);
+        if (shards.empty())
+        {
+            std::cout << "no shard found for " << argv[1] << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        shards.assign(argv + 1, argv + argc);
+    }
+    return MyServer::ShardedFileLogAppender::MergeShards(shards, std::cout) ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include "trace.h"
+#include "util.h"
+#include "clock.h"
+
+namespace MyServer
+{
+    std::atomic<bool> Trace::s_enabled{true};
+
+    namespace
+    {
+        /**
+         * @brief 一条区间记录
+         * @details seq为奇数表示正在写入，写完后为2*(序号+1)；读者在拷贝前后各读一次seq，不一致或不是期望的序号就丢弃。
+         *          字段都用relaxed原子变量，x86上与普通读写相同
+         */
+        struct Slot
+        {
+            std::atomic<uint64_t> seq{0};
+            std::atomic<const char *> name{nullptr};
+            std::atomic<uint64_t> begin{0};
+            std::atomic<uint64_t> end{0};
+            std::atomic<uint64_t> fiber{0};
+        };
+
+        /**
+         * @brief 单线程的环形缓冲区，只有所属线程写入
+         */
+        struct Buffer
+        {
+            typedef std::shared_ptr<Buffer> ptr;
+
+            Buffer(size_t size) : mask(size - 1), slots(new Slot[size]) {}
+
+            pid_t tid = 0;
+            std::string name;
+            std::atomic<uint64_t> head{0};  // 下一条记录的序号
+            std::atomic<uint64_t> start{0}; // Clear时的head，之前的记录不再导出
+            std::atomic<bool> exited{false};
+            uint64_t mask;
+            std::unique_ptr<Slot[]> slots;
+        };
+
+        struct TraceState
+        {
+            std::mutex mutex;
+            std::vector<Buffer::ptr> buffers;
+            size_t bufferSize = 16384;
+        };
+
+        static TraceState &GetState()
+        {
+            static TraceState *s_state = new TraceState; // 线程退出时可能晚于静态对象析构，不析构
+            return *s_state;
+        }
+
+        /**
+         * @brief 线程退出时标记缓冲区，Clear时才释放，保证退出线程的记录仍能导出
+         */
+        struct BufferHolder
+        {
+            Buffer::ptr buffer;
+
+            ~BufferHolder()
+            {
+                if (buffer)
+                    buffer->exited = true;
+            }
+        };
+
+        static thread_local BufferHolder t_holder;
+        static thread_local Buffer *t_buffer = nullptr;
+
+        static Buffer *CreateBuffer()
+        {
+            TraceState &st = GetState();
+            std::lock_guard<std::mutex> lock(st.mutex);
+            Buffer::ptr buffer(new Buffer(st.bufferSize));
+            buffer->tid = GetThreadId();
+            buffer->name = GetThreadName();
+            st.buffers.push_back(buffer);
+            t_holder.buffer = buffer;
+            return buffer.get();
+        }
+
+        static void AppendJsonString(std::string &out, const char *str)
+        {
+            out.push_back('"');
+            for (const char *p = str; *p; ++p)
+            {
+                unsigned char c = *p;
+                if (c == '"' || c == '\\')
+                {
+                    out.push_back('\\');
+                    out.push_back(c);
+                }
+                else if (c < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out.append(buf);
+                }
+                else
+                {
+                    out.push_back(c);
+                }
+            }
+            out.push_back('"');
+        }
+
+        /**
+         * @brief 纳秒转为Chrome要求的微秒，保留3位小数
+         */
+        static void AppendMicros(std::string &out, uint64_t ns)
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%lu.%03lu", (unsigned long)(ns / 1000), (unsigned long)(ns % 1000));
+            out.append(buf);
+        }
+    }
+
+    void Trace::SetBufferSize(size_t events)
+    {
+        size_t size = 1;
+        while (size < events)
+            size <<= 1;
+        TraceState &st = GetState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.bufferSize = size;
+    }
+
+    uint64_t Trace::Now()
+    {
+        return Clock::MonotonicNS(Clock::TSC);
+    }
+
+    void Trace::Record(const char *name, uint64_t begin, uint64_t end)
+    {
+        Buffer *buffer = t_buffer;
+        if (!buffer)
+            buffer = t_buffer = CreateBuffer();
+        uint64_t idx = buffer->head.load(std::memory_order_relaxed);
+        Slot &slot = buffer->slots[idx & buffer->mask];
+        slot.seq.store(2 * idx + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.begin.store(begin, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.fiber.store(GetFiberId(), std::memory_order_relaxed);
+        slot.seq.store(2 * idx + 2, std::memory_order_release);
+        buffer->head.store(idx + 1, std::memory_order_release);
+    }
+
+    void Trace::Export(std::ostream &os)
+    {
+        std::vector<Buffer::ptr> buffers;
+        {
+            TraceState &st = GetState();
+            std::lock_guard<std::mutex> lock(st.mutex);
+            buffers = st.buffers;
+        }
+        pid_t pid = getpid();
+        std::string out;
+        out.append("{\"traceEvents\":[");
+        bool first = true;
+        for (auto &buffer : buffers)
+        {
+            std::string prefix = ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(buffer->tid);
+            out.append(first ? "\n" : ",\n");
+            first = false;
+            out.append("{\"name\":\"thread_name\",\"ph\":\"M\"");
+            out.append(prefix);
+            out.append(",\"args\":{\"name\":");
+            AppendJsonString(out, buffer->name.c_str());
+            out.append("}}");
+
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t size = buffer->mask + 1;
+            uint64_t idx = std::max(head > size ? head - size : 0, buffer->start.load(std::memory_order_relaxed));
+            for (; idx < head; ++idx)
+            {
+                Slot &slot = buffer->slots[idx & buffer->mask];
+                if (slot.seq.load(std::memory_order_acquire) != 2 * idx + 2)
+                    continue;
+                const char *name = slot.name.load(std::memory_order_relaxed);
+                uint64_t begin = slot.begin.load(std::memory_order_relaxed);
+                uint64_t end = slot.end.load(std::memory_order_relaxed);
+                uint64_t fiber = slot.fiber.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != 2 * idx + 2)
+                    continue; // 拷贝过程中被覆盖
+                out.append(",\n{\"name\":");
+                AppendJsonString(out, name);
+                out.append(",\"cat\":\"myserver\",\"ph\":\"X\",\"ts\":");
+                AppendMicros(out, begin);
+                out.append(",\"dur\":");
+                AppendMicros(out, end - begin);
+                out.append(prefix);
+                out.append(",\"args\":{\"fiber\":");
+                out.append(std::to_string(fiber));
+                out.append("}}");
+            }
+            os << out;
+            out.clear();
+        }
+        os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    bool Trace::ExportToFile(const std::string &file)
+    {
+        std::ofstream ofs;
+        if (!FSUtil::OpenForWrite(ofs, file, std::ios::trunc))
+        {
+            std::cout << "[ERROR] Trace::ExportToFile() open " << file << " error: " << strerror(errno) << std::endl;
+            return false;
+        }
+        Export(ofs);
+        return ofs.good();
+    }
+
+    void Trace::Clear()
+    {
+        TraceState &st = GetState();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        std::vector<Buffer::ptr> alive;
+        for (auto &buffer : st.buffers)
+        {
+            if (buffer->exited)
+                continue;
+            // 不修改其他线程正在写的记录，只移动导出起点
+            buffer->start = buffer->head.load(std::memory_order_acquire);
+            alive.push_back(buffer);
+        }
+        st.buffers.swap(alive);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+#include <atomic>
+
+namespace MyServer
+{
+    /**
+     * @brief 轻量级调用区间跟踪
+     * @details 每个线程把区间记录写入自己的环形缓冲区，写满后覆盖最旧的记录，写入路径上没有锁和内存分配；
+     *          时间戳取自Clock的TSC模式。Export把所有线程缓冲区中的记录导出为Chrome trace-event JSON，
+     *          可在chrome://tracing或Perfetto中查看。
+     *          一般通过MYSERVER_TRACE_SCOPE使用，只有定义了MYSERVER_TRACE_ENABLED时宏才会展开，否则没有任何开销
+     */
+    class Trace
+    {
+    public:
+        /**
+         * @brief 运行时开关，默认打开；关闭后区间不再记录，已有记录保留
+         */
+        static void SetEnabled(bool v) { s_enabled.store(v, std::memory_order_relaxed); }
+        static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief 设置之后新创建的线程缓冲区能容纳的记录数，向上取整到2的幂，默认16384
+         */
+        static void SetBufferSize(size_t events);
+
+        /**
+         * @brief 当前时间戳，单调纳秒
+         */
+        static uint64_t Now();
+
+        /**
+         * @brief 记录一个区间
+         * @param[in] name 区间名称，只保存指针，必须在导出前一直有效，一般是字符串字面量
+         * @param[in] begin 开始时间，取自Now()
+         * @param[in] end 结束时间，取自Now()
+         */
+        static void Record(const char *name, uint64_t begin, uint64_t end);
+
+        /**
+         * @brief 导出为Chrome trace-event JSON，每个区间一个"X"事件，并带线程名元数据
+         * @details 只读取缓冲区，不影响正在写入的线程；导出过程中被覆盖的记录会被跳过
+         */
+        static void Export(std::ostream &os);
+
+        /**
+         * @brief 导出到文件
+         * @return 是否成功
+         */
+        static bool ExportToFile(const std::string &file);
+
+        /**
+         * @brief 清空所有记录，并释放已退出线程的缓冲区
+         */
+        static void Clear();
+
+    private:
+        static std::atomic<bool> s_enabled;
+    };
+
+    /**
+     * @brief 构造时记录开始时间，析构时记录区间
+     */
+    class TraceScope
+    {
+    public:
+        explicit TraceScope(const char *name)
+            : m_name(name), m_begin(Trace::IsEnabled() ? Trace::Now() : 0)
+        {
+        }
+
+        ~TraceScope()
+        {
+            if (m_begin)
+                Trace::Record(m_name, m_begin, Trace::Now());
+        }
+
+        TraceScope(const TraceScope &) = delete;
+        TraceScope &operator=(const TraceScope &) = delete;
+
+    private:
+        const char *m_name;
+        uint64_t m_begin;
+    };
+}
+
+#define MYSERVER_TRACE_CONCAT_IMPL(a, b) a##b
+#define MYSERVER_TRACE_CONCAT(a, b) MYSERVER_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef MYSERVER_TRACE_ENABLED
+/**
+ * @brief 跟踪当前作用域，name必须是字符串字面量或生命周期足够长的字符串
+ */
+#define MYSERVER_TRACE_SCOPE(name) \
+    MyServer::TraceScope MYSERVER_TRACE_CONCAT(__myserver_trace_scope_, __LINE__)(name)
+#else
+#define MYSERVER_TRACE_SCOPE(name) \
+    do                             \
+    {                              \
+    } while (0)
+#endif
+
+/**
+ * @brief 以函数名作为区间名称跟踪当前作用域
+ */
+#define MYSERVER_TRACE_FUNCTION() MYSERVER_TRACE_SCOPE(__func__)
+
+#endif
@@ -5,11 +5,34 @@
 #include <signal.h> // for kill()
 #include <sys/syscall.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h> // for PATH_MAX
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1) // glibc 2.28之前没有定义，取值见linux/fs.h
+#endif
 #include <execinfo.h> // for backtrace()
+#include <dlfcn.h>    // for dladdr()
 #include <cxxabi.h>   // for abi::__cxa_demangle()
-#include <algorithm>  // for std::transform()
+#include <algorithm>
 #include <sstream>
+#include <charconv>
+#include <deque>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <unordered_map>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // SSE2/AVX2
+#endif
 #include "util.h"
+#include "clock.h"
+#include "intern.h"
+#include "thread_registry.h"
 
 namespace MyServer
 {
@@ -25,60 +48,80 @@ namespace MyServer
 
     uint64_t GetElapsedMS()
     {
-        struct timespec ts = {0};
-        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-        return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        return Clock::MonotonicMS();
     }
 
     std::string GetThreadName()
     {
-        char *thread_name = nullptr;
-        pthread_getname_np(pthread_self(), thread_name, 16);
+        char thread_name[16] = {0}; // 线程名最长16字节，包括结尾的'\0'
+        pthread_getname_np(pthread_self(), thread_name, sizeof(thread_name));
         return std::string(thread_name);
     }
 
+    static thread_local uint32_t t_thread_name_id = UINT32_MAX; // UINT32_MAX表示尚未缓存
+
+    uint32_t GetThreadNameId()
+    {
+        if (t_thread_name_id == UINT32_MAX)
+            t_thread_name_id = SymbolTable::Intern(GetThreadName());
+        return t_thread_name_id;
+    }
+
     void SetThreadName(const std::string &name)
     {
         pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        t_thread_name_id = SymbolTable::Intern(GetThreadName());
     }
 
-    static std::string demangle(const char *str)
+    __attribute__((noinline)) int CaptureStack(void **frames, int size, int skip)
     {
-        std::string rt;
-        rt.resize(256);
-        if (1 == sscanf(str, "%*[^(]%*[^_]%255[^)+]", &rt[0]))
+        int n = backtrace(frames, size);
+        int drop = std::min(n, skip + 1); // 加上CaptureStack自身
+        memmove(frames, frames + drop, (n - drop) * sizeof(void *));
+        return n - drop;
+    }
+
+    std::string SymbolizeFrame(void *addr)
+    {
+        Dl_info info;
+        if (!dladdr(addr, &info) || !info.dli_fname)
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%p", addr);
+            return buf;
+        }
+        if (info.dli_sname)
         {
-            char *v = abi::__cxa_demangle(&rt[0], nullptr, nullptr, nullptr);
+            char *v = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, nullptr);
             if (v)
             {
                 std::string result(v);
                 free(v);
                 return result;
             }
+            return info.dli_sname;
         }
-        if (1 == sscanf(str, "%255s", &rt[0]))
+        const char *module = strrchr(info.dli_fname, '/');
+        module = module ? module + 1 : info.dli_fname;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "(+%#lx)", (unsigned long)((char *)addr - (char *)info.dli_fbase));
+        return std::string(module) + buf;
+    }
+
+    void SymbolizeStack(std::vector<std::string> &bt, void *const *frames, int size)
+    {
+        for (int i = 0; i < size; i++)
         {
-            return rt;
+            bt.push_back(SymbolizeFrame(frames[i]));
         }
-        return str;
     }
 
     void Backtrace(std::vector<std::string> &bt, int size, int skip)
     {
-        void **array = (void **)malloc(sizeof(void *) * size);
-        size_t s = backtrace(array, size);
-        char **strings = backtrace_symbols(array, s);
-        if (strings == NULL)
-        {
-            std::cout << "backtrace_synbols error";
-            return;
-        }
-        for (size_t i = skip; i < s; i++)
-        {
-            bt.push_back(demangle(strings[i]));
-        }
-        free(strings);
-        free(array);
+        // 多抓一层给CaptureStack自身，skip同样从Backtrace自身算起
+        std::vector<void *> frames(size + 1);
+        int n = CaptureStack(frames.data(), size + 1, skip);
+        SymbolizeStack(bt, frames.data(), n);
     }
 
     std::string BacktraceToString(int size, int skip, const std::string &prefix)
@@ -95,32 +138,165 @@ namespace MyServer
 
     uint64_t GetCurrentMS()
     {
-        struct timeval tv;
-        gettimeofday(&tv, nullptr);
-        return tv.tv_sec * 1000ul + tv.tv_usec / 1000;
+        return Clock::NowMS();
     }
 
     uint64_t GetCurrentUS()
     {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        return tv.tv_sec * 1000 * 1000ul + tv.tv_usec;
+        return Clock::NowUS();
+    }
+
+    static std::atomic<bool> s_simd_enabled{true}; // 见StringUtil::SetSimdEnabled
+
+    static inline bool SimdEnabled()
+    {
+        return s_simd_enabled.load(std::memory_order_relaxed);
+    }
+
+    void StringUtil::SetSimdEnabled(bool enabled)
+    {
+        s_simd_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool StringUtil::IsSimdEnabled()
+    {
+        return SimdEnabled();
+    }
+
+    static inline char AsciiLower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    static inline char AsciiUpper(char c)
+    {
+        return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // 把[lo, hi]区间内的字节异或0x20，即切换大小写
+    static inline __m128i AsciiFlipCase(__m128i x, char lo, char hi)
+    {
+        __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1)),
+                                         _mm_cmplt_epi8(x, _mm_set1_epi8(hi + 1)));
+        return _mm_xor_si128(x, _mm_and_si128(in_range, _mm_set1_epi8(0x20)));
+    }
+#endif
+
+    // src和dst可以相同
+    static void AsciiConvertCase(const char *src, char *dst, size_t len, bool upper)
+    {
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        char lo = upper ? 'a' : 'A';
+        char hi = upper ? 'z' : 'Z';
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), AsciiFlipCase(x, lo, hi));
+        }
+#endif
+        for (; i < len; ++i)
+            dst[i] = upper ? AsciiUpper(src[i]) : AsciiLower(src[i]);
     }
 
     std::string ToLower(const std::string &str)
     {
-        std::string ret = str;
-        std::transform(ret.begin(), ret.end(), ret.begin(), tolower);
+        std::string ret;
+        AppendLower(ret, str);
         return ret;
     }
 
     std::string ToUpper(const std::string &str)
     {
-        std::string ret = str;
-        std::transform(ret.begin(), ret.end(), ret.begin(), toupper);
+        std::string ret;
+        AppendUpper(ret, str);
         return ret;
     }
 
+    void ToUpperInPlace(char *str, size_t len)
+    {
+        AsciiConvertCase(str, str, len, true);
+    }
+
+    void ToUpperInPlace(std::string &str)
+    {
+        AsciiConvertCase(&str[0], &str[0], str.size(), true);
+    }
+
+    void ToLowerInPlace(char *str, size_t len)
+    {
+        AsciiConvertCase(str, str, len, false);
+    }
+
+    void ToLowerInPlace(std::string &str)
+    {
+        AsciiConvertCase(&str[0], &str[0], str.size(), false);
+    }
+
+    void AppendUpper(std::string &out, std::string_view str)
+    {
+        size_t pos = out.size();
+        out.resize(pos + str.size());
+        AsciiConvertCase(str.data(), &out[pos], str.size(), true);
+    }
+
+    void AppendLower(std::string &out, std::string_view str)
+    {
+        size_t pos = out.size();
+        out.resize(pos + str.size());
+        AsciiConvertCase(str.data(), &out[pos], str.size(), false);
+    }
+
+    // 返回忽略大小写后第一个不同字节的位置，前n字节都相同时返回n
+    static size_t MismatchIgnoreCase(const char *a, const char *b, size_t n)
+    {
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i x = AsciiFlipCase(_mm_loadu_si128((const __m128i *)(a + i)), 'A', 'Z');
+            __m128i y = AsciiFlipCase(_mm_loadu_si128((const __m128i *)(b + i)), 'A', 'Z');
+            unsigned mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xffff;
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+#endif
+        while (i < n && AsciiLower(a[i]) == AsciiLower(b[i]))
+            ++i;
+        return i;
+    }
+
+    int CompareIgnoreCase(std::string_view lhs, std::string_view rhs)
+    {
+        size_t n = std::min(lhs.size(), rhs.size());
+        size_t i = MismatchIgnoreCase(lhs.data(), rhs.data(), n);
+        if (i < n)
+            return (unsigned char)AsciiLower(lhs[i]) - (unsigned char)AsciiLower(rhs[i]);
+        if (lhs.size() == rhs.size())
+            return 0;
+        return lhs.size() < rhs.size() ? -1 : 1;
+    }
+
+    bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs)
+    {
+        return lhs.size() == rhs.size() && MismatchIgnoreCase(lhs.data(), rhs.data(), lhs.size()) == lhs.size();
+    }
+
+    uint64_t HashIgnoreCase(std::string_view str)
+    {
+        // 分块转小写后串联哈希，不分配内存
+        char buf[256];
+        uint64_t h = str.size();
+        for (size_t i = 0; i < str.size(); i += sizeof(buf))
+        {
+            size_t n = std::min(sizeof(buf), str.size() - i);
+            AsciiConvertCase(str.data() + i, buf, n, false);
+            h = Hash64(buf, n, h);
+        }
+        return h;
+    }
+
     std::string Time2Str(time_t ts, const std::string &format)
     {
         struct tm tm;
@@ -139,39 +315,2063 @@ namespace MyServer
         return mktime(&tm);
     }
 
-    void FSUtil::ListAllFile(std::vector<std::string> &files, const std::string &path, const std::string &subfix)
+    static inline bool IsAsciiSpace(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    template <class T>
+    static TypeUtil::ParseResult ParseNumber(std::string_view str, T &value, size_t *consumed)
+    {
+        const char *begin = str.data();
+        const char *end = begin + str.size();
+        const char *p = begin;
+        while (p < end && IsAsciiSpace(*p))
+            ++p;
+        // from_chars不接受'+'，由这里跳过；"+-5"、"++5"这样连着两个符号的与atoi一样视为非法
+        if (p < end && *p == '+' && ++p < end && (*p == '-' || *p == '+'))
+            p = end;
+        T v;
+        std::from_chars_result rt = std::from_chars(p, end, v);
+        if (rt.ec == std::errc::invalid_argument)
+        {
+            if (consumed)
+                *consumed = 0;
+            return TypeUtil::PARSE_INVALID;
+        }
+        if (consumed)
+            *consumed = rt.ptr - begin;
+        if (rt.ec == std::errc::result_out_of_range)
+            return TypeUtil::PARSE_OVERFLOW;
+        value = v;
+        return rt.ptr == end ? TypeUtil::PARSE_OK : TypeUtil::PARSE_PARTIAL;
+    }
+
+    TypeUtil::ParseResult TypeUtil::Parse(std::string_view str, int32_t &value, size_t *consumed)
+    {
+        return ParseNumber(str, value, consumed);
+    }
+
+    TypeUtil::ParseResult TypeUtil::Parse(std::string_view str, int64_t &value, size_t *consumed)
+    {
+        return ParseNumber(str, value, consumed);
+    }
+
+    TypeUtil::ParseResult TypeUtil::Parse(std::string_view str, uint32_t &value, size_t *consumed)
+    {
+        return ParseNumber(str, value, consumed);
+    }
+
+    TypeUtil::ParseResult TypeUtil::Parse(std::string_view str, uint64_t &value, size_t *consumed)
+    {
+        return ParseNumber(str, value, consumed);
+    }
+
+    TypeUtil::ParseResult TypeUtil::Parse(std::string_view str, double &value, size_t *consumed)
+    {
+        return ParseNumber(str, value, consumed);
+    }
+
+    template <class T>
+    static TypeUtil::ParseResult ParseNumberList(std::string_view str, char delim, std::vector<T> &values, size_t *error_offset)
     {
-        if (access(path.c_str(), 0) != 0)
-            return;
-        DIR *dir = opendir(path.c_str());
-        if (dir == nullptr)
-            return;
-        struct dirent *dp = nullptr;
-        while ((dp = readdir(dir)) != nullptr)
+        if (StringUtil::TrimView(str).empty())
+            return TypeUtil::PARSE_OK;
+        const char *end = str.data() + str.size();
+        for (const char *item = str.data();; ++item)
         {
-            if (dp->d_type == DT_DIR)
+            const char *stop = (const char *)memchr(item, delim, end - item);
+            if (stop == nullptr)
+                stop = end;
+            // ParseNumber跳过了开头的空白，这里只需确认数值后面剩下的都是空白
+            T v;
+            size_t consumed = 0;
+            TypeUtil::ParseResult rt = ParseNumber(std::string_view(item, stop - item), v, &consumed);
+            if (rt == TypeUtil::PARSE_PARTIAL)
             {
-                if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
-                    continue;
-                ListAllFile(files, path + "/" + dp->d_name, subfix);
+                const char *p = item + consumed;
+                while (p < stop && IsAsciiSpace(*p))
+                    ++p;
+                if (p == stop)
+                    rt = TypeUtil::PARSE_OK;
+            }
+            if (rt != TypeUtil::PARSE_OK)
+            {
+                if (error_offset)
+                    *error_offset = item - str.data();
+                return rt;
+            }
+            values.push_back(v);
+            if (stop == end)
+                return TypeUtil::PARSE_OK;
+            item = stop;
+        }
+    }
+
+    TypeUtil::ParseResult TypeUtil::ParseList(std::string_view str, char delim, std::vector<int64_t> &values, size_t *error_offset)
+    {
+        return ParseNumberList(str, delim, values, error_offset);
+    }
+
+    TypeUtil::ParseResult TypeUtil::ParseList(std::string_view str, char delim, std::vector<double> &values, size_t *error_offset)
+    {
+        return ParseNumberList(str, delim, values, error_offset);
+    }
+
+    int8_t TypeUtil::ToChar(std::string_view str)
+    {
+        return str.empty() ? 0 : *str.begin();
+    }
+
+    int64_t TypeUtil::Atoi(std::string_view str)
+    {
+        int64_t v = 0;
+        ParseResult rt = Parse(str, v);
+        return (rt == PARSE_OK || rt == PARSE_PARTIAL) ? v : 0;
+    }
+
+    double TypeUtil::Atof(std::string_view str)
+    {
+        double v = 0;
+        ParseResult rt = Parse(str, v);
+        return (rt == PARSE_OK || rt == PARSE_PARTIAL) ? v : 0;
+    }
+
+    int8_t TypeUtil::ToChar(const char *str)
+    {
+        return str == nullptr ? 0 : str[0];
+    }
+
+    int64_t TypeUtil::Atoi(const char *str)
+    {
+        return str == nullptr ? 0 : Atoi(std::string_view(str));
+    }
+
+    double TypeUtil::Atof(const char *str)
+    {
+        return str == nullptr ? 0 : Atof(std::string_view(str));
+    }
+
+    std::string StringUtil::Format(const char *fmt, ...)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        std::string ret = Formatv(fmt, ap);
+        va_end(ap);
+        return ret;
+    }
+
+    std::string StringUtil::Formatv(const char *fmt, va_list ap)
+    {
+        char buf[512];
+        va_list ap2;
+        va_copy(ap2, ap);
+        int len = vsnprintf(buf, sizeof(buf), fmt, ap2);
+        va_end(ap2);
+        if (len < 0)
+            return "";
+        if (len < (int)sizeof(buf))
+            return std::string(buf, len);
+        std::string ret(len, '\0');
+        vsnprintf(&ret[0], len + 1, fmt, ap);
+        return ret;
+    }
+
+    static inline bool IsUrlUnreserved(unsigned char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '-' || c == '.' || c == '_' || c == '~';
+    }
+
+    static inline int HexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // 返回开头连续不需要编码的字节数
+    static size_t UrlSafePrefixScalar(const char *p, size_t n)
+    {
+        size_t i = 0;
+        while (i < n && IsUrlUnreserved(p[i]))
+            ++i;
+        return i;
+    }
+
+    // 返回第一个'%'（space_as_plus时还有'+'）的位置，没有时返回n
+    static size_t UrlSpecialScalar(const char *p, size_t n, bool plus)
+    {
+        size_t i = 0;
+        while (i < n && p[i] != '%' && !(plus && p[i] == '+'))
+            ++i;
+        return i;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // 有符号字节比较，>= 0x80的字节为负数，不会落在任何ASCII区间内
+    static size_t UrlSafePrefixSSE2(const char *p, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+            __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+            __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                          _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('0' - 1)),
+                                          _mm_cmplt_epi8(x, _mm_set1_epi8('9' + 1)));
+            __m128i sym = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('-')),
+                                                    _mm_cmpeq_epi8(x, _mm_set1_epi8('.'))),
+                                       _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('_')),
+                                                    _mm_cmpeq_epi8(x, _mm_set1_epi8('~'))));
+            __m128i safe = _mm_or_si128(_mm_or_si128(alpha, digit), sym);
+            unsigned mask = ~_mm_movemask_epi8(safe) & 0xffff;
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        return i + UrlSafePrefixScalar(p + i, n - i);
+    }
+
+    __attribute__((target("avx2"))) static size_t UrlSafePrefixAVX2(const char *p, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+            __m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+            __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+            __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('0' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), x));
+            __m256i sym = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('-')),
+                                                          _mm256_cmpeq_epi8(x, _mm256_set1_epi8('.'))),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')),
+                                                          _mm256_cmpeq_epi8(x, _mm256_set1_epi8('~'))));
+            __m256i safe = _mm256_or_si256(_mm256_or_si256(alpha, digit), sym);
+            unsigned mask = ~(unsigned)_mm256_movemask_epi8(safe);
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        // 剩余部分交给非VEX编码的SSE2代码，先清掉ymm高位，避免AVX与SSE切换的性能损失
+        _mm256_zeroupper();
+        return i + UrlSafePrefixSSE2(p + i, n - i);
+    }
+
+    static size_t UrlSpecialSSE2(const char *p, size_t n, bool plus)
+    {
+        size_t i = 0;
+        __m128i percent = _mm_set1_epi8('%');
+        __m128i plus_sign = _mm_set1_epi8(plus ? '+' : '%');
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+            unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, percent), _mm_cmpeq_epi8(x, plus_sign)));
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        return i + UrlSpecialScalar(p + i, n - i, plus);
+    }
+
+    __attribute__((target("avx2"))) static size_t UrlSpecialAVX2(const char *p, size_t n, bool plus)
+    {
+        size_t i = 0;
+        __m256i percent = _mm256_set1_epi8('%');
+        __m256i plus_sign = _mm256_set1_epi8(plus ? '+' : '%');
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+            unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, percent), _mm256_cmpeq_epi8(x, plus_sign)));
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        _mm256_zeroupper();
+        return i + UrlSpecialSSE2(p + i, n - i, plus);
+    }
+
+    static const bool s_has_avx2 = __builtin_cpu_supports("avx2");
+
+    // 不足一个向量的输入，以及紧挨着的转义字节（如连续编码的UTF-8），逐字节判断比启动一次向量扫描更快
+    static inline size_t UrlSafePrefix(const char *p, size_t n)
+    {
+        if (n < 16 || !SimdEnabled())
+            return UrlSafePrefixScalar(p, n);
+        if (!IsUrlUnreserved(p[0]))
+            return 0;
+        return s_has_avx2 ? UrlSafePrefixAVX2(p, n) : UrlSafePrefixSSE2(p, n);
+    }
+
+    static inline size_t UrlSpecial(const char *p, size_t n, bool plus)
+    {
+        if (n < 16 || !SimdEnabled())
+            return UrlSpecialScalar(p, n, plus);
+        if (p[0] == '%' || (plus && p[0] == '+'))
+            return 0;
+        return s_has_avx2 ? UrlSpecialAVX2(p, n, plus) : UrlSpecialSSE2(p, n, plus);
+    }
+#else
+    static inline size_t UrlSafePrefix(const char *p, size_t n)
+    {
+        return UrlSafePrefixScalar(p, n);
+    }
+
+    static inline size_t UrlSpecial(const char *p, size_t n, bool plus)
+    {
+        return UrlSpecialScalar(p, n, plus);
+    }
+#endif
+
+    std::string StringUtil::UrlEncode(std::string_view str, bool space_as_plus)
+    {
+        std::string ret;
+        UrlEncodeTo(ret, str, space_as_plus);
+        return ret;
+    }
+
+    void StringUtil::UrlEncodeTo(std::string &out, std::string_view str, bool space_as_plus)
+    {
+        static const char s_hex[] = "0123456789ABCDEF";
+        const char *p = str.data();
+        size_t n = str.size();
+        out.reserve(out.size() + n);
+        while (n > 0)
+        {
+            size_t safe = UrlSafePrefix(p, n);
+            out.append(p, safe);
+            p += safe;
+            n -= safe;
+            if (n == 0)
+                break;
+            unsigned char c = *p;
+            if (c == ' ' && space_as_plus)
+            {
+                out.push_back('+');
+            }
+            else
+            {
+                char esc[3] = {'%', s_hex[c >> 4], s_hex[c & 0xf]};
+                out.append(esc, 3);
+            }
+            ++p;
+            --n;
+        }
+    }
+
+    std::string StringUtil::UrlDecode(std::string_view str, bool space_as_plus)
+    {
+        std::string ret;
+        UrlDecodeTo(ret, str, space_as_plus);
+        return ret;
+    }
+
+    void StringUtil::UrlDecodeTo(std::string &out, std::string_view str, bool space_as_plus)
+    {
+        const char *p = str.data();
+        size_t n = str.size();
+        out.reserve(out.size() + n);
+        while (n > 0)
+        {
+            size_t k = UrlSpecial(p, n, space_as_plus);
+            out.append(p, k);
+            p += k;
+            n -= k;
+            if (n == 0)
+                break;
+            int hi, lo;
+            if (*p == '+')
+            {
+                out.push_back(' ');
+            }
+            else if (n >= 3 && (hi = HexValue(p[1])) >= 0 && (lo = HexValue(p[2])) >= 0)
+            {
+                out.push_back((char)(hi << 4 | lo));
+                p += 2;
+                n -= 2;
+            }
+            else
+            {
+                out.push_back('%');
+            }
+            ++p;
+            --n;
+        }
+    }
+
+    size_t StringUtil::UrlDecodeInPlace(char *str, size_t len, bool space_as_plus)
+    {
+        size_t r = 0, w = 0;
+        while (r < len)
+        {
+            size_t k = UrlSpecial(str + r, len - r, space_as_plus);
+            if (w != r)
+                memmove(str + w, str + r, k);
+            r += k;
+            w += k;
+            if (r == len)
+                break;
+            int hi, lo;
+            if (str[r] == '+')
+            {
+                str[w++] = ' ';
+            }
+            else if (r + 2 < len && (hi = HexValue(str[r + 1])) >= 0 && (lo = HexValue(str[r + 2])) >= 0)
+            {
+                str[w++] = (char)(hi << 4 | lo);
+                r += 2;
+            }
+            else
+            {
+                str[w++] = '%';
+            }
+            ++r;
+        }
+        return w;
+    }
+
+    void StringUtil::UrlDecodeInPlace(std::string &str, bool space_as_plus)
+    {
+        str.resize(UrlDecodeInPlace(&str[0], str.size(), space_as_plus));
+    }
+
+    static const char s_base64_std[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static const char s_base64_url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+    /**
+     * @brief base64字符到6位值的反查表，不在字母表中的字符为-1
+     */
+    struct Base64DecodeTable
+    {
+        int8_t value[256];
+
+        explicit Base64DecodeTable(const char *alphabet)
+        {
+            memset(value, -1, sizeof(value));
+            for (int i = 0; i < 64; i++)
+            {
+                value[(uint8_t)alphabet[i]] = i;
+            }
+        }
+    };
+
+    static const Base64DecodeTable s_base64_std_table(s_base64_std);
+    static const Base64DecodeTable s_base64_url_table(s_base64_url);
+
+    // 编码：每3字节输入得到4个字符，返回消耗的输入长度
+    static size_t Base64EncodeScalar(char *dst, const uint8_t *src, size_t n, const char *alphabet)
+    {
+        size_t i = 0;
+        for (; i + 3 <= n; i += 3)
+        {
+            uint32_t v = src[i] << 16 | src[i + 1] << 8 | src[i + 2];
+            dst[0] = alphabet[v >> 18];
+            dst[1] = alphabet[(v >> 12) & 0x3f];
+            dst[2] = alphabet[(v >> 6) & 0x3f];
+            dst[3] = alphabet[v & 0x3f];
+            dst += 4;
+        }
+        return i;
+    }
+
+    // 解码：每4个字符得到3字节，遇到非法字符（包括'='）时停止，返回消耗的字符数
+    static size_t Base64DecodeScalar(uint8_t *dst, const char *src, size_t n, const int8_t *table)
+    {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            int a = table[(uint8_t)src[i]], b = table[(uint8_t)src[i + 1]];
+            int c = table[(uint8_t)src[i + 2]], d = table[(uint8_t)src[i + 3]];
+            if ((a | b | c | d) < 0)
+                break;
+            uint32_t v = a << 18 | b << 12 | c << 6 | d;
+            dst[0] = v >> 16;
+            dst[1] = v >> 8;
+            dst[2] = v;
+            dst += 3;
+        }
+        return i;
+    }
+
+    // 编码：每字节得到2个字符
+    static void HexEncodeScalar(char *dst, const uint8_t *src, size_t n, const char *digits)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            dst[2 * i] = digits[src[i] >> 4];
+            dst[2 * i + 1] = digits[src[i] & 0x0f];
+        }
+    }
+
+    /**
+     * @brief 十六进制字符到4位值的反查表，非十六进制字符为-1；随机数据上比逐个比较范围少了分支预测失败
+     */
+    struct HexDecodeTable
+    {
+        int8_t value[256];
+
+        HexDecodeTable()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                value[i] = HexValue((char)i);
+            }
+        }
+    };
+
+    static const HexDecodeTable s_hex_table;
+
+    // 解码：每2个字符得到1字节，遇到非法字符时停止，返回解码的字节数
+    static size_t HexDecodeScalar(uint8_t *dst, const char *src, size_t n)
+    {
+        const int8_t *table = s_hex_table.value;
+        size_t i = 0;
+        for (; i < n; i++)
+        {
+            int hi = table[(uint8_t)src[2 * i]], lo = table[(uint8_t)src[2 * i + 1]];
+            if ((hi | lo) < 0)
+                break;
+            dst[i] = hi << 4 | lo;
+        }
+        return i;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // base64编码（Muła、Lemire）：读16字节、用其中12字节，编码为16个字符；src至少可读16字节
+    __attribute__((target("ssse3"))) static size_t Base64EncodeSSSE3(char *dst, const uint8_t *src, size_t n, bool url)
+    {
+        // 0~25 +'A'，26~51 +'a'-26，52~61 +'0'-52，62和63映射到各自字母表的最后两个字符
+        const __m128i lut = url ? _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, '-' - 62, '_' - 63, 0, 0)
+                                : _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, '+' - 62, '/' - 63, 0, 0);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 12)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+            // 每3字节扩展到4字节，再用乘法把4个6位字段移到各自字节的低位
+            in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+            __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+            __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+            __m128i indices = _mm_or_si128(t0, t1);
+            __m128i offset = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+            offset = _mm_sub_epi8(offset, _mm_cmpgt_epi8(indices, _mm_set1_epi8(25)));
+            _mm_storeu_si128((__m128i *)dst, _mm_add_epi8(indices, _mm_shuffle_epi8(lut, offset)));
+            dst += 16;
+        }
+        return i;
+    }
+
+    // base64解码（Muła）：按高低半字节查表校验并换算16个字符，拼成12字节；dst至少可写16字节
+    __attribute__((target("ssse3"))) static size_t Base64DecodeSSSE3(uint8_t *dst, const char *src, size_t n)
+    {
+        const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                             0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                             0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i mask_2f = _mm_set1_epi8(0x2f);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i str = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+            __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+            __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+            __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+            // 合法字符的两个查表结果没有公共位，包括'='在内的非法字符交给标量代码处理
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff)
+                break;
+            __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(str, mask_2f), hi_nibbles));
+            str = _mm_add_epi8(str, roll);
+            __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+            __m128i out = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+            out = _mm_shuffle_epi8(out, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            _mm_storeu_si128((__m128i *)dst, out);
+            dst += 12;
+        }
+        return i;
+    }
+
+    __attribute__((target("ssse3"))) static size_t HexEncodeSSSE3(char *dst, const uint8_t *src, size_t n, const char *digits)
+    {
+        const __m128i lut = _mm_loadu_si128((const __m128i *)digits);
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+            __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(in, mask));
+            _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+            _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+        }
+        return i;
+    }
+
+    // 16个十六进制字符换算为半字节值，非法字符的位图累加到invalid
+    __attribute__((target("ssse3"))) static inline __m128i HexNibbles(__m128i x, unsigned &invalid)
+    {
+        __m128i digit = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+        __m128i alpha = _mm_sub_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+        invalid |= ~_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) & 0xffff;
+        return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                            _mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+    }
+
+    // 每次32个字符解码为16字节，遇到非法字符时停止，返回解码的字节数
+    __attribute__((target("ssse3"))) static size_t HexDecodeSSSE3(uint8_t *dst, const char *src, size_t n)
+    {
+        const __m128i weights = _mm_set1_epi16(0x0110); // 高半字节乘16，低半字节乘1
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            unsigned invalid = 0;
+            __m128i a = HexNibbles(_mm_loadu_si128((const __m128i *)(src + 2 * i)), invalid);
+            __m128i b = HexNibbles(_mm_loadu_si128((const __m128i *)(src + 2 * i + 16)), invalid);
+            if (invalid)
+                break;
+            __m128i out = _mm_packus_epi16(_mm_maddubs_epi16(a, weights), _mm_maddubs_epi16(b, weights));
+            _mm_storeu_si128((__m128i *)(dst + i), out);
+        }
+        return i;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("sse4.2"))) static uint32_t Crc32cSSE42(uint32_t crc, const uint8_t *p, size_t n)
+    {
+        uint64_t c = crc;
+        for (; n >= 8; p += 8, n -= 8)
+        {
+            uint64_t v;
+            memcpy(&v, p, 8);
+            c = _mm_crc32_u64(c, v);
+        }
+        crc = (uint32_t)c;
+        for (; n > 0; ++p, --n)
+        {
+            crc = _mm_crc32_u8(crc, *p);
+        }
+        return crc;
+    }
+#else
+    __attribute__((target("sse4.2"))) static uint32_t Crc32cSSE42(uint32_t crc, const uint8_t *p, size_t n)
+    {
+        for (; n >= 4; p += 4, n -= 4)
+        {
+            uint32_t v;
+            memcpy(&v, p, 4);
+            crc = _mm_crc32_u32(crc, v);
+        }
+        for (; n > 0; ++p, --n)
+        {
+            crc = _mm_crc32_u8(crc, *p);
+        }
+        return crc;
+    }
+#endif
+
+    static const bool s_has_ssse3 = __builtin_cpu_supports("ssse3");
+    static const bool s_has_sse42 = __builtin_cpu_supports("sse4.2");
+#endif
+
+    /**
+     * @brief CRC32C slicing-by-8查表，反射多项式0x82F63B78
+     */
+    struct Crc32cTable
+    {
+        uint32_t table[8][256];
+
+        Crc32cTable()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c >> 1) ^ (0x82F63B78 & (0 - (c & 1)));
+                }
+                table[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                for (int k = 1; k < 8; k++)
+                {
+                    table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+                }
+            }
+        }
+    };
+
+    static uint32_t Crc32cSoftware(uint32_t crc, const uint8_t *p, size_t n)
+    {
+        static const Crc32cTable s_table;
+        const uint32_t(*t)[256] = s_table.table;
+        for (; n >= 8; p += 8, n -= 8)
+        {
+            uint32_t lo, hi;
+            memcpy(&lo, p, 4);
+            memcpy(&hi, p + 4, 4);
+            lo ^= crc;
+            crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        }
+        for (; n > 0; ++p, --n)
+        {
+            crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+        }
+        return crc;
+    }
+
+    void StringUtil::Base64EncodeTo(std::string &out, std::string_view data, bool url)
+    {
+        const uint8_t *src = (const uint8_t *)data.data();
+        size_t n = data.size();
+        const char *alphabet = url ? s_base64_url : s_base64_std;
+        size_t old = out.size();
+        out.resize(old + (n + 2) / 3 * 4);
+        char *dst = &out[old];
+
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if (s_has_ssse3 && SimdEnabled())
+            i = Base64EncodeSSSE3(dst, src, n, url);
+#endif
+        dst += i / 3 * 4;
+        i += Base64EncodeScalar(dst, src + i, n - i, alphabet);
+        dst = &out[old] + i / 3 * 4;
+        size_t rest = n - i;
+        if (rest)
+        {
+            uint32_t v = src[i] << 16 | (rest == 2 ? src[i + 1] << 8 : 0);
+            dst[0] = alphabet[v >> 18];
+            dst[1] = alphabet[(v >> 12) & 0x3f];
+            dst[2] = rest == 2 ? alphabet[(v >> 6) & 0x3f] : '=';
+            dst[3] = '=';
+        }
+    }
+
+    std::string StringUtil::Base64Encode(std::string_view data, bool url)
+    {
+        std::string ret;
+        Base64EncodeTo(ret, data, url);
+        return ret;
+    }
+
+    bool StringUtil::Base64DecodeTo(std::string &out, std::string_view str, bool url)
+    {
+        const int8_t *table = url ? s_base64_url_table.value : s_base64_std_table.value;
+        size_t n = str.size();
+        // 去掉填充后剩余长度除4余1不可能是合法编码
+        size_t pad = 0;
+        if (n % 4 == 0 && n >= 4)
+            pad = (str[n - 1] == '=') + (str[n - 2] == '=');
+        n -= pad;
+        if (n % 4 == 1)
+            return false;
+
+        size_t old = out.size();
+        out.resize(old + n / 4 * 3 + 16); // 多留16字节给SIMD的整块写入
+        uint8_t *dst = (uint8_t *)&out[old];
+        const char *src = str.data();
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if (s_has_ssse3 && !url && SimdEnabled())
+            i = Base64DecodeSSSE3(dst, src, n);
+#endif
+        i += Base64DecodeScalar(dst + i / 4 * 3, src + i, n - i, table);
+        size_t len = i / 4 * 3;
+        size_t rest = n - i;
+        if (rest >= 4)
+        {
+            out.resize(old);
+            return false;
+        }
+        if (rest)
+        {
+            int a = table[(uint8_t)src[i]], b = table[(uint8_t)src[i + 1]];
+            int c = rest == 3 ? table[(uint8_t)src[i + 2]] : 0;
+            if ((a | b | c) < 0)
+            {
+                out.resize(old);
+                return false;
+            }
+            uint32_t v = a << 18 | b << 12 | c << 6;
+            dst[len++] = v >> 16;
+            if (rest == 3)
+                dst[len++] = v >> 8;
+        }
+        out.resize(old + len);
+        return true;
+    }
+
+    std::string StringUtil::Base64Decode(std::string_view str, bool url)
+    {
+        std::string ret;
+        if (!Base64DecodeTo(ret, str, url))
+            return std::string();
+        return ret;
+    }
+
+    void StringUtil::HexEncodeTo(std::string &out, std::string_view data, bool upper)
+    {
+        static const char s_lower[] = "0123456789abcdef";
+        static const char s_upper[] = "0123456789ABCDEF";
+        const char *digits = upper ? s_upper : s_lower;
+        const uint8_t *src = (const uint8_t *)data.data();
+        size_t n = data.size();
+        size_t old = out.size();
+        out.resize(old + 2 * n);
+        char *dst = &out[old];
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if (s_has_ssse3 && SimdEnabled())
+            i = HexEncodeSSSE3(dst, src, n, digits);
+#endif
+        HexEncodeScalar(dst + 2 * i, src + i, n - i, digits);
+    }
+
+    std::string StringUtil::HexEncode(std::string_view data, bool upper)
+    {
+        std::string ret;
+        HexEncodeTo(ret, data, upper);
+        return ret;
+    }
+
+    bool StringUtil::HexDecodeTo(std::string &out, std::string_view str)
+    {
+        if (str.size() % 2)
+            return false;
+        size_t n = str.size() / 2;
+        size_t old = out.size();
+        out.resize(old + n);
+        uint8_t *dst = (uint8_t *)&out[old];
+        size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+        if (s_has_ssse3 && SimdEnabled())
+            i = HexDecodeSSSE3(dst, str.data(), n);
+#endif
+        i += HexDecodeScalar(dst + i, str.data() + 2 * i, n - i);
+        if (i != n)
+        {
+            out.resize(old);
+            return false;
+        }
+        return true;
+    }
+
+    std::string StringUtil::HexDecode(std::string_view str)
+    {
+        std::string ret;
+        if (!HexDecodeTo(ret, str))
+            return std::string();
+        return ret;
+    }
+
+    uint32_t StringUtil::Crc32c(std::string_view data, uint32_t crc)
+    {
+        const uint8_t *p = (const uint8_t *)data.data();
+        crc = ~crc;
+#if defined(__x86_64__) || defined(__i386__)
+        if (s_has_sse42 && SimdEnabled())
+            return ~Crc32cSSE42(crc, p, data.size());
+#endif
+        return ~Crc32cSoftware(crc, p, data.size());
+    }
+
+    StringUtil::CharSet::CharSet(std::string_view set)
+        : m_set(set)
+    {
+        memset(m_bits, 0, sizeof(m_bits));
+        for (unsigned char c : set)
+            m_bits[c >> 6] |= 1ull << (c & 63);
+        if (set.size() <= s_max_simd_set)
+        {
+            for (size_t k = 0; k < set.size(); ++k)
+                memset(m_splat[k], set[k], sizeof(m_splat[k]));
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    static inline unsigned MatchSet16(const char *p, const char (*splat)[16], size_t count)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_setzero_si128();
+        for (size_t k = 0; k < count; ++k)
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_load_si128((const __m128i *)splat[k])));
+        return _mm_movemask_epi8(m);
+    }
+#endif
+
+    size_t StringUtil::CharSet::find(const char *p, size_t n, bool in) const
+    {
+        // 按空白分词等场景字段很短，先逐字节看前8个字符，没找到再每次比较16字节
+        size_t i = 0;
+        for (size_t head = n < 8 ? n : 8; i < head; ++i)
+        {
+            if (contains(p[i]) == in)
+                return i;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        if (m_set.size() <= s_max_simd_set && SimdEnabled())
+        {
+            for (; i + 16 <= n; i += 16)
+            {
+                unsigned mask = MatchSet16(p + i, m_splat, m_set.size());
+                if (!in)
+                    mask = ~mask & 0xffff;
+                if (mask)
+                    return i + __builtin_ctz(mask);
+            }
+        }
+#endif
+        while (i < n && contains(p[i]) != in)
+            ++i;
+        return i;
+    }
+
+    size_t StringUtil::CharSet::rfindNot(const char *p, size_t n) const
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (n >= 16 && m_set.size() <= s_max_simd_set && SimdEnabled())
+        {
+            for (; n >= 16; n -= 16)
+            {
+                unsigned mask = ~MatchSet16(p + n - 16, m_splat, m_set.size()) & 0xffff;
+                if (mask)
+                    return n - 16 + (32 - __builtin_clz(mask));
+            }
+        }
+#endif
+        while (n > 0 && contains(p[n - 1]))
+            --n;
+        return n;
+    }
+
+    size_t StringUtil::FindFirstOf(std::string_view str, std::string_view set, size_t pos)
+    {
+        if (pos >= str.size())
+            return std::string_view::npos;
+        size_t i = CharSet(set).find(str.data() + pos, str.size() - pos, true);
+        return pos + i < str.size() ? pos + i : std::string_view::npos;
+    }
+
+    size_t StringUtil::FindFirstNotOf(std::string_view str, std::string_view set, size_t pos)
+    {
+        if (pos >= str.size())
+            return std::string_view::npos;
+        size_t i = CharSet(set).find(str.data() + pos, str.size() - pos, false);
+        return pos + i < str.size() ? pos + i : std::string_view::npos;
+    }
+
+    size_t StringUtil::FindLastNotOf(std::string_view str, std::string_view set)
+    {
+        size_t n = CharSet(set).rfindNot(str.data(), str.size());
+        return n == 0 ? std::string_view::npos : n - 1;
+    }
+
+    std::string_view StringUtil::TrimView(std::string_view str, std::string_view delimit)
+    {
+        return TrimRightView(TrimLeftView(str, delimit), delimit);
+    }
+
+    std::string_view StringUtil::TrimLeftView(std::string_view str, std::string_view delimit)
+    {
+        size_t begin = CharSet(delimit).find(str.data(), str.size(), false);
+        return str.substr(begin);
+    }
+
+    std::string_view StringUtil::TrimRightView(std::string_view str, std::string_view delimit)
+    {
+        return str.substr(0, CharSet(delimit).rfindNot(str.data(), str.size()));
+    }
+
+    std::string StringUtil::Trim(const std::string &str, const std::string &delimit)
+    {
+        return std::string(TrimView(str, delimit));
+    }
+
+    std::string StringUtil::TrimLeft(const std::string &str, const std::string &delimit)
+    {
+        return std::string(TrimLeftView(str, delimit));
+    }
+
+    std::string StringUtil::TrimRight(const std::string &str, const std::string &delimit)
+    {
+        return std::string(TrimRightView(str, delimit));
+    }
+
+    void StringUtil::SplitRange::iterator::advance()
+    {
+        if (m_next <= m_str.size())
+        {
+            size_t start = m_next;
+            if (m_skipEmpty)
+                start += m_delims.find(m_str.data() + start, m_str.size() - start, false);
+            if (!m_skipEmpty || start < m_str.size())
+            {
+                size_t end = start + m_delims.find(m_str.data() + start, m_str.size() - start, true);
+                m_pos = start;
+                m_token = m_str.substr(start, end - start);
+                m_next = end + 1;
+                return;
+            }
+        }
+        m_pos = std::string_view::npos;
+        m_token = std::string_view();
+    }
+
+    // 解码一个以非ASCII字节开头的UTF-8序列，成功时返回序列长度并写出码点，非法时返回0
+    static inline size_t DecodeUtf8Sequence(const unsigned char *p, const unsigned char *end, char32_t &cp)
+    {
+        unsigned char c = p[0];
+        size_t left = end - p;
+        if (c >= 0xC2 && c < 0xE0)
+        {
+            if (left < 2 || (p[1] & 0xC0) != 0x80)
+                return 0;
+            cp = ((c & 0x1F) << 6) | (p[1] & 0x3F);
+            return 2;
+        }
+        if (c >= 0xE0 && c < 0xF0)
+        {
+            if (left < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80)
+                return 0;
+            cp = ((c & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+            // 过长编码或代理区码点
+            if (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))
+                return 0;
+            return 3;
+        }
+        if (c >= 0xF0 && c < 0xF5)
+        {
+            if (left < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80)
+                return 0;
+            cp = ((c & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+            if (cp < 0x10000 || cp > 0x10FFFF)
+                return 0;
+            return 4;
+        }
+        // 单独的后续字节、0xC0/0xC1开头的过长编码、0xF5及以上
+        return 0;
+    }
+
+    // 编码一个合法码点，返回写入后的位置
+    static inline char *EncodeUtf8Sequence(char32_t cp, char *d)
+    {
+        if (cp < 0x80)
+        {
+            *d++ = cp;
+        }
+        else if (cp < 0x800)
+        {
+            *d++ = 0xC0 | (cp >> 6);
+            *d++ = 0x80 | (cp & 0x3F);
+        }
+        else if (cp < 0x10000)
+        {
+            *d++ = 0xE0 | (cp >> 12);
+            *d++ = 0x80 | ((cp >> 6) & 0x3F);
+            *d++ = 0x80 | (cp & 0x3F);
+        }
+        else
+        {
+            *d++ = 0xF0 | (cp >> 18);
+            *d++ = 0x80 | ((cp >> 12) & 0x3F);
+            *d++ = 0x80 | ((cp >> 6) & 0x3F);
+            *d++ = 0x80 | (cp & 0x3F);
+        }
+        return d;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // UTF-8校验查表（Keiser、Lemire，"Validating UTF-8 In Less Than One Instruction Per Byte"）：
+    // 每个字节与前一个字节的高低半字节、本字节的高半字节各查一张表，三个结果按位与，非0的位即一种错误
+    enum : uint8_t
+    {
+        UTF8_TOO_SHORT = 1 << 0,      // 前导字节后面不是后续字节
+        UTF8_TOO_LONG = 1 << 1,       // ASCII后面是后续字节
+        UTF8_OVERLONG_3 = 1 << 2,     // 11100000 100_____
+        UTF8_TOO_LARGE = 1 << 3,      // 超出U+10FFFF
+        UTF8_SURROGATE = 1 << 4,      // 11101101 101_____
+        UTF8_OVERLONG_2 = 1 << 5,     // 1100000_ 10______
+        UTF8_TOO_LARGE_1000 = 1 << 6, // 超出U+10FFFF，第二字节为1000____
+        UTF8_OVERLONG_4 = 1 << 6,     // 11110000 1000____
+        UTF8_TWO_CONTS = 1 << 7,      // 两个连续的后续字节，是三、四字节序列的后续部分时不算错误
+        UTF8_CARRY = UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS,
+    };
+
+    // 前一字节的高半字节
+    alignas(16) static const uint8_t s_utf8_byte1_high[16] = {
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4};
+
+    // 前一字节的低半字节
+    alignas(16) static const uint8_t s_utf8_byte1_low[16] = {
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000};
+
+    // 本字节的高半字节
+    alignas(16) static const uint8_t s_utf8_byte2_high[16] = {
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT};
+
+    // 块末尾3个字节的上限，超过说明最后一个序列要在下一块继续
+    alignas(16) static const uint8_t s_utf8_tail_max[16] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF};
+
+    /**
+     * @brief 每次校验16字节，包括多字节序列；遇到错误或不足16字节时停止
+     * @return 已确认合法的前缀长度，总是在字符边界上；错误的准确位置和末尾不足16字节的部分交给标量代码
+     */
+    __attribute__((target("ssse3"))) static size_t ValidateUtf8SSSE3(const uint8_t *src, size_t n)
+    {
+        const __m128i byte1_high = _mm_load_si128((const __m128i *)s_utf8_byte1_high);
+        const __m128i byte1_low = _mm_load_si128((const __m128i *)s_utf8_byte1_low);
+        const __m128i byte2_high = _mm_load_si128((const __m128i *)s_utf8_byte2_high);
+        const __m128i tail_max = _mm_load_si128((const __m128i *)s_utf8_tail_max);
+        const __m128i mask_0f = _mm_set1_epi8(0x0f);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i prev = zero;
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i error;
+            if (_mm_movemask_epi8(in) == 0)
+            {
+                // 纯ASCII块只需确认前一块没有以不完整的序列结尾
+                error = _mm_subs_epu8(prev, tail_max);
+            }
+            else
+            {
+                __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+                __m128i special = _mm_and_si128(
+                    _mm_and_si128(_mm_shuffle_epi8(byte1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), mask_0f)),
+                                  _mm_shuffle_epi8(byte1_low, _mm_and_si128(prev1, mask_0f))),
+                    _mm_shuffle_epi8(byte2_high, _mm_and_si128(_mm_srli_epi16(in, 4), mask_0f)));
+                // 往前第2个字节是三、四字节前导或往前第3个字节是四字节前导时，本字节必须是后续字节，
+                // 这正是查表结果中只有TWO_CONTS的情况，异或后为0
+                __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+                __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+                __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                                              _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80)));
+                error = _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8((char)0x80)), special);
+            }
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xffff)
+                break;
+            prev = in;
+        }
+        // [0, i)中除了末尾可能不完整的序列都已校验，退到该序列的前导字节
+        if (i >= 1 && src[i - 1] >= 0xC0)
+            return i - 1;
+        if (i >= 2 && src[i - 2] >= 0xE0)
+            return i - 2;
+        if (i >= 3 && src[i - 3] >= 0xF0)
+            return i - 3;
+        return i;
+    }
+
+    /**
+     * @brief 已校验的UTF-8的解码方式，按12字节内的字符结尾位图查表
+     * @details 前6个字符都不超过2字节时，一次解码6个字符到16位通道；前几个字符不超过3字节时，一次解码最多4个字符到32位通道；
+     *          开头是4字节序列时逐个解码
+     */
+    struct Utf8DecodeTable
+    {
+        enum Kind : uint8_t
+        {
+            SCALAR = 0,
+            TWO_BYTES = 1,
+            THREE_BYTES = 2,
+        };
+
+        // 按位图分开存放，下一步的位置只依赖consumed的一次读取
+        uint8_t shuffle[1 << 12][16]; // 把每个字符的字节从后往前放进各自通道的低位，0x80表示填0
+        uint8_t kind[1 << 12];
+        uint8_t count[1 << 12];    // 解码的字符数
+        uint8_t consumed[1 << 12]; // 消耗的字节数
+
+        Utf8DecodeTable()
+        {
+            memset(shuffle, 0x80, sizeof(shuffle));
+            memset(kind, SCALAR, sizeof(kind));
+            memset(count, 0, sizeof(count));
+            memset(consumed, 0, sizeof(consumed));
+            for (unsigned mask = 0; mask < (1u << 12); ++mask)
+            {
+                // 各字符的首尾字节下标
+                int starts[12], ends[12], chars = 0;
+                for (int i = 0, start = 0; i < 12; ++i)
+                {
+                    if (mask & (1u << i))
+                    {
+                        starts[chars] = start;
+                        ends[chars++] = i;
+                        start = i + 1;
+                    }
+                }
+                int short2 = 0, short3 = 0;
+                while (short2 < chars && short2 < 6 && ends[short2] - starts[short2] < 2)
+                    ++short2;
+                while (short3 < chars && short3 < 4 && ends[short3] - starts[short3] < 3)
+                    ++short3;
+                if (short2 == 6)
+                {
+                    kind[mask] = TWO_BYTES;
+                    count[mask] = 6;
+                    for (int k = 0; k < 6; ++k)
+                    {
+                        shuffle[mask][2 * k] = ends[k];
+                        if (ends[k] > starts[k])
+                            shuffle[mask][2 * k + 1] = starts[k];
+                    }
+                }
+                else if (short3 > 0)
+                {
+                    kind[mask] = THREE_BYTES;
+                    count[mask] = short3;
+                    for (int k = 0; k < short3; ++k)
+                    {
+                        for (int b = 0; b <= ends[k] - starts[k]; ++b)
+                            shuffle[mask][4 * k + b] = ends[k] - b;
+                    }
+                }
+                if (kind[mask] != SCALAR)
+                    consumed[mask] = ends[count[mask] - 1] + 1;
+            }
+        }
+    };
+
+    static const Utf8DecodeTable &GetUtf8DecodeTable()
+    {
+        static const Utf8DecodeTable *s_table = new Utf8DecodeTable; // 约76KB，第一次解码非ASCII文本时才生成
+        return *s_table;
+    }
+
+    /**
+     * @brief [p, p + 64)中不是后续字节（0x80~0xBF，按有符号比较小于0xC0）的位置
+     */
+    __attribute__((target("ssse3"))) static inline uint64_t NonContinuationBits(const unsigned char *p)
+    {
+        const __m128i c0 = _mm_set1_epi8((char)0xC0);
+        uint64_t bits = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+            bits |= (uint64_t)(uint16_t)~_mm_movemask_epi8(_mm_cmplt_epi8(v, c0)) << (16 * i);
+        }
+        return bits;
+    }
+
+    /**
+     * @brief 解码已按THREE_BYTES重排的4个1~3字节字符，写入4个码元
+     * @details 通道从低到高为最后一个、倒数第二个、倒数第三个字节；前导字节取低4位或低5位的结果相同
+     */
+    template <class CharT>
+    __attribute__((target("ssse3"))) static inline void StoreThreeBytes(__m128i x, CharT *d)
+    {
+        __m128i cp = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32(0x7F)),
+                                  _mm_srli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x3F00)), 2));
+        cp = _mm_or_si128(cp, _mm_srli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x0F0000)), 4));
+        if constexpr (sizeof(CharT) == 2)
+            _mm_storel_epi64((__m128i *)d, _mm_shuffle_epi8(cp, _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1)));
+        else
+            _mm_storeu_si128((__m128i *)d, cp);
+    }
+
+    /**
+     * @brief 解码已校验的[p, valid_end)中连续的多字节序列，开头12字节中出现ASCII或剩余不足16字节时返回；p停在字符边界
+     * @details 接下来48字节是16个3字节字符（中文等）时用固定的重排分4组解码，各组互不依赖；
+     *          其余按12字节内的字符结尾位图查表，一次解码6个2字节字符或4个2~3字节字符，4字节序列逐个解码。
+     *          字符结尾位图按64字节一段提前算好，下一步的位置只依赖移位和一次查表，不必等这一步的16字节读入和比较完成。
+     *          码元数不超过字节数，每步最多写16个码元且p + 16不超过valid_end，所以不会写出out的范围
+     * @return 写入后的位置
+     */
+    template <class CharT>
+    __attribute__((target("ssse3"))) static CharT *DecodeUtf8SSSE3(const unsigned char *&pos, const unsigned char *valid_end, CharT *d)
+    {
+        const Utf8DecodeTable &table = GetUtf8DecodeTable();
+        const unsigned char *p = pos; // 用局部变量，避免每次写d后都要重新读出pos
+        const __m128i cjk_shuffle = _mm_loadu_si128((const __m128i *)table.shuffle[0x924]);
+        uint64_t ends = 0; // 第i位表示p - off + i是字符结尾
+        size_t off = 64;
+        while (valid_end - p >= 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+            if ((_mm_movemask_epi8(v) & 0xfff) != 0xfff)
+                break;
+            // 下一个字节不是后续字节的位置是字符结尾；位图用完，或者可能进入3字节字符的连续段时重新计算
+            if ((off > 52 || (off > 16 && ((ends >> off) & 0xfff) == 0x924)) && valid_end - p >= 65)
+            {
+                ends = NonContinuationBits(p + 1);
+                off = 0;
+            }
+            if (off <= 16 && ((ends >> off) & 0xffffffffffffull) == 0x924924924924ull && valid_end - p >= 52)
+            {
+                for (int k = 0; k < 4; ++k)
+                    StoreThreeBytes(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 12 * k)), cjk_shuffle), d + 4 * k);
+                p += 48;
+                d += 16;
+                off += 48;
+                continue;
+            }
+            unsigned mask;
+            if (off <= 52)
+                mask = (unsigned)(ends >> off) & 0xfff;
+            else
+                mask = ~((unsigned)_mm_movemask_epi8(_mm_cmplt_epi8(v, _mm_set1_epi8((char)0xC0))) >> 1) & 0xfff;
+            __m128i x = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i *)table.shuffle[mask]));
+            if (table.kind[mask] == Utf8DecodeTable::TWO_BYTES)
+            {
+                // 通道低字节为最后一个字节，高字节为2字节序列的前导字节
+                __m128i cp = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi16(0x7F)),
+                                          _mm_srli_epi16(_mm_and_si128(x, _mm_set1_epi16(0x1F00)), 2));
+                if constexpr (sizeof(CharT) == 2)
+                {
+                    _mm_storeu_si128((__m128i *)d, cp);
+                }
+                else
+                {
+                    const __m128i zero = _mm_setzero_si128();
+                    _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(cp, zero));
+                    _mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(cp, zero));
+                }
+            }
+            else if (table.kind[mask] == Utf8DecodeTable::THREE_BYTES)
+            {
+                StoreThreeBytes(x, d);
+            }
+            else
+            {
+                char32_t cp = 0; // 输入已校验，一定能解码
+                size_t len = DecodeUtf8Sequence(p, valid_end, cp);
+                p += len;
+                off += len;
+                if (sizeof(CharT) == 2 && cp >= 0x10000)
+                {
+                    cp -= 0x10000;
+                    *d++ = 0xD800 + (cp >> 10);
+                    *d++ = 0xDC00 + (cp & 0x3FF);
+                }
+                else
+                {
+                    *d++ = cp;
+                }
+                continue;
+            }
+            p += table.consumed[mask];
+            off += table.consumed[mask];
+            d += table.count[mask];
+        }
+        pos = p;
+        return d;
+    }
+#endif
+
+    // UTF-8解码，码元为2字节时输出UTF-16，为4字节时输出UTF-32
+    template <class CharT>
+    static bool DecodeUtf8(std::string_view str, std::basic_string<CharT> &out, size_t *error_offset)
+    {
+        size_t old = out.size();
+        out.resize(old + str.size()); // 每个输入字节最多产生一个码元
+        CharT *d = &out[0] + old;
+        const unsigned char *begin = (const unsigned char *)str.data();
+        const unsigned char *p = begin;
+        const unsigned char *end = p + str.size();
+        const bool simd = SimdEnabled();
+#if defined(__x86_64__) || defined(__i386__)
+        const bool table = simd && s_has_ssse3; // 连续的多字节段查表解码
+        const unsigned char *valid = p;         // [p, valid)已经用SSSE3校验过
+#else
+        const bool table = false;
+#endif
+        while (p < end)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            if (simd && end - p >= 16)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)p);
+                unsigned mask = _mm_movemask_epi8(v);
+                if (mask == 0)
+                {
+                    // 16个ASCII字节，与0交错展开为16位，UTF-32再展开一次
+                    __m128i zero = _mm_setzero_si128();
+                    __m128i lo = _mm_unpacklo_epi8(v, zero);
+                    __m128i hi = _mm_unpackhi_epi8(v, zero);
+                    if constexpr (sizeof(CharT) == 2)
+                    {
+                        _mm_storeu_si128((__m128i *)d, lo);
+                        _mm_storeu_si128((__m128i *)(d + 8), hi);
+                    }
+                    else
+                    {
+                        _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(lo, zero));
+                        _mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(lo, zero));
+                        _mm_storeu_si128((__m128i *)(d + 8), _mm_unpacklo_epi16(hi, zero));
+                        _mm_storeu_si128((__m128i *)(d + 12), _mm_unpackhi_epi16(hi, zero));
+                    }
+                    p += 16;
+                    d += 16;
+                    continue;
+                }
+                if (table && (mask & 0xfff) == 0xfff)
+                {
+                    // 开头12字节（查表的窗口）都不是ASCII：先分段校验，再查表解码这段连续的多字节序列；
+                    // 校验在出错处停下，不足16字节时交给下面逐个解码并报告错误
+                    if (valid - p < 16)
+                        valid = p + ValidateUtf8SSSE3(p, std::min<size_t>(end - p, 4096));
+                    if (valid - p >= 16)
+                    {
+                        const unsigned char *q = p; // 不取p的地址，其余路径上p可以一直放在寄存器里
+                        d = DecodeUtf8SSSE3(q, valid, d);
+                        p = q;
+                        continue;
+                    }
+                }
+                unsigned n = __builtin_ctz(mask);
+                for (unsigned i = n; i > 0; --i)
+                    *d++ = *p++;
+                if (n && table && (mask >> n) == (0xffffu >> n))
+                    continue; // 后面的多字节段一直到窗口末尾，从它的开头重新检查窗口，看能否查表解码
+            }
+#endif
+            if (*p < 0x80)
+            {
+                *d++ = *p++;
+                continue;
+            }
+            // 夹在ASCII中的短多字节序列、没有SSSE3时，以及出错位置附近和末尾不足16字节处，连续的多字节序列在这里逐个解码；
+            // 可以查表时每解码至少12字节回到上面重新检查窗口
+            const unsigned char *stop = table && end - p > 12 ? p + 12 : end;
+            do
+            {
+                char32_t cp;
+                size_t len = DecodeUtf8Sequence(p, end, cp);
+                if (len == 0)
+                {
+                    if (error_offset)
+                        *error_offset = p - begin;
+                    out.resize(old);
+                    return false;
+                }
+                p += len;
+                if (sizeof(CharT) == 2 && cp >= 0x10000)
+                {
+                    cp -= 0x10000;
+                    *d++ = 0xD800 + (cp >> 10);
+                    *d++ = 0xDC00 + (cp & 0x3FF);
+                }
+                else
+                {
+                    *d++ = cp;
+                }
+            } while (p < stop && *p >= 0x80);
+        }
+        out.resize(d - out.data());
+        return true;
+    }
+
+    // UTF-16（码元为2字节）或UTF-32编码为UTF-8
+    template <class CharT>
+    static bool EncodeUtf8(const CharT *s, size_t n, std::string &out, size_t *error_offset)
+    {
+        size_t old = out.size();
+        // UTF-16每个码元最多3字节（代理对2个码元共4字节），UTF-32每个码元最多4字节
+        out.resize(old + n * (sizeof(CharT) == 2 ? 3 : 4));
+        char *d = &out[0] + old;
+        size_t i = 0;
+        const bool simd = SimdEnabled();
+        while (i < n)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            if (simd && i + 16 <= n)
+            {
+                // 16个码元都小于0x80时收窄为16个字节，否则先逐个复制开头的ASCII码元
+                __m128i zero = _mm_setzero_si128();
+                if constexpr (sizeof(CharT) == 2)
+                {
+                    __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+                    __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 8));
+                    __m128i high = _mm_set1_epi16((short)0xFF80);
+                    // 每个码元2位，为1表示ASCII
+                    uint32_t ascii = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(a, high), zero)) |
+                                     ((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(b, high), zero)) << 16);
+                    if (ascii == 0xFFFFFFFFu)
+                    {
+                        _mm_storeu_si128((__m128i *)d, _mm_packus_epi16(a, b));
+                        d += 16;
+                        i += 16;
+                        continue;
+                    }
+                    for (unsigned k = __builtin_ctz(~ascii) / 2; k > 0; --k)
+                        *d++ = (char)s[i++];
+                }
+                else
+                {
+                    __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+                    __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 4));
+                    __m128i c = _mm_loadu_si128((const __m128i *)(s + i + 8));
+                    __m128i e = _mm_loadu_si128((const __m128i *)(s + i + 12));
+                    __m128i high = _mm_set1_epi32(~0x7F);
+                    // 每个码元4位，为1表示ASCII
+                    uint64_t ascii = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(a, high), zero)) |
+                                     ((uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(b, high), zero)) << 16) |
+                                     ((uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(c, high), zero)) << 32) |
+                                     ((uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(e, high), zero)) << 48);
+                    if (ascii == ~0ull)
+                    {
+                        __m128i ab = _mm_packs_epi32(a, b);
+                        __m128i ce = _mm_packs_epi32(c, e);
+                        _mm_storeu_si128((__m128i *)d, _mm_packus_epi16(ab, ce));
+                        d += 16;
+                        i += 16;
+                        continue;
+                    }
+                    for (unsigned k = __builtin_ctzll(~ascii) / 4; k > 0; --k)
+                        *d++ = (char)s[i++];
+                }
+            }
+#endif
+            // 连续的非ASCII码元（如中文）在这里逐个编码，不再回到SIMD路径
+            do
+            {
+                uint32_t cp = (uint32_t)s[i];
+                size_t units = 1;
+                if (sizeof(CharT) == 2 && cp >= 0xD800 && cp <= 0xDBFF && i + 1 < n)
+                {
+                    uint32_t low = (uint32_t)s[i + 1];
+                    if (low >= 0xDC00 && low <= 0xDFFF)
+                    {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        units = 2;
+                    }
+                }
+                // 不成对的代理、UTF-32中的代理区码点、超出范围的码点（包括为负的wchar_t）
+                if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+                {
+                    if (error_offset)
+                        *error_offset = i;
+                    out.resize(old);
+                    return false;
+                }
+                d = EncodeUtf8Sequence(cp, d);
+                i += units;
+            } while (i < n && (uint32_t)s[i] >= 0x80);
+        }
+        out.resize(d - out.data());
+        return true;
+    }
+
+    bool StringUtil::ValidateUtf8(std::string_view str, size_t *error_offset)
+    {
+        const unsigned char *begin = (const unsigned char *)str.data();
+        const unsigned char *p = begin;
+        const unsigned char *end = p + str.size();
+        const bool simd = SimdEnabled();
+#if defined(__x86_64__) || defined(__i386__)
+        // 校验到第一个错误所在的块或末尾不足16字节处，下面的循环从该处找出准确的错误位置
+        if (simd && s_has_ssse3 && str.size() >= 16)
+            p += ValidateUtf8SSSE3(p, str.size());
+#endif
+        while (p < end)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            if (simd && end - p >= 16)
+            {
+                unsigned mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p));
+                if (mask == 0)
+                {
+                    p += 16;
+                    continue;
+                }
+                p += __builtin_ctz(mask);
+            }
+#endif
+            if (*p < 0x80)
+            {
+                ++p;
+                continue;
+            }
+            do
+            {
+                char32_t cp;
+                size_t len = DecodeUtf8Sequence(p, end, cp);
+                if (len == 0)
+                {
+                    if (error_offset)
+                        *error_offset = p - begin;
+                    return false;
+                }
+                p += len;
+            } while (p < end && *p >= 0x80);
+        }
+        return true;
+    }
+
+    bool StringUtil::Utf8ToUtf32(std::string_view str, std::u32string &out, size_t *error_offset)
+    {
+        return DecodeUtf8(str, out, error_offset);
+    }
+
+    bool StringUtil::Utf8ToUtf16(std::string_view str, std::u16string &out, size_t *error_offset)
+    {
+        return DecodeUtf8(str, out, error_offset);
+    }
+
+    bool StringUtil::Utf32ToUtf8(std::u32string_view str, std::string &out, size_t *error_offset)
+    {
+        return EncodeUtf8(str.data(), str.size(), out, error_offset);
+    }
+
+    bool StringUtil::Utf16ToUtf8(std::u16string_view str, std::string &out, size_t *error_offset)
+    {
+        return EncodeUtf8(str.data(), str.size(), out, error_offset);
+    }
+
+    bool StringUtil::Utf8ToWString(std::string_view str, std::wstring &out, size_t *error_offset)
+    {
+        return DecodeUtf8(str, out, error_offset);
+    }
+
+    bool StringUtil::WStringToUtf8(std::wstring_view str, std::string &out, size_t *error_offset)
+    {
+        return EncodeUtf8(str.data(), str.size(), out, error_offset);
+    }
+
+    std::string StringUtil::WStringToString(const std::wstring &ws)
+    {
+        std::string str;
+        if (!WStringToUtf8(ws, str))
+            return std::string();
+        return str;
+    }
+
+    std::wstring StringUtil::StringToWString(const std::string &s)
+    {
+        std::wstring ws;
+        if (!Utf8ToWString(s, ws))
+            return std::wstring();
+        return ws;
+    }
+
+    static inline uint64_t HashMix(uint64_t a, uint64_t b)
+    {
+        __uint128_t r = (__uint128_t)a * b;
+        return (uint64_t)r ^ (uint64_t)(r >> 64);
+    }
+
+    uint64_t Hash64(const void *data, size_t len, uint64_t seed)
+    {
+        static const uint64_t k0 = 0xa0761d6478bd642full;
+        static const uint64_t k1 = 0xe7037ed1a0b428dbull;
+        static const uint64_t k2 = 0x8ebc6af09c88c6e3ull;
+        const uint8_t *p = (const uint8_t *)data;
+        uint64_t h = seed ^ k0;
+        uint64_t a, b;
+        size_t left = len;
+        while (left >= 16)
+        {
+            memcpy(&a, p, 8);
+            memcpy(&b, p + 8, 8);
+            h = HashMix(a ^ k1, b ^ h);
+            p += 16;
+            left -= 16;
+        }
+        if (left >= 8)
+        {
+            memcpy(&a, p, 8);
+            h = HashMix(a ^ k2, h ^ k1);
+            p += 8;
+            left -= 8;
+        }
+        if (left > 0)
+        {
+            a = 0;
+            memcpy(&a, p, left);
+            h = HashMix(a ^ k0, h ^ k2);
+        }
+        return HashMix(h ^ k1, len ^ k2);
+    }
+
+    namespace
+    {
+        /**
+         * @brief 进程内共享的工作线程池，第一次使用时创建，之后常驻，各个TaskGroup从这里借用线程
+         * @details 线程数为CPU核数，至少4个：删除、复制目录树主要在等IO，单核机器上多几个线程也有收益
+         */
+        class WorkerPool
+        {
+        public:
+            typedef std::function<void()> Job;
+
+            static WorkerPool &GetInstance()
+            {
+                // 工作线程一直引用它，有意不析构
+                static WorkerPool *s_pool = new WorkerPool(std::max(4u, std::thread::hardware_concurrency()));
+                return *s_pool;
+            }
+
+            size_t size() const { return m_size; }
+
+            void post(Job job)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.push_back(std::move(job));
+                m_cond.notify_one();
+            }
+
+        private:
+            explicit WorkerPool(size_t size) : m_size(size)
+            {
+                for (size_t i = 0; i < size; ++i)
+                    std::thread(&WorkerPool::run, this).detach();
+            }
+
+            void run()
+            {
+                ThreadRegistry::Register("worker");
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (true)
+                {
+                    if (m_jobs.empty())
+                    {
+                        m_cond.wait(lock);
+                        continue;
+                    }
+                    Job job = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                    lock.unlock();
+                    job();
+                    lock.lock();
+                }
+            }
+
+        private:
+            size_t m_size;
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+            std::deque<Job> m_jobs;
+        };
+
+        /**
+         * @brief 一组工作线程执行可以继续派生新任务的任务，全部任务完成后run()返回
+         * @details 调用线程自己参与执行，其余线程从WorkerPool借用；池中线程都在忙时调用线程独自也能完成，
+         *          所以在任务中嵌套使用TaskGroup不会死锁。
+         *          任务抛出的异常由run()在所有线程结束后重新抛给调用方，之后排队的任务不再执行
+         */
+        class TaskGroup
+        {
+        public:
+            typedef std::function<void()> Task;
+
+            /**
+             * @param[in] threads 并行度，包括调用线程，0表示CPU核数
+             */
+            explicit TaskGroup(size_t threads)
+                : m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+            {
+            }
+
+            void push(Task task)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_error)
+                    return;
+                m_tasks.push_back(std::move(task));
+                m_cond.notify_one();
+            }
+
+            /**
+             * @brief 是否有线程正在等待任务，用来决定新任务是交出去还是自己做
+             */
+            bool hungry() const { return m_idle.load(std::memory_order_relaxed) > 0; }
+
+            /**
+             * @brief 是否已有任务抛出异常，正在执行的任务可以据此提前结束
+             */
+            bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+            /**
+             * @brief 调用线程也作为工作线程参与执行
+             */
+            void run()
+            {
+                WorkerPool &pool = WorkerPool::GetInstance();
+                size_t helpers = std::min(m_threads - 1, pool.size());
+                std::shared_ptr<Helpers> state;
+                if (helpers > 0)
+                {
+                    state.reset(new Helpers);
+                    state->group = this;
+                    for (size_t i = 0; i < helpers; ++i)
+                        pool.post([state]() { state->help(); });
+                }
+                work();
+                if (state)
+                {
+                    // 等已经开始的借用线程退出，还在池中排队的在开始时发现group为空直接返回
+                    std::unique_lock<std::mutex> lock(state->mutex);
+                    state->cond.wait(lock, [&]() { return state->active == 0; });
+                    state->group = nullptr;
+                }
+                if (m_error)
+                    std::rethrow_exception(m_error);
+            }
+
+        private:
+            /**
+             * @brief 借给本组的线程，生命周期可能长于TaskGroup，由投递到池中的任务共同持有
+             */
+            struct Helpers
+            {
+                std::mutex mutex;
+                std::condition_variable cond;
+                TaskGroup *group = nullptr; // run()结束后置空
+                size_t active = 0;          // 正在执行group->work()的线程数
+
+                void help()
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    TaskGroup *g = group;
+                    if (g == nullptr)
+                        return;
+                    ++active;
+                    lock.unlock();
+                    g->work();
+                    lock.lock();
+                    if (--active == 0)
+                        cond.notify_all();
+                }
+            };
+
+            void work()
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (true)
+                {
+                    if (!m_tasks.empty())
+                    {
+                        Task task = std::move(m_tasks.front());
+                        m_tasks.pop_front();
+                        ++m_active;
+                        lock.unlock();
+                        std::exception_ptr error;
+                        try
+                        {
+                            task();
+                        }
+                        catch (...)
+                        {
+                            error = std::current_exception();
+                        }
+                        lock.lock();
+                        --m_active;
+                        if (error && !m_error)
+                        {
+                            m_error = error;
+                            m_failed.store(true, std::memory_order_relaxed);
+                            m_tasks.clear();
+                        }
+                        continue;
+                    }
+                    if (m_active == 0)
+                    {
+                        m_cond.notify_all();
+                        return;
+                    }
+                    ++m_idle;
+                    m_cond.wait(lock);
+                    --m_idle;
+                }
+            }
+
+        private:
+            size_t m_threads; // 并行度，包括调用线程
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+            std::deque<Task> m_tasks;
+            size_t m_active = 0;              // 正在执行的任务数
+            std::atomic<size_t> m_idle{0};    // 等待任务的线程数
+            std::exception_ptr m_error;       // 第一个任务抛出的异常
+            std::atomic<bool> m_failed{false}; // m_error非空
+        };
+
+        struct linux_dirent64
+        {
+            ino64_t d_ino;
+            off64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[];
+        };
+
+        static inline bool IsDotOrDotDot(const char *name)
+        {
+            return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+        }
+
+        /**
+         * @brief 逐个读取目录fd中的目录项，d_type为DT_UNKNOWN时用fstatat补全
+         * @param[in] cb 参数为名称和类型（DT_DIR、DT_REG等）
+         * @return getdents64是否成功读完
+         */
+        static bool ReadDirAt(int fd, const std::function<void(const char *name, unsigned char type)> &cb)
+        {
+            static const size_t s_dirent_buf_size = 32 * 1024;
+            std::unique_ptr<char[]> buf(new char[s_dirent_buf_size]);
+            while (true)
+            {
+                long n = syscall(SYS_getdents64, fd, buf.get(), s_dirent_buf_size);
+                if (n == 0)
+                    return true;
+                if (n < 0)
+                    return false;
+                for (long off = 0; off < n;)
+                {
+                    linux_dirent64 *d = (linux_dirent64 *)(buf.get() + off);
+                    off += d->d_reclen;
+                    if (IsDotOrDotDot(d->d_name))
+                        continue;
+                    unsigned char type = d->d_type;
+                    if (type == DT_UNKNOWN)
+                    {
+                        struct stat st;
+                        if (fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                            continue;
+                        if (S_ISDIR(st.st_mode))
+                            type = DT_DIR;
+                        else if (S_ISREG(st.st_mode))
+                            type = DT_REG;
+                        else if (S_ISLNK(st.st_mode))
+                            type = DT_LNK;
+                    }
+                    cb(d->d_name, type);
+                }
+            }
+        }
+
+        class DirWalker
+        {
+        public:
+            DirWalker(TaskGroup &group, const std::function<void(const std::string &)> &cb, const FSUtil::WalkOptions &options)
+                : m_group(group), m_cb(cb), m_options(options)
+            {
+            }
+
+            /**
+             * @brief 遍历fd对应的目录，结束后关闭fd
+             */
+            void walk(int fd, const std::string &path)
+            {
+                try
+                {
+                    ReadDirAt(fd, [&](const char *name, unsigned char type) {
+                        if (m_group.failed())
+                            return;
+                        if (type == DT_DIR)
+                            walkSubdir(fd, path, name);
+                        else if (type == DT_REG)
+                            visitFile(path, name);
+                    });
+                }
+                catch (...)
+                {
+                    // 回调抛出的异常交给TaskGroup传回调用方
+                    close(fd);
+                    throw;
+                }
+                close(fd);
             }
-            else if (dp->d_type == DT_REG)
+
+        private:
+            void walkSubdir(int fd, const std::string &path, const char *name)
             {
-                std::string filename(dp->d_name);
-                if (subfix.empty())
+                std::string sub = path + "/" + name;
+                if (m_group.hungry())
                 {
-                    files.push_back(path + "/" + filename);
+                    // 有空闲线程时把子目录交出去，只传路径，避免排队的任务占用fd
+                    m_group.push([this, sub]() {
+                        int sub_fd = open(sub.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                        if (sub_fd >= 0)
+                            walk(sub_fd, sub);
+                    });
+                    return;
                 }
-                else
+                int sub_fd = openat(fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (sub_fd >= 0)
+                    walk(sub_fd, sub);
+            }
+
+            void visitFile(const std::string &path, const char *name)
+            {
+                const std::string &subfix = m_options.subfix;
+                if (!subfix.empty())
                 {
-                    if (filename.size() > subfix.size() && filename.substr(filename.length() - subfix.size()) == subfix)
-                    {
-                        files.push_back(path + "/" + filename);
-                    }
+                    size_t len = strlen(name);
+                    if (len <= subfix.size() || memcmp(name + len - subfix.size(), subfix.data(), subfix.size()) != 0)
+                        return;
                 }
+                if (m_options.filter && !m_options.filter(path, name))
+                    return;
+                m_cb(path + "/" + name);
             }
-        }
-        closedir(dir);
+
+        private:
+            TaskGroup &m_group;
+            const std::function<void(const std::string &)> &m_cb;
+            const FSUtil::WalkOptions &m_options;
+        };
+    }
+
+    bool FSUtil::WalkFiles(const std::string &path, const std::function<void(const std::string &file)> &cb, const WalkOptions &options)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        TaskGroup group(options.threads);
+        DirWalker walker(group, cb, options);
+        group.push([&walker, fd, &path]() { walker.walk(fd, path); });
+        group.run();
+        return true;
+    }
+
+    bool FSUtil::WalkFiles(const std::string &path, const std::function<void(const std::string &file)> &cb)
+    {
+        return WalkFiles(path, cb, WalkOptions());
+    }
+
+    void FSUtil::ListAllFile(std::vector<std::string> &files, const std::string &path, const std::string &subfix)
+    {
+        WalkOptions options;
+        options.subfix = subfix;
+        WalkFiles(path, [&](const std::string &file) { files.push_back(file); }, options);
     }
 
     static int __lstat(const char *file, struct stat *st = nullptr) //存在返回0
@@ -234,30 +2434,536 @@ namespace MyServer
         return unlink(filename.c_str())==0;
     }
 
+    namespace
+    {
+        /**
+         * @brief 汇总多个线程产生的错误
+         */
+        class TreeErrors
+        {
+        public:
+            explicit TreeErrors(std::vector<std::string> *errors) : m_errors(errors) {}
+
+            void add(const std::string &path, int err)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_failed = true;
+                if (m_errors)
+                    m_errors->push_back(path + ": " + strerror(err));
+            }
+
+            bool failed() const { return m_failed; }
+
+        private:
+            std::mutex m_mutex;
+            std::vector<std::string> *m_errors;
+            bool m_failed = false;
+        };
+
+        /**
+         * @brief 并行删除目录树，每个目录的子目录都删除完后由最后完成的线程删除该目录
+         */
+        class TreeRemover
+        {
+        public:
+            struct Dir
+            {
+                typedef std::shared_ptr<Dir> ptr;
+                Dir::ptr parent;
+                std::string path;
+                std::atomic<int> pending{1};     // 未完成的子目录数，加上本目录自身的扫描
+                std::atomic<bool> failed{false}; // 本目录下有删不掉的项，目录本身不必再尝试rmdir
+            };
+
+            TreeRemover(TaskGroup &group, TreeErrors &errors) : m_group(group), m_errors(errors) {}
+
+            void remove(int fd, Dir::ptr dir)
+            {
+                if (!ReadDirAt(fd, [&](const char *name, unsigned char type) {
+                        if (type == DT_DIR)
+                            removeSubdir(fd, dir, name);
+                        else if (unlinkat(fd, name, 0) != 0 && errno != ENOENT)
+                            fail(dir, dir->path + "/" + name, errno);
+                    }))
+                    fail(dir, dir->path, errno);
+                close(fd);
+                finish(dir);
+            }
+
+        private:
+            void removeSubdir(int fd, const Dir::ptr &dir, const char *name)
+            {
+                Dir::ptr sub(new Dir);
+                sub->parent = dir;
+                sub->path = dir->path + "/" + name;
+                ++dir->pending;
+                if (m_group.hungry())
+                {
+                    m_group.push([this, sub]() {
+                        int sub_fd = open(sub->path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                        if (sub_fd < 0)
+                        {
+                            fail(sub, sub->path, errno);
+                            finish(sub);
+                            return;
+                        }
+                        remove(sub_fd, sub);
+                    });
+                    return;
+                }
+                int sub_fd = openat(fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (sub_fd < 0)
+                {
+                    fail(sub, sub->path, errno);
+                    finish(sub);
+                    return;
+                }
+                remove(sub_fd, sub);
+            }
+
+            /**
+             * @brief 记录错误，dir因此无法清空
+             */
+            void fail(const Dir::ptr &dir, const std::string &path, int err)
+            {
+                m_errors.add(path, err);
+                dir->failed = true;
+            }
+
+            /**
+             * @brief 目录的扫描或一个子目录完成，全部完成时删除目录；
+             *        目录没能清空时只记录最初的错误，不再对它和上级目录rmdir报ENOTEMPTY
+             */
+            void finish(Dir::ptr dir)
+            {
+                while (dir && --dir->pending == 0)
+                {
+                    bool removed = !dir->failed && (rmdir(dir->path.c_str()) == 0 || errno == ENOENT);
+                    if (!removed && !dir->failed)
+                        m_errors.add(dir->path, errno);
+                    if (!removed && dir->parent)
+                        dir->parent->failed = true;
+                    dir = dir->parent;
+                }
+            }
+
+        private:
+            TaskGroup &m_group;
+            TreeErrors &m_errors;
+        };
+
+        /**
+         * @brief 并行复制目录树
+         */
+        class TreeCopier
+        {
+        public:
+            TreeCopier(TaskGroup &group, TreeErrors &errors) : m_group(group), m_errors(errors) {}
+
+            /**
+             * @brief 复制src_fd目录下的内容到dst_fd目录，结束后关闭两个fd
+             */
+            void copy(int src_fd, int dst_fd, const std::string &from, const std::string &to)
+            {
+                if (!ReadDirAt(src_fd, [&](const char *name, unsigned char type) {
+                        if (type == DT_DIR)
+                            copySubdir(src_fd, dst_fd, from, to, name);
+                        else if (type == DT_REG)
+                            copyFile(src_fd, dst_fd, from, to, name);
+                        else if (type == DT_LNK)
+                            CopyLink(src_fd, name, from + "/" + name, dst_fd, name, to + "/" + name, m_errors);
+                    }))
+                    m_errors.add(from, errno);
+                close(src_fd);
+                close(dst_fd);
+            }
+
+            /**
+             * @brief 复制单个文件的内容，优先copy_file_range，不支持时退化为read/write
+             */
+            static bool CopyData(int in, int out)
+            {
+                bool kernel_copy = true;
+                char buf[64 * 1024];
+                while (true)
+                {
+                    ssize_t n;
+                    if (kernel_copy)
+                    {
+                        n = copy_file_range(in, nullptr, out, nullptr, 1 << 30, 0);
+                        if (n < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+                        {
+                            kernel_copy = false;
+                            continue;
+                        }
+                    }
+                    else
+                    {
+                        n = read(in, buf, sizeof(buf));
+                        if (n > 0)
+                        {
+                            for (ssize_t off = 0; off < n;)
+                            {
+                                ssize_t w = write(out, buf + off, n - off);
+                                if (w < 0 && errno == EINTR)
+                                    continue;
+                                if (w < 0)
+                                    return false;
+                                off += w;
+                            }
+                        }
+                    }
+                    if (n == 0)
+                        return true;
+                    if (n < 0 && errno != EINTR)
+                        return false;
+                }
+            }
+
+        private:
+            void copySubdir(int src_fd, int dst_fd, const std::string &from, const std::string &to, const char *name)
+            {
+                std::string sub_from = from + "/" + name;
+                std::string sub_to = to + "/" + name;
+                struct stat st;
+                if (fstatat(src_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    m_errors.add(sub_from, errno);
+                    return;
+                }
+                // 先保证自己能写入和进入目录，0555这类只读目录的权限等整棵树复制完后再由finish设置
+                mode_t mode = st.st_mode & 07777;
+                if (mkdirat(dst_fd, name, mode | S_IRWXU) != 0)
+                {
+                    if (errno != EEXIST)
+                    {
+                        m_errors.add(sub_to, errno);
+                        return;
+                    }
+                    if ((mode & S_IRWXU) != S_IRWXU && fchmodat(dst_fd, name, mode | S_IRWXU, 0) != 0)
+                    {
+                        m_errors.add(sub_to, errno);
+                        return;
+                    }
+                }
+                if ((mode & S_IRWXU) != S_IRWXU)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_dirModes.emplace_back(sub_to, mode);
+                }
+                if (m_group.hungry())
+                {
+                    m_group.push([this, sub_from, sub_to]() {
+                        int sfd = open(sub_from.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                        int dfd = open(sub_to.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                        if (sfd < 0 || dfd < 0)
+                        {
+                            m_errors.add(sfd < 0 ? sub_from : sub_to, errno);
+                            if (sfd >= 0)
+                                close(sfd);
+                            if (dfd >= 0)
+                                close(dfd);
+                            return;
+                        }
+                        copy(sfd, dfd, sub_from, sub_to);
+                    });
+                    return;
+                }
+                int sfd = openat(src_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (sfd < 0)
+                {
+                    m_errors.add(sub_from, errno);
+                    return;
+                }
+                int dfd = openat(dst_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (dfd < 0)
+                {
+                    m_errors.add(sub_to, errno);
+                    close(sfd);
+                    return;
+                }
+                copy(sfd, dfd, sub_from, sub_to);
+            }
+
+            void copyFile(int src_fd, int dst_fd, const std::string &from, const std::string &to, const char *name)
+            {
+                int in = openat(src_fd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+                if (in < 0)
+                {
+                    m_errors.add(from + "/" + name, errno);
+                    return;
+                }
+                struct stat st;
+                if (fstat(in, &st) != 0)
+                {
+                    m_errors.add(from + "/" + name, errno);
+                    close(in);
+                    return;
+                }
+                std::string tmp;
+                int out = CreateFile(dst_fd, name, st.st_mode & 07777, tmp);
+                if (out < 0)
+                {
+                    m_errors.add(to + "/" + name, errno);
+                    close(in);
+                    return;
+                }
+                if (!CloseFile(dst_fd, name, tmp, out, CopyData(in, out)))
+                    m_errors.add(to + "/" + name, errno);
+                close(in);
+            }
+
+        public:
+            /**
+             * @brief 整棵树复制完成后设置只读目录的权限，先设置深层目录，避免上级目录先失去写和进入权限
+             */
+            void finish()
+            {
+                auto depth = [](const std::string &path) { return std::count(path.begin(), path.end(), '/'); };
+                std::sort(m_dirModes.begin(), m_dirModes.end(), [&depth](const std::pair<std::string, mode_t> &a,
+                                                                         const std::pair<std::string, mode_t> &b) {
+                    return depth(a.first) > depth(b.first);
+                });
+                for (auto &i : m_dirModes)
+                {
+                    if (fchmodat(AT_FDCWD, i.first.c_str(), i.second, 0) != 0)
+                        m_errors.add(i.first, errno);
+                }
+                m_dirModes.clear();
+            }
+
+            /**
+             * @brief 创建或截断目标文件；已存在的目标文件只读时改为在同一目录下创建临时文件，由CloseFile替换
+             * @param[out] tmp 使用临时文件时为临时文件名，否则为空
+             * @return 文件fd，失败返回-1并设置errno
+             */
+            static int CreateFile(int dir_fd, const char *name, mode_t mode, std::string &tmp)
+            {
+                tmp.clear();
+                int fd = openat(dir_fd, name, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, mode);
+                if (fd >= 0 || errno != EACCES)
+                    return fd;
+                static std::atomic<uint64_t> s_tmp_seq{0};
+                tmp = std::string(name) + ".tmp." + std::to_string(getpid()) + "." + std::to_string(++s_tmp_seq);
+                fd = openat(dir_fd, tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, mode);
+                if (fd < 0)
+                {
+                    int err = errno;
+                    tmp.clear();
+                    errno = err;
+                }
+                return fd;
+            }
+
+            /**
+             * @brief 关闭CreateFile打开的文件，使用了临时文件时复制成功则rename替换目标，失败则删除临时文件
+             * @param[in] ok 内容是否复制成功
+             * @return 是否成功，失败时errno有效
+             */
+            static bool CloseFile(int dir_fd, const char *name, const std::string &tmp, int fd, bool ok)
+            {
+                int err = ok ? 0 : errno;
+                close(fd);
+                if (!tmp.empty())
+                {
+                    if (ok && renameat(dir_fd, tmp.c_str(), dir_fd, name) != 0)
+                    {
+                        ok = false;
+                        err = errno;
+                    }
+                    if (!ok)
+                        unlinkat(dir_fd, tmp.c_str(), 0);
+                }
+                errno = err;
+                return ok;
+            }
+
+            /**
+             * @brief 把符号链接复制为链接本身，目标已存在时替换
+             * @param[in] src_path, dst_path 用于错误信息
+             */
+            static void CopyLink(int src_fd, const char *src_name, const std::string &src_path,
+                                 int dst_fd, const char *dst_name, const std::string &dst_path, TreeErrors &errors)
+            {
+                char target[PATH_MAX];
+                ssize_t n = readlinkat(src_fd, src_name, target, sizeof(target) - 1);
+                if (n < 0)
+                {
+                    errors.add(src_path, errno);
+                    return;
+                }
+                target[n] = '\0';
+                if (symlinkat(target, dst_fd, dst_name) != 0)
+                {
+                    if (errno != EEXIST || unlinkat(dst_fd, dst_name, 0) != 0 || symlinkat(target, dst_fd, dst_name) != 0)
+                        errors.add(dst_path, errno);
+                }
+            }
+
+        private:
+            TaskGroup &m_group;
+            TreeErrors &m_errors;
+            std::mutex m_mutex;                                   // 保护m_dirModes
+            std::vector<std::pair<std::string, mode_t>> m_dirModes; // 复制完成后才设置权限的目录
+        };
+
+        /**
+         * @brief 相当于mkdir -p，从根目录或当前目录开始逐级mkdirat/openat，不重复解析已经走过的路径
+         * @return 成功返回0，失败返回errno
+         */
+        static int MkdirAt(const std::string &dirname)
+        {
+            int fd = open(dirname[0] == '/' ? "/" : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                return errno;
+            int err = 0;
+            for (std::string_view name : StringUtil::Tokenize(dirname, "/"))
+            {
+                std::string comp(name);
+                if (mkdirat(fd, comp.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) != 0 && errno != EEXIST)
+                {
+                    err = errno;
+                    break;
+                }
+                int sub = openat(fd, comp.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (sub < 0)
+                {
+                    err = errno;
+                    break;
+                }
+                close(fd);
+                fd = sub;
+            }
+            close(fd);
+            return err;
+        }
+    }
+
     bool FSUtil::Rm(const std::string &path)
+    {
+        return RemoveTree(path, 1);
+    }
+
+    bool FSUtil::RemoveTree(const std::string &path, size_t threads, std::vector<std::string> *errors)
     {
         struct stat st;
-        if(lstat(path.c_str(),&st)) return true;
-        if(!(st.st_mode & S_IFDIR)) return Unlink(path);
-        DIR* dir = opendir(path.c_str());
-        if(!dir) return false;
-        struct dirent *dp = nullptr;
-        bool ret = true;
-        while(dp=readdir(dir))
-        {
-            if(!strcmp(dp->d_name,".")||!strcmp(dp->d_name,"..")) continue;
-            std::string dirname = path + "/" + dp->d_name;
-            ret = Rm(dirname);
-        }
-        closedir(dir);
-        if(rmdir(path.c_str())) ret = false;
-        return ret;
+        if (lstat(path.c_str(), &st) != 0)
+            return errno == ENOENT;
+        TreeErrors errs(errors);
+        if (!S_ISDIR(st.st_mode))
+        {
+            if (unlink(path.c_str()) != 0 && errno != ENOENT)
+                errs.add(path, errno);
+            return !errs.failed();
+        }
+        int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0)
+        {
+            errs.add(path, errno);
+            return false;
+        }
+        TaskGroup group(threads);
+        TreeRemover remover(group, errs);
+        TreeRemover::Dir::ptr root(new TreeRemover::Dir);
+        root->path = path;
+        group.push([&remover, fd, root]() { remover.remove(fd, root); });
+        group.run();
+        return !errs.failed();
     }
 
-    bool FSUtil::Mv(const std::string& from,const std::string& to)
+    bool FSUtil::CopyTree(const std::string &from, const std::string &to, size_t threads, std::vector<std::string> *errors)
     {
-        if(!Rm(to)) return false;
-        return rename(from.c_str(),to.c_str());
+        TreeErrors errs(errors);
+        struct stat st;
+        if (lstat(from.c_str(), &st) != 0)
+        {
+            errs.add(from, errno);
+            return false;
+        }
+        if (S_ISLNK(st.st_mode))
+        {
+            // 与目录树中的链接一样复制链接本身，不跟随
+            TreeCopier::CopyLink(AT_FDCWD, from.c_str(), from, AT_FDCWD, to.c_str(), to, errs);
+            return !errs.failed();
+        }
+        if (!S_ISDIR(st.st_mode))
+        {
+            std::string tmp;
+            int in = open(from.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+            int out = in < 0 ? -1 : TreeCopier::CreateFile(AT_FDCWD, to.c_str(), st.st_mode & 07777, tmp);
+            if (in < 0 || out < 0)
+                errs.add(in < 0 ? from : to, errno);
+            else if (!TreeCopier::CloseFile(AT_FDCWD, to.c_str(), tmp, out, TreeCopier::CopyData(in, out)))
+                errs.add(to, errno);
+            if (in >= 0)
+                close(in);
+            return !errs.failed();
+        }
+        int err = MkdirAt(to);
+        if (err != 0)
+        {
+            errs.add(to, err);
+            return false;
+        }
+        int src_fd = open(from.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        int dst_fd = open(to.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (src_fd < 0 || dst_fd < 0)
+        {
+            errs.add(src_fd < 0 ? from : to, errno);
+            if (src_fd >= 0)
+                close(src_fd);
+            if (dst_fd >= 0)
+                close(dst_fd);
+            return false;
+        }
+        TaskGroup group(threads);
+        TreeCopier copier(group, errs);
+        group.push([&copier, src_fd, dst_fd, &from, &to]() { copier.copy(src_fd, dst_fd, from, to); });
+        group.run();
+        copier.finish();
+        return !errs.failed();
+    }
+
+    bool FSUtil::MkdirAll(const std::vector<std::string> &dirnames, size_t threads, std::vector<std::string> *errors)
+    {
+        TreeErrors errs(errors);
+        TaskGroup group(threads);
+        for (auto &i : dirnames)
+        {
+            group.push([&errs, &i]() {
+                int err = i.empty() ? ENOENT : MkdirAt(i);
+                if (err != 0)
+                    errs.add(i, err);
+            });
+        }
+        group.run();
+        return !errs.failed();
+    }
+
+    bool FSUtil::Mv(const std::string &from, const std::string &to)
+    {
+        if (rename(from.c_str(), to.c_str()) == 0)
+            return true;
+        // 只有目标是非空目录或类型不匹配时才需要先删除目标
+        if (errno != ENOTEMPTY && errno != EEXIST && errno != EISDIR && errno != ENOTDIR)
+            return false;
+        if (!Rm(to))
+            return false;
+        return rename(from.c_str(), to.c_str()) == 0;
+    }
+
+    bool FSUtil::Exchange(const std::string &a, const std::string &b)
+    {
+        return syscall(SYS_renameat2, AT_FDCWD, a.c_str(), AT_FDCWD, b.c_str(), RENAME_EXCHANGE) == 0;
+    }
+
+    bool FSUtil::Replace(const std::string &from, const std::string &to, size_t threads)
+    {
+        if (__lstat(to.c_str()) != 0)
+            return rename(from.c_str(), to.c_str()) == 0;
+        if (!Exchange(from, to))
+            return false;
+        return RemoveTree(from, threads);
     }
 
     bool FSUtil::Realpath(const std::string &path,std::string &rpath)
@@ -311,6 +3017,270 @@ namespace MyServer
         return ofs.is_open();
     }
 
-    
+    namespace
+    {
+        static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        static int ToMadvise(MappedFile::Advice advice)
+        {
+            switch (advice)
+            {
+            case MappedFile::SEQUENTIAL:
+                return MADV_SEQUENTIAL;
+            case MappedFile::RANDOM:
+                return MADV_RANDOM;
+            case MappedFile::WILLNEED:
+                return MADV_WILLNEED;
+            default:
+                return MADV_NORMAL;
+            }
+        }
+
+        /**
+         * @brief 先占一段多出2MB的地址空间，再把文件MAP_FIXED映射到其中2MB对齐的位置，归还两端多余部分
+         * @return 映射地址，失败返回MAP_FAILED
+         */
+        static void *MapHugeAligned(int fd, size_t len, int flags)
+        {
+            // 内核按页映射，两端归还的范围也要按页计算，否则尾部munmap因地址未对齐返回EINVAL
+            static const size_t s_page_size = sysconf(_SC_PAGESIZE);
+            size_t map_len = (len + s_page_size - 1) & ~(s_page_size - 1);
+            size_t reserve_len = map_len + HUGE_PAGE_SIZE;
+            void *reserve = mmap(nullptr, reserve_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (reserve == MAP_FAILED)
+                return MAP_FAILED;
+            uintptr_t start = (uintptr_t)reserve;
+            uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+            void *addr = mmap((void *)aligned, len, PROT_READ, flags | MAP_FIXED, fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                munmap(reserve, reserve_len);
+                return MAP_FAILED;
+            }
+            if (aligned > start)
+                munmap(reserve, aligned - start);
+            size_t tail = start + reserve_len - (aligned + map_len);
+            if (tail > 0)
+                munmap((void *)(aligned + map_len), tail);
+#ifdef MADV_HUGEPAGE
+            madvise(addr, len, MADV_HUGEPAGE);
+#endif
+            return addr;
+        }
+
+        static const uint64_t s_mapped_sweep_ms = 1000; // 映射缓存检查已删除文件的最小间隔
+
+        /**
+         * @brief OpenMapped的共享缓存
+         */
+        struct MappedCache
+        {
+            std::mutex mutex;
+            std::unordered_map<std::string, MappedFile::ptr> files;
+            uint64_t lastSweep = 0; // 上次检查的时间，Clock::MonotonicMS
+        };
+
+        static inline bool SameFile(const MappedFile &file, const struct stat &st)
+        {
+            return file.getDev() == st.st_dev && file.getInode() == st.st_ino && file.size() == (size_t)st.st_size &&
+                   file.getMtime().tv_sec == st.st_mtim.tv_sec && file.getMtime().tv_nsec == st.st_mtim.tv_nsec;
+        }
+
+        /**
+         * @brief 距上次检查超过s_mapped_sweep_ms时移除文件已被删除或替换的缓存项，否则已删除文件的映射会一直占着磁盘空间和内存
+         * @details 只在锁内复制缓存项和删除结果，逐个stat在锁外进行，检查期间其他线程的OpenMapped不被阻塞；
+         *          检查期间被替换的缓存项保留，移除的映射在锁外释放
+         */
+        static void SweepMappedCache(MappedCache &cache)
+        {
+            std::vector<std::pair<std::string, MappedFile::ptr>> files;
+            {
+                std::lock_guard<std::mutex> lock(cache.mutex);
+                uint64_t now = Clock::MonotonicMS(Clock::COARSE);
+                if (now < cache.lastSweep + s_mapped_sweep_ms)
+                    return;
+                cache.lastSweep = now;
+                files.assign(cache.files.begin(), cache.files.end());
+            }
+            std::vector<std::pair<std::string, MappedFile::ptr>> stale;
+            for (auto &i : files)
+            {
+                struct stat st;
+                if (stat(i.first.c_str(), &st) != 0 || !SameFile(*i.second, st))
+                    stale.push_back(std::move(i));
+            }
+            files.clear();
+            if (stale.empty())
+                return;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            for (auto &i : stale)
+            {
+                auto it = cache.files.find(i.first);
+                if (it != cache.files.end() && it->second == i.second)
+                    cache.files.erase(it);
+            }
+            // stale在锁释放后析构，munmap不占用锁
+        }
+
+        static MappedCache &GetMappedCache()
+        {
+            static MappedCache *s_cache = new MappedCache; // 不析构，避免退出时与其他静态对象的析构顺序问题
+            return *s_cache;
+        }
+    }
+
+    MappedFile::MappedFile()
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_base = other.m_base;
+            m_mapLen = other.m_mapLen;
+            m_opened = other.m_opened;
+            m_path = std::move(other.m_path);
+            m_dev = other.m_dev;
+            m_inode = other.m_inode;
+            m_mtime = other.m_mtime;
+            other.m_data = nullptr;
+            other.m_size = 0;
+            other.m_base = nullptr;
+            other.m_mapLen = 0;
+            other.m_opened = false;
+        }
+        return *this;
+    }
+
+    bool MappedFile::open(const std::string &path, Advice advice, int flags)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            ::close(fd);
+            return false;
+        }
+        size_t len = st.st_size;
+        if (len > 0)
+        {
+            int map_flags = MAP_PRIVATE;
+            if (flags & POPULATE)
+                map_flags |= MAP_POPULATE;
+            void *addr = MAP_FAILED;
+            if ((flags & HUGE_ALIGN) && len >= HUGE_PAGE_SIZE)
+                addr = MapHugeAligned(fd, len, map_flags);
+            if (addr == MAP_FAILED)
+                addr = mmap(nullptr, len, PROT_READ, map_flags, fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                ::close(fd);
+                return false;
+            }
+            m_base = addr;
+            m_mapLen = len;
+            m_data = (const char *)addr;
+            if (advice != NORMAL)
+                madvise(addr, len, ToMadvise(advice));
+        }
+        ::close(fd);
+        m_size = len;
+        m_opened = true;
+        m_path = path;
+        m_dev = st.st_dev;
+        m_inode = st.st_ino;
+        m_mtime = st.st_mtim;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (m_base)
+            munmap(m_base, m_mapLen);
+        m_base = nullptr;
+        m_mapLen = 0;
+        m_data = nullptr;
+        m_size = 0;
+        m_opened = false;
+    }
+
+    bool MappedFile::advise(Advice advice, size_t offset, size_t len)
+    {
+        if (!m_base || offset >= m_size)
+            return false;
+        static const size_t s_page_size = sysconf(_SC_PAGESIZE);
+        size_t begin = offset & ~(s_page_size - 1);
+        size_t end = len > m_size - offset ? m_size : offset + len;
+        return madvise((char *)m_base + begin, end - begin, ToMadvise(advice)) == 0;
+    }
+
+    std::string_view MappedFile::view(size_t offset, size_t len) const
+    {
+        if (offset >= m_size)
+            return std::string_view();
+        return std::string_view(m_data + offset, std::min(len, m_size - offset));
+    }
+
+    MappedFile::ptr MappedFile::Open(const std::string &path, Advice advice, int flags)
+    {
+        MappedFile::ptr file(new MappedFile);
+        if (!file->open(path, advice, flags))
+            return nullptr;
+        return file;
+    }
+
+    MappedFile::ptr FSUtil::OpenMapped(const std::string &filename, MappedFile::Advice advice, int flags)
+    {
+        MappedCache &cache = GetMappedCache();
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0)
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            cache.files.erase(filename);
+            return nullptr;
+        }
+        SweepMappedCache(cache);
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto it = cache.files.find(filename);
+            if (it != cache.files.end() && SameFile(*it->second, st))
+                return it->second;
+        }
+        // 在锁外映射，POPULATE时可能要读整个文件
+        MappedFile::ptr file = MappedFile::Open(filename, advice, flags);
+        if (!file)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.files[filename] = file;
+        return file;
+    }
+
+    void FSUtil::DropMapped(const std::string &filename)
+    {
+        MappedCache &cache = GetMappedCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        if (filename.empty())
+            cache.files.clear();
+        else
+            cache.files.erase(filename);
+    }
+
 
 } // end myserver
\ No newline at end of file
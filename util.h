@@ -3,11 +3,17 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdarg.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <cxxabi.h> // abi::__cxa_demangle()
 #include <string>
+#include <string_view>
 #include <vector>
+#include <iterator>
 #include <iostream>
+#include <functional>
+#include <memory>
 
 namespace MyServer
 {
@@ -23,6 +29,7 @@ namespace MyServer
 
     /**
      * @brief 获取当前启动的毫秒数
+     * @details 单调时钟，取时方式见Clock的默认模式
      */
     uint64_t GetElapsedMS();
 
@@ -31,6 +38,13 @@ namespace MyServer
      */
     std::string GetThreadName();
 
+    /**
+     * @brief 获取线程名称在SymbolTable中的id
+     * @details 每个线程首次调用时驻留并缓存，SetThreadName时刷新；
+     *          绕过SetThreadName直接修改的线程名称不会反映到缓存中
+     */
+    uint32_t GetThreadNameId();
+
     /**
      * @brief 设置线程名称
      * @note 线程名称不能超过16字节，包括结尾的'\0'字符
@@ -45,6 +59,27 @@ namespace MyServer
      */
     void Backtrace(std::vector<std::string> &bt, int size = 64, int skip = 1);
 
+    /**
+     * @brief 抓取当前调用栈的返回地址，不分配内存，可以在信号处理函数中调用
+     * @param[out] frames 保存返回地址，frames[0]为栈顶
+     * @param[in] size frames的容量，同时也是最多抓取的层数（包括被跳过的层）
+     * @param[in] skip 跳过栈顶的层数，0表示从调用者开始
+     * @return 保存的层数
+     * @note 第一次调用时会加载展开栈所需的libgcc，在信号处理函数中使用前应先在普通上下文中调用一次
+     */
+    int CaptureStack(void **frames, int size, int skip = 0);
+
+    /**
+     * @brief 把返回地址解析为函数名
+     * @details 能找到符号时返回还原后的函数名，否则返回"模块名(+偏移)"
+     */
+    std::string SymbolizeFrame(void *addr);
+
+    /**
+     * @brief 把CaptureStack得到的返回地址逐个解析为函数名，追加到bt
+     */
+    void SymbolizeStack(std::vector<std::string> &bt, void *const *frames, int size);
+
     /**
      * @brief 获取当前栈信息的字符串
      * @param[in] size 栈的最大层数
@@ -55,24 +90,96 @@ namespace MyServer
 
     /**
      * @brief 获取当前时间的毫秒
+     * @details 取时方式见Clock的默认模式
      */
     uint64_t GetCurrentMS();
 
     /**
      * @brief 获取当前时间的微秒
+     * @details 取时方式见Clock的默认模式
      */
     uint64_t GetCurrentUS();
 
     /**
      * @brief 字符串转大写
+     * @note 只转换ASCII字母，与区域设置无关
      */
     std::string ToUpper(const std::string &name);
 
     /**
      * @brief 字符串转小写
+     * @note 只转换ASCII字母，与区域设置无关
      */
     std::string ToLower(const std::string &name);
 
+    /**
+     * @brief 原地转大写，每次处理16字节，非ASCII字节保持不变
+     */
+    void ToUpperInPlace(char *str, size_t len);
+    void ToUpperInPlace(std::string &str);
+
+    /**
+     * @brief 原地转小写，每次处理16字节，非ASCII字节保持不变
+     */
+    void ToLowerInPlace(char *str, size_t len);
+    void ToLowerInPlace(std::string &str);
+
+    /**
+     * @brief 转大写后追加到out
+     */
+    void AppendUpper(std::string &out, std::string_view str);
+
+    /**
+     * @brief 转小写后追加到out
+     */
+    void AppendLower(std::string &out, std::string_view str);
+
+    /**
+     * @brief 忽略ASCII大小写比较，等价于都转小写后按字节比较
+     * @return 小于0、等于0、大于0分别表示lhs小于、等于、大于rhs
+     */
+    int CompareIgnoreCase(std::string_view lhs, std::string_view rhs);
+
+    /**
+     * @brief 忽略ASCII大小写判断相等
+     */
+    bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs);
+
+    /**
+     * @brief 忽略ASCII大小写的哈希，EqualsIgnoreCase相等的字符串哈希值相同
+     */
+    uint64_t HashIgnoreCase(std::string_view str);
+
+    /**
+     * @brief 忽略大小写的比较/哈希函数对象，可用于std::map、std::unordered_map
+     * @details C++17中只有std::map等有序容器支持is_transparent的异构查找，可以直接用string_view调用find；
+     *          std::unordered_map的异构查找要到C++20才有，在本项目中find仍需传入std::string，
+     *          is_transparent对它暂不起作用
+     * @code
+     *  std::map<std::string, std::string, CaseInsensitiveLess> headers;
+     *  auto it = headers.find(std::string_view("content-type"));   // 不构造std::string
+     *  std::unordered_map<std::string, std::string, CaseInsensitiveHash, CaseInsensitiveEqual> index;
+     *  auto it2 = index.find(std::string(name));                   // C++17需要先构造std::string
+     * @endcode
+     */
+    struct CaseInsensitiveLess
+    {
+        typedef void is_transparent;
+        bool operator()(std::string_view lhs, std::string_view rhs) const { return CompareIgnoreCase(lhs, rhs) < 0; }
+    };
+
+    struct CaseInsensitiveEqual
+    {
+        typedef void is_transparent;
+        bool operator()(std::string_view lhs, std::string_view rhs) const { return EqualsIgnoreCase(lhs, rhs); }
+    };
+
+    struct CaseInsensitiveHash
+    {
+        typedef void is_transparent;
+        size_t operator()(std::string_view str) const { return HashIgnoreCase(str); }
+    };
+
     /**
      * @brief 日期时间转字符串
      */
@@ -83,6 +190,117 @@ namespace MyServer
      */
     time_t Str2Time(const char *str, const char *format = "%Y-%m-%d %H:%M:%S");
 
+    /**
+     * @brief 计算一段内存的64位哈希值
+     * @details 每次处理16字节，开销只有几次乘法，可以在热路径上使用；不能用于需要抗碰撞攻击的场景
+     * @param[in] data 数据
+     * @param[in] len 长度
+     * @param[in] seed 种子，传入上一段数据的哈希值即可串联多段数据
+     */
+    uint64_t Hash64(const void *data, size_t len, uint64_t seed = 0);
+
+    /**
+     * @brief 只读内存映射文件
+     * @details 整个文件以PROT_READ、MAP_PRIVATE映射，析构时自动munmap；通过view()零拷贝访问内容。
+     *          映射完成后即关闭fd，不占用文件描述符
+     * @note 映射期间文件被截断时，访问超出新长度的部分会收到SIGBUS；需要原地修改的文件应使用普通读写
+     */
+    class MappedFile
+    {
+    public:
+        typedef std::shared_ptr<MappedFile> ptr;
+
+        /**
+         * @brief 访问模式提示，对应madvise
+         */
+        enum Advice
+        {
+            // 默认预读
+            NORMAL = 0,
+            // 顺序访问，加大预读，读过的页可以尽早回收
+            SEQUENTIAL = 1,
+            // 随机访问，关闭预读
+            RANDOM = 2,
+            // 立即异步读入整个文件
+            WILLNEED = 3,
+        };
+
+        /**
+         * @brief 映射选项，可按位组合
+         */
+        enum Flags
+        {
+            // 映射时同步读入所有页（MAP_POPULATE），之后访问不再缺页
+            POPULATE = 0x1,
+            // 映射地址按2MB对齐并设置MADV_HUGEPAGE，内核支持文件页透明大页时可以减少TLB缺失，
+            // 只对不小于2MB的文件生效
+            HUGE_ALIGN = 0x2,
+        };
+
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        /**
+         * @brief 映射文件，已经映射的文件会先被关闭
+         * @param[in] path 文件名
+         * @param[in] advice 访问模式提示
+         * @param[in] flags Flags的组合
+         * @return 是否成功，空文件也算成功，此时view()为空
+         */
+        bool open(const std::string &path, Advice advice = NORMAL, int flags = 0);
+
+        /**
+         * @brief 解除映射
+         */
+        void close();
+
+        /**
+         * @brief 对文件的一段重新设置访问模式提示
+         * @param[in] offset 起始偏移，会向下对齐到页
+         * @param[in] len 长度，超出文件部分被忽略
+         */
+        bool advise(Advice advice, size_t offset = 0, size_t len = SIZE_MAX);
+
+        bool isOpen() const { return m_opened; }
+        const char *data() const { return m_data; }
+        size_t size() const { return m_size; }
+        std::string_view view() const { return std::string_view(m_data, m_size); }
+
+        /**
+         * @brief 返回文件的一段，超出文件的部分被截掉
+         */
+        std::string_view view(size_t offset, size_t len) const;
+
+        const std::string &getPath() const { return m_path; }
+        dev_t getDev() const { return m_dev; }
+        ino_t getInode() const { return m_inode; }
+        const struct timespec &getMtime() const { return m_mtime; }
+
+        /**
+         * @brief 映射文件
+         * @return 失败返回nullptr
+         */
+        static ptr Open(const std::string &path, Advice advice = NORMAL, int flags = 0);
+
+    private:
+        // 文件内容起始地址
+        const char *m_data = nullptr;
+        // 文件大小
+        size_t m_size = 0;
+        // 实际映射的地址和长度，用于munmap
+        void *m_base = nullptr;
+        size_t m_mapLen = 0;
+        bool m_opened = false;
+        std::string m_path;
+        dev_t m_dev = 0;
+        ino_t m_inode = 0;
+        struct timespec m_mtime = {0, 0};
+    };
+
     /**
      * @brief 文件系统操作类
      */
@@ -94,9 +312,37 @@ namespace MyServer
          * @param[out] files 文件列表
          * @param[in] path 路径
          * @param[in] subfix 后缀名，比如 ".yml"
+         * @note 基于WalkFiles在调用线程内遍历，返回的文件顺序不固定；大目录树需要并行时直接使用WalkFiles
          */
         static void ListAllFile(std::vector<std::string> &files, const std::string &path, const std::string &subfix);
 
+        /**
+         * @brief WalkFiles的遍历选项
+         */
+        struct WalkOptions
+        {
+            // 只返回指定后缀的常规文件，为空时不过滤
+            std::string subfix;
+            // 返回false的常规文件被跳过，参数为所在目录和文件名
+            std::function<bool(const std::string &dir, const char *name)> filter;
+            // 并行度，默认只在调用线程内遍历；0表示CPU核数，只有文件数很多（数万以上）时才值得多线程，
+            // 其余线程从进程共享的工作线程池借用
+            size_t threads = 1;
+        };
+
+        /**
+         * @brief 并行递归遍历目录下的常规文件，通过回调逐个返回
+         * @details 相对目录fd用openat/getdents64读取目录项，d_type为DT_UNKNOWN时用fstatat确认类型，不跟随符号链接；
+         *          发现子目录时如果有空闲线程就交给它，否则由当前线程深度优先继续遍历
+         * @param[in] path 根目录
+         * @param[in] cb 每个文件调用一次，参数为带路径的文件名；threads不为1时会在多个线程中并发调用
+         * @param[in] options 遍历选项
+         * @return 根目录能否打开
+         * @exception cb或filter抛出的第一个异常在所有线程停止后由WalkFiles重新抛出，遍历随之中止
+         */
+        static bool WalkFiles(const std::string &path, const std::function<void(const std::string &file)> &cb, const WalkOptions &options);
+        static bool WalkFiles(const std::string &path, const std::function<void(const std::string &file)> &cb);
+
         /**
          * @brief 创建路径，相当于mkdir -p
          * @param[in] dirname 路径名
@@ -113,19 +359,70 @@ namespace MyServer
 
         /**
          * @brief 删除文件或路径
+         * @details 在调用线程内执行RemoveTree，任何一项删除失败都返回false
          * @param[in] path 文件名或路径名
          * @return 是否删除成功
          */
         static bool Rm(const std::string &path);
 
         /**
-         * @brief 移动文件或路径，内部实现是先Rm(to)，再rename(from, to)，参考rename
+         * @brief 并行删除文件或目录树
+         * @details 目录项相对目录fd用unlinkat删除，目录在其下所有项删除后再删除
+         * @param[in] path 文件名或路径名，不存在时视为成功
+         * @param[in] threads 并行度，包括调用线程，0表示CPU核数；其余线程从进程共享的工作线程池借用
+         * @param[out] errors 所有失败项，格式为"路径: 错误信息"；因子项删不掉而无法删除的上级目录不重复列出
+         * @return 是否全部删除成功
+         */
+        static bool RemoveTree(const std::string &path, size_t threads = 0, std::vector<std::string> *errors = nullptr);
+
+        /**
+         * @brief 并行复制文件或目录树，保留权限位，符号链接（包括from本身）复制为链接本身
+         * @details 相对目录fd用openat/mkdirat/symlinkat创建，文件内容用copy_file_range在内核中复制；
+         *          目标目录已存在时合并，同名文件被覆盖，只读的同名文件通过临时文件和rename替换；
+         *          只读目录先以可写权限创建，整棵树复制完成后再设置为源目录的权限
+         * @param[in] from 源
+         * @param[in] to 目的地
+         * @param[in] threads 并行度，包括调用线程，0表示CPU核数；其余线程从进程共享的工作线程池借用
+         * @param[out] errors 所有失败项，格式为"路径: 错误信息"
+         * @return 是否全部复制成功
+         */
+        static bool CopyTree(const std::string &from, const std::string &to, size_t threads = 0, std::vector<std::string> *errors = nullptr);
+
+        /**
+         * @brief 并行创建多个目录，每个都相当于mkdir -p，逐级用mkdirat/openat创建
+         * @param[in] dirnames 路径列表
+         * @param[in] threads 并行度，包括调用线程，0表示CPU核数；其余线程从进程共享的工作线程池借用
+         * @param[out] errors 所有失败项，格式为"路径: 错误信息"
+         * @return 是否全部创建成功
+         */
+        static bool MkdirAll(const std::vector<std::string> &dirnames, size_t threads = 0, std::vector<std::string> *errors = nullptr);
+
+        /**
+         * @brief 移动文件或路径，参考rename
+         * @details 先直接rename(from, to)，只有to是非空目录等rename无法覆盖的情况才先Rm(to)再重试
          * @param[in] from 源
          * @param[in] to 目的地
          * @return 是否成功
          */
         static bool Mv(const std::string &from, const std::string &to);
 
+        /**
+         * @brief 原子交换两个已存在的路径，参考renameat2(2)的RENAME_EXCHANGE
+         * @return 是否成功
+         */
+        static bool Exchange(const std::string &a, const std::string &b);
+
+        /**
+         * @brief 用from原子地替换to，适合整体替换目录
+         * @details to存在时先与from交换，任何时刻to都是完整的旧内容或新内容，再删除换到from处的旧内容；
+         *          to不存在时直接rename
+         * @param[in] from 新内容
+         * @param[in] to 被替换的路径
+         * @param[in] threads 删除旧内容的并行度，0表示CPU核数
+         * @return 是否成功，旧内容删除失败也返回false，此时to已经是新内容
+         */
+        static bool Replace(const std::string &from, const std::string &to, size_t threads = 0);
+
         /**
          * @brief 返回绝对路径，参考realpath(3)
          * @details 路径中的符号链接会被解析成实际的路径，删除多余的'.' '..'和'/'
@@ -175,6 +472,24 @@ namespace MyServer
          */
         static bool OpenForRead(std::ifstream &ifs, const std::string &filename, std::ios_base::openmode mode);
 
+        /**
+         * @brief 以内存映射方式打开文件，结果在进程内共享缓存
+         * @details 缓存以路径为键，每次调用stat比较设备号、inode、大小和修改时间，文件被替换或修改后重新映射；
+         *          旧的映射在最后一个持有者释放后才解除，已取得的view不会失效。
+         *          文件已被删除或替换的缓存项在调用时顺带清理（至多每秒检查一次全部缓存项），
+         *          之后不再调用OpenMapped时可用DropMapped主动释放
+         * @param[in] filename 文件名
+         * @param[in] advice 新建映射时的访问模式提示
+         * @param[in] flags 新建映射时的选项，见MappedFile::Flags
+         * @return 失败返回nullptr
+         */
+        static MappedFile::ptr OpenMapped(const std::string &filename, MappedFile::Advice advice = MappedFile::NORMAL, int flags = 0);
+
+        /**
+         * @brief 从映射缓存中移除文件，filename为空时清空整个缓存
+         */
+        static void DropMapped(const std::string &filename = "");
+
         /**
          * @brief 以只写方式打开
          * @param[in] ofs 文件流
@@ -191,18 +506,57 @@ namespace MyServer
     class TypeUtil
     {
     public:
-        // 转字符，返回*str.begin()
-        static int8_t ToChar(const std::string &str);
-        // atoi，参考atoi(3)
-        static int64_t Atoi(const std::string &str);
-        // atof，参考atof(3)
-        static double Atof(const std::string &str);
+        /**
+         * @brief 数值解析结果
+         */
+        enum ParseResult
+        {
+            // 整个输入都是合法数值
+            PARSE_OK = 0,
+            // 开头的数值已解析，后面还有其他字符
+            PARSE_PARTIAL = 1,
+            // 开头不是合法数值
+            PARSE_INVALID = 2,
+            // 数值超出类型范围
+            PARSE_OVERFLOW = 3,
+        };
+
+        // 转字符，返回*str.begin()，空串返回0
+        static int8_t ToChar(std::string_view str);
+        // atoi，参考atoi(3)，基于Parse实现，非法或溢出时返回0
+        static int64_t Atoi(std::string_view str);
+        // atof，参考atof(3)，基于Parse实现，非法或溢出时返回0
+        static double Atof(std::string_view str);
         // 返回str[0]
         static int8_t ToChar(const char *str);
         // atoi，参考atoi(3)
         static int64_t Atoi(const char *str);
         // atof，参考atof(3)
         static double Atof(const char *str);
+
+        /**
+         * @brief 基于std::from_chars解析数值，与区域设置无关，不分配内存
+         * @details 与atoi/atof一样跳过开头的空白和一个'+'号，符号后面不能再跟符号（"+-5"为PARSE_INVALID）
+         * @param[in] str 输入
+         * @param[out] value 解析结果，PARSE_INVALID和PARSE_OVERFLOW时不修改
+         * @param[out] consumed 数值结束位置相对str开头的偏移，PARSE_INVALID时为0
+         */
+        static ParseResult Parse(std::string_view str, int32_t &value, size_t *consumed = nullptr);
+        static ParseResult Parse(std::string_view str, int64_t &value, size_t *consumed = nullptr);
+        static ParseResult Parse(std::string_view str, uint32_t &value, size_t *consumed = nullptr);
+        static ParseResult Parse(std::string_view str, uint64_t &value, size_t *consumed = nullptr);
+        static ParseResult Parse(std::string_view str, double &value, size_t *consumed = nullptr);
+
+        /**
+         * @brief 解析以delim分隔的数值列表，例如"1, 2,3"，每一项前后的空白会被忽略
+         * @param[in] str 输入，全为空白时得到空列表
+         * @param[in] delim 分隔符
+         * @param[out] values 解析结果追加到values，出错时已解析的项保留
+         * @param[out] error_offset 出错项在str中的偏移
+         * @return 全部成功返回PARSE_OK，否则返回第一个出错项的结果（尾随其他字符的项为PARSE_PARTIAL）
+         */
+        static ParseResult ParseList(std::string_view str, char delim, std::vector<int64_t> &values, size_t *error_offset = nullptr);
+        static ParseResult ParseList(std::string_view str, char delim, std::vector<double> &values, size_t *error_offset = nullptr);
     };
 
     /**
@@ -231,21 +585,101 @@ namespace MyServer
          */
         static std::string Formatv(const char *fmt, va_list ap);
 
+        /**
+         * @brief 打开或关闭字符串函数（包括base64、十六进制编解码和Crc32c）的SIMD实现，关闭后改用标量实现，结果完全相同
+         * @details 默认打开，CPU不支持的指令集始终不会使用。用于对比测试和性能比较，
+         *          切换只影响之后开始的调用
+         */
+        static void SetSimdEnabled(bool enabled);
+        static bool IsSimdEnabled();
+
         /**
          * @brief url编码
+         * @details 除字母、数字和"-._~"以外的字节都编码为%XX，每次检查16/32字节，整段无需编码时直接拷贝
          * @param[in] str 原始字符串
          * @param[in] space_as_plus 是否将空格编码成+号，如果为false，则空格编码成%20
          * @return 编码后的字符串
          */
-        static std::string UrlEncode(const std::string &str, bool space_as_plus = true);
+        static std::string UrlEncode(std::string_view str, bool space_as_plus = true);
+
+        /**
+         * @brief url编码，结果追加到out
+         */
+        static void UrlEncodeTo(std::string &out, std::string_view str, bool space_as_plus = true);
 
         /**
          * @brief url解码
+         * @details 不合法的%序列原样保留
          * @param[in] str url字符串
          * @param[in] space_as_plus 是否将+号解码为空格
          * @return 解析后的字符串
          */
-        static std::string UrlDecode(const std::string &str, bool space_as_plus = true);
+        static std::string UrlDecode(std::string_view str, bool space_as_plus = true);
+
+        /**
+         * @brief url解码，结果追加到out
+         */
+        static void UrlDecodeTo(std::string &out, std::string_view str, bool space_as_plus = true);
+
+        /**
+         * @brief 原地url解码，解码结果不会比输入长
+         * @param[in,out] str 待解码的数据
+         * @param[in] len 数据长度
+         * @return 解码后的长度
+         */
+        static size_t UrlDecodeInPlace(char *str, size_t len, bool space_as_plus = true);
+
+        /**
+         * @brief 原地url解码，解码后调整str的长度
+         */
+        static void UrlDecodeInPlace(std::string &str, bool space_as_plus = true);
+
+        /**
+         * @brief base64编码，结果追加到out
+         * @details 输出带'='填充；支持SSSE3时每次把12字节编码为16个字符
+         * @param[in] data 原始数据
+         * @param[in] url 是否使用url安全字母表（'-'和'_'代替'+'和'/'）
+         */
+        static void Base64EncodeTo(std::string &out, std::string_view data, bool url = false);
+        static std::string Base64Encode(std::string_view data, bool url = false);
+
+        /**
+         * @brief base64解码，结果追加到out
+         * @details 末尾的'='填充可有可无，不接受空白等字母表以外的字符；
+         *          标准字母表在支持SSSE3时每次校验并解码16个字符，url安全字母表逐字节查表
+         * @return 输入不合法时返回false，out恢复为调用前的内容
+         */
+        static bool Base64DecodeTo(std::string &out, std::string_view str, bool url = false);
+
+        /**
+         * @brief base64解码，输入不合法时返回空字符串
+         */
+        static std::string Base64Decode(std::string_view str, bool url = false);
+
+        /**
+         * @brief 十六进制编码，结果追加到out，支持SSSE3时每次编码16字节
+         * @param[in] upper 是否使用大写字母
+         */
+        static void HexEncodeTo(std::string &out, std::string_view data, bool upper = false);
+        static std::string HexEncode(std::string_view data, bool upper = false);
+
+        /**
+         * @brief 十六进制解码，结果追加到out，大小写均可，支持SSSE3时每次解码32个字符
+         * @return 长度为奇数或含非十六进制字符时返回false，out恢复为调用前的内容
+         */
+        static bool HexDecodeTo(std::string &out, std::string_view str);
+
+        /**
+         * @brief 十六进制解码，输入不合法时返回空字符串
+         */
+        static std::string HexDecode(std::string_view str);
+
+        /**
+         * @brief CRC32C（Castagnoli）校验和
+         * @details 支持SSE4.2时使用crc32指令，否则使用slicing-by-8查表
+         * @param[in] crc 上一段数据的结果，用于分段计算：Crc32c(b, Crc32c(a)) == Crc32c(a + b)
+         */
+        static uint32_t Crc32c(std::string_view data, uint32_t crc = 0);
 
         /**
          * @brief 移除字符串首尾的指定字符串
@@ -272,14 +706,200 @@ namespace MyServer
         static std::string TrimRight(const std::string &str, const std::string &delimit = " \t\r\n");
 
         /**
-         * @brief 宽字符串转字符串
+         * @brief 移除首尾的指定字符，返回str的子串，不拷贝
+         * @param[] str 输入字符串
+         * @param[] delimit 待移除的字符集合
+         */
+        static std::string_view TrimView(std::string_view str, std::string_view delimit = " \t\r\n");
+
+        /**
+         * @brief 移除首部的指定字符，返回str的子串，不拷贝
+         */
+        static std::string_view TrimLeftView(std::string_view str, std::string_view delimit = " \t\r\n");
+
+        /**
+         * @brief 移除尾部的指定字符，返回str的子串，不拷贝
+         */
+        static std::string_view TrimRightView(std::string_view str, std::string_view delimit = " \t\r\n");
+
+        /**
+         * @brief 字符集合，构造时建好位图，反复查找同一集合时（如切分）只需构造一次
+         * @details 先逐字节看前8个字符，之后集合不超过8个字符时每次比较16字节（SetSimdEnabled(false)时除外），
+         *          否则按位图逐字节查找；只引用set，不拷贝
+         */
+        class CharSet
+        {
+        public:
+            CharSet() : m_bits{0, 0, 0, 0} {}
+            explicit CharSet(std::string_view set);
+
+            bool contains(unsigned char c) const { return (m_bits[c >> 6] >> (c & 63)) & 1; }
+
+            /**
+             * @brief 从p开始找第一个属于（in为true）或不属于（in为false）集合的字符，返回偏移，未找到返回n
+             */
+            size_t find(const char *p, size_t n, bool in) const;
+
+            /**
+             * @brief 从p+n向前找最后一个不属于集合的字符，返回其偏移+1，全部属于集合时返回0
+             */
+            size_t rfindNot(const char *p, size_t n) const;
+
+        private:
+            static const size_t s_max_simd_set = 8;
+            std::string_view m_set;
+            uint64_t m_bits[4];
+            alignas(16) char m_splat[s_max_simd_set][16]; // 每个字符重复16次，集合不超过8个字符时构造时填好
+        };
+
+        /**
+         * @brief 从pos开始查找第一个属于set的字符
+         * @details 每次调用都要构造CharSet，对同一集合反复查找时直接使用CharSet
+         * @return 字符位置，未找到返回std::string_view::npos
+         */
+        static size_t FindFirstOf(std::string_view str, std::string_view set, size_t pos = 0);
+
+        /**
+         * @brief 从pos开始查找第一个不属于set的字符
+         * @return 字符位置，未找到返回std::string_view::npos
+         */
+        static size_t FindFirstNotOf(std::string_view str, std::string_view set, size_t pos = 0);
+
+        /**
+         * @brief 查找最后一个不属于set的字符
+         * @return 字符位置，未找到返回std::string_view::npos
+         */
+        static size_t FindLastNotOf(std::string_view str, std::string_view set);
+
+        /**
+         * @brief 字符串切分的结果，遍历时逐段返回原字符串的子串，不分配内存
+         * @details 需要保证原字符串在遍历期间有效
+         */
+        class SplitRange
+        {
+        public:
+            class iterator
+            {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef std::string_view value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const std::string_view *pointer;
+                typedef const std::string_view &reference;
+
+                iterator() = default;
+                iterator(std::string_view str, std::string_view delims, bool skip_empty)
+                    : m_str(str), m_delims(delims), m_skipEmpty(skip_empty), m_next(0)
+                {
+                    advance();
+                }
+
+                reference operator*() const { return m_token; }
+                pointer operator->() const { return &m_token; }
+                iterator &operator++()
+                {
+                    advance();
+                    return *this;
+                }
+                iterator operator++(int)
+                {
+                    iterator tmp = *this;
+                    advance();
+                    return tmp;
+                }
+                bool operator==(const iterator &rhs) const { return m_pos == rhs.m_pos; }
+                bool operator!=(const iterator &rhs) const { return m_pos != rhs.m_pos; }
+
+            private:
+                void advance();
+
+            private:
+                std::string_view m_str;
+                CharSet m_delims;                          // 构造迭代器时建好，advance时复用
+                bool m_skipEmpty = false;
+                size_t m_next = 0;                         // 下一段的起始位置
+                size_t m_pos = std::string_view::npos;     // 当前段的起始位置，npos表示遍历结束
+                std::string_view m_token;                  // 当前段
+            };
+
+            SplitRange(std::string_view str, std::string_view delims, bool skip_empty)
+                : m_str(str), m_delims(delims), m_skipEmpty(skip_empty) {}
+
+            iterator begin() const { return iterator(m_str, m_delims, m_skipEmpty); }
+            iterator end() const { return iterator(); }
+
+        private:
+            std::string_view m_str;
+            std::string_view m_delims;
+            bool m_skipEmpty;
+        };
+
+        /**
+         * @brief 按delims中的任一字符切分，保留空段，例如"a,,b"得到"a" "" "b"
+         * @code
+         *  for (std::string_view field : StringUtil::Split(line, ","))
+         * @endcode
+         */
+        static SplitRange Split(std::string_view str, std::string_view delims = ",")
+        {
+            return SplitRange(str, delims, false);
+        }
+
+        /**
+         * @brief 按delims中的任一字符切分，跳过空段，适合按空白分词
+         */
+        static SplitRange Tokenize(std::string_view str, std::string_view delims = " \t\r\n")
+        {
+            return SplitRange(str, delims, true);
+        }
+
+        /**
+         * @brief 宽字符串转UTF-8字符串
+         * @return 转换结果，ws中有非法码点（代理区码点、超出U+10FFFF、不成对的UTF-16代理）时返回空字符串，
+         *         需要知道出错位置时使用WStringToUtf8
          */
         static std::string WStringToString(const std::wstring &ws);
 
         /**
-         * @brief 字符串转宽字符串
+         * @brief UTF-8字符串转宽字符串
+         * @return 转换结果，s不是合法UTF-8时返回空字符串，需要知道出错位置时使用Utf8ToWString
          */
         static std::wstring StringToWString(const std::string &s);
+
+        /**
+         * @brief 校验UTF-8
+         * @details 拒绝截断的序列、多余的后续字节、过长编码、代理区码点（U+D800~U+DFFF）和超出U+10FFFF的码点；
+         *          支持SSSE3时每次查表校验16字节，包括中文等多字节序列，只在出错的块和末尾不足16字节处逐个序列检查
+         * @param[out] error_offset 失败时为第一个非法序列的字节偏移
+         */
+        static bool ValidateUtf8(std::string_view str, size_t *error_offset = nullptr);
+
+        /**
+         * @brief UTF-8转UTF-32/UTF-16，结果追加到out
+         * @details 纯ASCII的16字节用SSE2直接展开；支持SSSE3时，连续的多字节段（如中文正文）先分段校验，
+         *          再按12字节内的字符结尾位置查表，一次解码6个2字节或4个2~3字节的字符，连续的3字节字符每次解码16个；
+         *          夹在ASCII中的短多字节序列和4字节序列逐个解码
+         * @param[out] out 输出，失败时保持调用前的内容
+         * @param[out] error_offset 失败时为str中第一个非法序列的字节偏移
+         * @return 是否成功
+         */
+        static bool Utf8ToUtf32(std::string_view str, std::u32string &out, size_t *error_offset = nullptr);
+        static bool Utf8ToUtf16(std::string_view str, std::u16string &out, size_t *error_offset = nullptr);
+
+        /**
+         * @brief UTF-32/UTF-16转UTF-8，结果追加到out
+         * @param[out] out 输出，失败时保持调用前的内容
+         * @param[out] error_offset 失败时为第一个非法码元的下标
+         * @return 是否成功
+         */
+        static bool Utf32ToUtf8(std::u32string_view str, std::string &out, size_t *error_offset = nullptr);
+        static bool Utf16ToUtf8(std::u16string_view str, std::string &out, size_t *error_offset = nullptr);
+
+        /**
+         * @brief UTF-8与宽字符串互转，wchar_t为4字节时按UTF-32处理，为2字节时按UTF-16处理
+         */
+        static bool Utf8ToWString(std::string_view str, std::wstring &out, size_t *error_offset = nullptr);
+        static bool WStringToUtf8(std::wstring_view str, std::string &out, size_t *error_offset = nullptr);
     };
 
 } // namespace MyServer